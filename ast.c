@@ -0,0 +1,90 @@
+#include "cx.h"
+
+#define AST_MIN_CAP 64
+
+/* Bytes for cap nodes, the arrays are laid out by decreasing alignment */
+static inline
+isize ast_block_size(u32 cap){
+	return (isize)cap * (sizeof(NodeData) + sizeof(u32) + sizeof(u8));
+}
+
+static
+void ast_grow(Ast* ast, u32 min_cap){
+	isize new_cap = max(max((isize)ast->cap * 2, (isize)min_cap), (isize)AST_MIN_CAP);
+	new_cap = min(new_cap, (isize)UINT32_MAX);
+	ensure(new_cap >= min_cap, "AST node count overflows u32");
+
+	byte* block = mem_alloc(ast->allocator, ast_block_size((u32)new_cap), alignof(NodeData));
+	ensure(block != NULL, "Failed to allocate AST nodes");
+
+	NodeData* data = (NodeData*)block;
+	u32* main_token = (u32*)(data + new_cap);
+	u8* tag = (u8*)(main_token + new_cap);
+
+	if(ast->len > 0){
+		mem_copy_no_overlap(data, ast->data, ast->len * sizeof(NodeData));
+		mem_copy_no_overlap(main_token, ast->main_token, ast->len * sizeof(u32));
+		mem_copy_no_overlap(tag, ast->tag, ast->len * sizeof(u8));
+	}
+	if(ast->cap > 0){
+		mem_free(ast->allocator, ast->data, ast_block_size(ast->cap));
+	}
+
+	ast->data = data;
+	ast->main_token = main_token;
+	ast->tag = tag;
+	ast->cap = (u32)new_cap;
+}
+
+Ast ast_create(Allocator allocator, isize node_capacity){
+	Ast ast = {
+		.extra = dyn_array_create(allocator),
+		.allocator = allocator,
+	};
+	ast_grow(&ast, (u32)clamp((isize)1, node_capacity, (isize)UINT32_MAX));
+	ast_add_node(&ast, Node_None, 0, 0, 0);
+	return ast;
+}
+
+void ast_destroy(Ast* ast){
+	if(ast->cap > 0){
+		mem_free(ast->allocator, ast->data, ast_block_size(ast->cap));
+	}
+	dyn_array_destroy(&ast->extra);
+	*ast = (Ast){0};
+}
+
+NodeIndex ast_reserve_node(Ast* ast){
+	if(ast->len == ast->cap){
+		ast_grow(ast, ast->cap + 1);
+	}
+	NodeIndex node = ast->len;
+	ast->len += 1;
+	ast->tag[node] = Node_None;
+	return node;
+}
+
+void ast_set_node(Ast* ast, NodeIndex node, NodeTag tag, u32 main_token, u32 lhs, u32 rhs){
+	ensure(node < ast->len, "Invalid node index");
+	ast->tag[node] = (u8)tag;
+	ast->main_token[node] = main_token;
+	ast->data[node] = (NodeData){ .lhs = lhs, .rhs = rhs };
+}
+
+NodeIndex ast_add_node(Ast* ast, NodeTag tag, u32 main_token, u32 lhs, u32 rhs){
+	NodeIndex node = ast_reserve_node(ast);
+	ast_set_node(ast, node, tag, main_token, lhs, rhs);
+	return node;
+}
+
+u32 ast_add_list(Ast* ast, u32 const* items, u32 count){
+	ensure(ast->extra.len + count + 1 <= UINT32_MAX, "AST extra data overflows u32");
+	u32 index = (u32)ast->extra.len;
+	dyn_array_push(&ast->extra, count);
+	if(count > 0){
+		dyn_array_append(&ast->extra, items, count);
+	}
+	return index;
+}
+
+#undef AST_MIN_CAP
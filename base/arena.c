@@ -18,9 +18,30 @@ Arena arena_create_dynamic(byte* buf, isize buf_size){
 	return arena;
 }
 
+Arena arena_create_mapped(isize capacity, MemPagePolicy policy, MemPagePolicy* applied){
+	if(policy != MemPages_Default){
+		capacity = mem_align_forward_size(capacity, mem_huge_page_size);
+	}
+	byte* buf = mem_os_map_pages(capacity, policy, applied);
+	ensure(buf != NULL, "Failed to map arena memory");
+	return arena_create_buffer(buf, capacity);
+}
+
+void arena_destroy_mapped(Arena* a){
+	ensure(a->region_count == 0, "Arena has dangling regions");
+	for(Arena* chunk = a->next; chunk != NULL;){
+		Arena* next = chunk->next;
+		heap_free(chunk->data);
+		heap_free(chunk);
+		chunk = next;
+	}
+	mem_os_unmap(a->data, a->capacity);
+	*a = (Arena){0};
+}
+
 #define ARENA_COMMIT_SIZE (1024 * 16)
 
-void* arena_alloc(Arena* a, isize size, isize align){
+void* (arena_alloc)(Arena* a, isize size, isize align){
 	uintptr base = (uintptr)a->data;
 	uintptr current = base + (uintptr)a->offset;
 
@@ -36,21 +57,28 @@ void* arena_alloc(Arena* a, isize size, isize align){
 		}
 		else {
 			if(a->next != NULL){
-				return arena_alloc(a->next, size, align);
+				void* allocation = (arena_alloc)(a->next, size, align);
+				if(allocation != NULL){
+					return allocation;
+				}
 			}
 
 			Arena* new_arena = heap_alloc(sizeof(Arena), alignof(Arena));
 			if(new_arena == NULL){
 				return NULL; /* VERY out of memory */
 			}
-			isize new_arena_size = mem_align_forward_size(size, 1024);
+			isize new_arena_size = max(mem_align_forward_size(size, 1024), ARENA_COMMIT_SIZE);
 			byte* new_arena_buf = heap_alloc(new_arena_size, max(align, (isize)alignof(void*) * 2));
 			if(new_arena_buf == NULL){
 				heap_free(new_arena);
 				return NULL; /* VERY out of memory */
 			}
 			*new_arena = arena_create_dynamic(new_arena_buf, new_arena_size);
-			return arena_alloc(new_arena, size, align);
+
+			/* Newest chunk goes first, so it's the one tried next time */
+			new_arena->next = a->next;
+			a->next = new_arena;
+			return (arena_alloc)(new_arena, size, align);
 		}
 	}
 
@@ -62,19 +90,19 @@ void* arena_alloc(Arena* a, isize size, isize align){
 	return allocation;
 }
 
-void* arena_realloc(Arena* a, void* ptr, isize old_size, isize new_size, isize align){
+void* (arena_realloc)(Arena* a, void* ptr, isize old_size, isize new_size, isize align){
 	ensure(old_size > 0 && new_size > 0, "Invalid sizes");
 
 	if(ptr == NULL){
-		return arena_alloc(a, new_size, align);
+		return (arena_alloc)(a, new_size, align);
 	}
 
-	bool in_place = arena_resize_in_place(a, ptr, new_size);
+	bool in_place = (arena_resize_in_place)(a, ptr, new_size);
 	if(in_place){
 		return ptr;
 	}
 
-	void* new_alloc = arena_alloc(a, new_size, align);
+	void* new_alloc = (arena_alloc)(a, new_size, align);
 	if(!new_alloc){
 		return NULL;
 	}
@@ -83,12 +111,15 @@ void* arena_realloc(Arena* a, void* ptr, isize old_size, isize new_size, isize a
 	return new_alloc;
 }
 
-bool arena_resize_in_place(Arena* a, void* ptr, isize new_size){
+bool (arena_resize_in_place)(Arena* a, void* ptr, isize new_size){
 	uintptr base    = (uintptr)a->data;
 	uintptr current = base + (uintptr)a->offset;
 	uintptr limit   = base + a->capacity;
 
-	ensure((uintptr)ptr >= base && (uintptr)ptr < limit, "Pointer is not owned by arena");
+	if((uintptr)ptr < base || (uintptr)ptr >= limit){
+		ensure(a->next != NULL, "Pointer is not owned by arena");
+		return (arena_resize_in_place)(a->next, ptr, new_size);
+	}
 
 	if(ptr == a->last_allocation){
 		isize last_allocation_size = current - (uintptr)a->last_allocation;
@@ -105,24 +136,77 @@ bool arena_resize_in_place(Arena* a, void* ptr, isize new_size){
 
 void arena_reset(Arena* arena){
 	ensure(arena->region_count == 0, "Arena has dangling regions");
-	arena->offset = 0;
-	arena->last_allocation = NULL;
+	for(Arena* a = arena; a != NULL; a = a->next){
+		a->offset = 0;
+		a->last_allocation = NULL;
+	}
 }
 
 ArenaRegion arena_region_begin(Arena* a){
 	ArenaRegion reg = {
 		.arena = a,
 		.offset = a->offset,
+		.last_allocation = a->last_allocation,
+		.chunk = a->next,
 	};
+	if(a->next != NULL){
+		reg.chunk_offset = a->next->offset;
+		reg.chunk_last_allocation = a->next->last_allocation;
+	}
 	a->region_count += 1;
 	return reg;
 }
 
 void arena_region_end(ArenaRegion reg){
-	ensure(reg.arena->region_count > 0, "Arena has a improper region counter");
-	ensure(reg.arena->offset >= reg.offset, "Arena has a lower offset than region");
+	Arena* a = reg.arena;
+	ensure(a->region_count > 0, "Arena has a improper region counter");
+	ensure(a->offset >= reg.offset, "Arena has a lower offset than region");
+
+	while(a->next != reg.chunk){
+		Arena* chunk = a->next;
+		ensure(chunk != NULL, "Region chunk is not in the arena");
+		a->next = chunk->next;
+		heap_free(chunk->data);
+		heap_free(chunk);
+	}
+	if(reg.chunk != NULL){
+		reg.chunk->offset = reg.chunk_offset;
+		reg.chunk->last_allocation = reg.chunk_last_allocation;
+	}
+
+	a->offset = reg.offset;
+	a->last_allocation = reg.last_allocation;
+	a->region_count -= 1;
+}
 
-	reg.arena->offset = reg.offset;
+void arena_region_keep(ArenaRegion reg){
+	ensure(reg.arena->region_count > 0, "Arena has a improper region counter");
 	reg.arena->region_count -= 1;
 }
 
+
+static
+void* arena_allocator_func(void* impl, AllocatorMode mode, void* ptr, isize old_size, isize size, isize align){
+	Arena* a = impl;
+	(void)old_size;
+
+	switch(mode){
+	case AllocatorMode_Alloc:
+		return arena_alloc(a, size, align);
+	case AllocatorMode_Resize:
+		return arena_resize_in_place(a, ptr, size) ? ptr : NULL;
+	case AllocatorMode_Free:
+		break; /* Individual frees are a no-op */
+	case AllocatorMode_FreeAll:
+		arena_reset(a);
+		break;
+	}
+	return NULL;
+}
+
+Allocator arena_allocator(Arena* a){
+	return (Allocator){
+		.func = arena_allocator_func,
+		.impl = a,
+	};
+}
@@ -0,0 +1,65 @@
+#include "array.h"
+
+#define DYN_ARRAY_MIN_CAP 8
+
+bool (dyn_array_reserve_ex)(void** data, isize* cap, Allocator allocator, isize elem_size, isize elem_align, isize min_cap){
+	if(min_cap <= *cap){
+		return true;
+	}
+
+	isize new_cap = max(max(*cap * 2, min_cap), (isize)DYN_ARRAY_MIN_CAP);
+	void* new_data = mem_realloc(allocator, *data, *cap * elem_size, new_cap * elem_size, elem_align);
+	if(new_data == NULL){
+		return false;
+	}
+
+	*data = new_data;
+	*cap = new_cap;
+	return true;
+}
+
+bool (dyn_array_append_ex)(void** data, isize* len, isize* cap, Allocator allocator, isize elem_size, isize elem_align, void const* items, isize count){
+	ensure(count >= 0, "Invalid count");
+	if(!(dyn_array_reserve_ex)(data, cap, allocator, elem_size, elem_align, *len + count)){
+		return false;
+	}
+	mem_copy((byte*)*data + (*len * elem_size), items, count * elem_size);
+	*len += count;
+	return true;
+}
+
+void dyn_array_shrink_ex(void** data, isize len, isize* cap, Allocator allocator, isize elem_size, isize elem_align){
+	if(len == *cap){
+		return;
+	}
+	if(len == 0){
+		mem_free(allocator, *data, *cap * elem_size);
+		*data = NULL;
+		*cap = 0;
+		return;
+	}
+
+	void* new_data = mem_realloc(allocator, *data, *cap * elem_size, len * elem_size, elem_align);
+	if(new_data != NULL){
+		*data = new_data;
+		*cap = len;
+	}
+}
+
+#if defined(MEM_INSTRUMENT)
+bool dyn_array_reserve_site(void** data, isize* cap, Allocator allocator, isize elem_size, isize elem_align, isize min_cap, char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller_begin(file, line);
+	bool ok = (dyn_array_reserve_ex)(data, cap, allocator, elem_size, elem_align, min_cap);
+	mem_instrument_caller_end(prev);
+	return ok;
+}
+
+bool dyn_array_append_site(void** data, isize* len, isize* cap, Allocator allocator, isize elem_size, isize elem_align, void const* items, isize count, char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller_begin(file, line);
+	bool ok = (dyn_array_append_ex)(data, len, cap, allocator, elem_size, elem_align, items, count);
+	mem_instrument_caller_end(prev);
+	return ok;
+}
+#endif
+
+#undef DYN_ARRAY_MIN_CAP
@@ -0,0 +1,67 @@
+#pragma once
+#include "types.h"
+#include "memory.h"
+
+//// Dynamic array
+/* Declare concrete types with a typedef, e.g. `typedef DynArray(Token) TokenArray;`.
+ * Growth goes through mem_realloc, so an array that is the last allocation of
+ * an arena grows in place without copying. */
+#define DynArray(Type) struct { \
+	Type* v; \
+	isize len; \
+	isize cap; \
+	Allocator allocator; \
+}
+
+#define dyn_array_elem_size(A)  ((isize)sizeof(*(A)->v))
+#define dyn_array_elem_align(A) ((isize)alignof(typeof(*(A)->v)))
+
+#define dyn_array_create(Allocator_) { .v = NULL, .len = 0, .cap = 0, .allocator = (Allocator_) }
+
+/* Ensure capacity for at least N elements, returns false on allocation failure */
+#define dyn_array_reserve(A, N) \
+	dyn_array_reserve_ex((void**)&(A)->v, &(A)->cap, (A)->allocator, dyn_array_elem_size(A), dyn_array_elem_align(A), (N))
+
+#define dyn_array_push(A, ...) \
+	((((A)->len < (A)->cap) || dyn_array_reserve((A), (A)->len + 1)) \
+		? ((A)->v[(A)->len] = (__VA_ARGS__), (A)->len += 1, true) \
+		: false)
+
+/* Append Count elements from Items in a single copy */
+#define dyn_array_append(A, Items, Count) \
+	dyn_array_append_ex((void**)&(A)->v, &(A)->len, &(A)->cap, (A)->allocator, dyn_array_elem_size(A), dyn_array_elem_align(A), (Items), (Count))
+
+#define dyn_array_pop(A) \
+	(ensure((A)->len > 0, "Pop from empty array"), (A)->len -= 1, (A)->v[(A)->len])
+
+#define dyn_array_clear(A) ((void)((A)->len = 0))
+
+/* Release unused capacity, in place when the allocator allows it */
+#define dyn_array_shrink(A) \
+	dyn_array_shrink_ex((void**)&(A)->v, (A)->len, &(A)->cap, (A)->allocator, dyn_array_elem_size(A), dyn_array_elem_align(A))
+
+#define dyn_array_destroy(A) do { \
+	mem_free((A)->allocator, (A)->v, (A)->cap * dyn_array_elem_size(A)); \
+	(A)->v = NULL; \
+	(A)->len = 0; \
+	(A)->cap = 0; \
+} while(0)
+
+bool dyn_array_reserve_ex(void** data, isize* cap, Allocator allocator, isize elem_size, isize elem_align, isize min_cap);
+
+bool dyn_array_append_ex(void** data, isize* len, isize* cap, Allocator allocator, isize elem_size, isize elem_align, void const* items, isize count);
+
+void dyn_array_shrink_ex(void** data, isize len, isize* cap, Allocator allocator, isize elem_size, isize elem_align);
+
+/* Growth is charged to the line using the array, see MEM_INSTRUMENT */
+#if defined(MEM_INSTRUMENT)
+bool dyn_array_reserve_site(void** data, isize* cap, Allocator allocator, isize elem_size, isize elem_align, isize min_cap, char const* file, int line);
+
+bool dyn_array_append_site(void** data, isize* len, isize* cap, Allocator allocator, isize elem_size, isize elem_align, void const* items, isize count, char const* file, int line);
+
+#define dyn_array_reserve_ex(Data, Cap, Allocator_, ElemSize, ElemAlign, MinCap) \
+	dyn_array_reserve_site((Data), (Cap), (Allocator_), (ElemSize), (ElemAlign), (MinCap), __FILE__, __LINE__)
+
+#define dyn_array_append_ex(Data, Len, Cap, Allocator_, ElemSize, ElemAlign, Items, Count) \
+	dyn_array_append_site((Data), (Len), (Cap), (Allocator_), (ElemSize), (ElemAlign), (Items), (Count), __FILE__, __LINE__)
+#endif
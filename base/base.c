@@ -3,7 +3,16 @@
 #include "memory.c"
 #include "arena.c"
 #include "heap.c"
+#include "pool.c"
+#include "shared_arena.c"
+#include "instrument.c"
+#include "thread.c"
+#include "array.c"
+#include "hash_map.c"
+#include "intern.c"
 
 #include "utf8.c"
 #include "string.c"
 #include "format.c"
+#include "io.c"
+#include "string_builder.c"
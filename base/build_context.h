@@ -13,7 +13,7 @@
 
 #if defined(__linux__)
 	#define OS_LINUX 1
-	#define _DEFAULT_SOURCE
+	#define _GNU_SOURCE
 #elif defined(_WIN32) || defined(_WIN64)
 	#define OS_WINDOWS 1
 #else
@@ -2,15 +2,41 @@
 #include "types.h"
 #define STB_SPRINTF_IMPLEMENTATION
 #include "stb_sprintf.h"
+#undef STB_SPRINTF_IMPLEMENTATION
 #include <stdlib.h>
 
 String str_vformat(Arena* arena, char const * restrict fmt, va_list argp){
-	char* ptr = arena->data + arena->offset;
-	isize len = arena->capacity - arena->offset;
-	isize n = 1;
+	va_list retry;
+	va_copy(retry, argp);
 
-	n = stbsp_vsnprintf(ptr, len, fmt, argp);
-	arena->offset += n;
+	/* Format straight into the free space, only fall back to a real
+	 * allocation (and a second pass) when it doesn't fit */
+	char* ptr = (char*)arena->data + arena->offset;
+	isize available = min(arena->capacity - arena->offset, (isize)INT32_MAX);
+	isize n = 0;
+
+	if(available > 0){
+		n = stbsp_vsnprintf(ptr, (int)available, fmt, argp);
+	} else {
+		n = stbsp_vsnprintf(NULL, 0, fmt, argp);
+	}
+
+	if(n + 1 <= available){
+		arena->offset += n + 1; /* Keep the NUL terminator */
+		arena->last_allocation = ptr;
+#if defined(MEM_INSTRUMENT)
+		mem_instrument_raw_write(arena, n + 1);
+#endif
+	}
+	else {
+		ptr = arena_alloc(arena, n + 1, 1);
+		if(ptr == NULL){
+			va_end(retry);
+			return (String){0};
+		}
+		stbsp_vsnprintf(ptr, (int)(n + 1), fmt, retry);
+	}
+	va_end(retry);
 
 	String s = {
 		.v = (byte const*)ptr,
@@ -28,3 +54,320 @@ String str_format(Arena* arena, char const * restrict fmt, ...){
 	return s;
 }
 
+//// Number formatting
+#include "format_tables.h"
+
+static char const fmt_digit_pairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static u64 const fmt_pow10[20] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+	100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+	1000000000000ull, 10000000000000ull, 100000000000000ull,
+	1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+	1000000000000000000ull, 10000000000000000000ull,
+};
+
+/* Number of decimal digits, log10 estimated from the bit length */
+static inline
+i32 fmt_decimal_length(u64 v){
+	v |= 1;
+	i32 t = ((64 - bit_clz64(v)) * 1233) >> 12;
+	return t + (v >= fmt_pow10[t]);
+}
+
+/* Writes exactly len digits of v ending at buf + len, two at a time */
+static inline
+void fmt_write_digits(byte* buf, u64 v, i32 len){
+	byte* p = buf + len;
+	while(v >= 100){
+		u64 q = v / 100;
+		u32 r = (u32)(v - q * 100);
+		p -= 2;
+		p[0] = fmt_digit_pairs[r * 2];
+		p[1] = fmt_digit_pairs[r * 2 + 1];
+		v = q;
+	}
+	if(v >= 10){
+		p -= 2;
+		p[0] = fmt_digit_pairs[v * 2];
+		p[1] = fmt_digit_pairs[v * 2 + 1];
+	}
+	else {
+		p -= 1;
+		p[0] = (byte)('0' + v);
+	}
+}
+
+isize fmt_u64(byte* buf, u64 v){
+	i32 len = fmt_decimal_length(v);
+	fmt_write_digits(buf, v, len);
+	return len;
+}
+
+isize fmt_i64(byte* buf, i64 v){
+	if(v < 0){
+		buf[0] = '-';
+		return 1 + fmt_u64(buf + 1, -(u64)v);
+	}
+	return fmt_u64(buf, (u64)v);
+}
+
+/* Shortest round-trip conversion after Ryu (Ulf Adams, PLDI 2018). The
+ * interval of reals that round to the input is scaled by a power of 10 using
+ * the 125 bit tables, then digits are removed while both ends of the interval
+ * still differ. The result is the shortest decimal that parses back to the
+ * same double, the closest one when several have that length. */
+typedef struct {
+	u64 digits;
+	i32 exponent; /* value = digits * 10^exponent */
+} FmtDecimal;
+
+static inline
+i32 fmt_pow5_bits(i32 e){
+	return ((e * 1217359) >> 19) + 1;
+}
+
+static inline
+i32 fmt_log10_pow2(i32 e){
+	return (e * 78913) >> 18;
+}
+
+static inline
+i32 fmt_log10_pow5(i32 e){
+	return (e * 732923) >> 20;
+}
+
+static inline
+bool fmt_multiple_of_pow5(u64 v, i32 p){
+	i32 count = 0;
+	while(v % 5 == 0){
+		v /= 5;
+		count += 1;
+	}
+	return count >= p;
+}
+
+static inline
+bool fmt_multiple_of_pow2(u64 v, i32 p){
+	return (v & ((1ull << p) - 1)) == 0;
+}
+
+/* (m * mul) >> j, where mul is a 125 bit table entry and 64 < j < 128 */
+static inline
+u64 fmt_mul_shift64(u64 m, u64 const* mul, i32 j){
+#if defined(COMPILER_MSVC)
+	u64 high0 = 0, high1 = 0;
+	_umul128(m, mul[0], &high0);
+	u64 low1 = _umul128(m, mul[1], &high1);
+	u64 sum = high0 + low1;
+	high1 += sum < high0;
+	i32 dist = j - 64;
+	return (high1 << (64 - dist)) | (sum >> dist);
+#else
+	__uint128_t b0 = (__uint128_t)m * mul[0];
+	__uint128_t b2 = (__uint128_t)m * mul[1];
+	return (u64)(((b0 >> 64) + b2) >> (j - 64));
+#endif
+}
+
+static
+FmtDecimal fmt_f64_decimal(u64 mantissa, i32 exponent){
+	i32 e2 = 0;
+	u64 m2 = 0;
+	if(exponent == 0){
+		e2 = 1 - 1023 - 52 - 2;
+		m2 = mantissa;
+	}
+	else {
+		e2 = exponent - 1023 - 52 - 2;
+		m2 = (1ull << 52) | mantissa;
+	}
+	bool accept_bounds = (m2 & 1) == 0;
+
+	/* Interval [mm, mp] around mv = 4 * m2, the lower bound is closer when
+	 * the mantissa is zero (exponent boundary) */
+	u64 mv = 4 * m2;
+	u32 mm_shift = mantissa != 0 || exponent <= 1;
+
+	u64 vr = 0, vp = 0, vm = 0;
+	i32 e10 = 0;
+	bool vm_trailing_zeros = false;
+	bool vr_trailing_zeros = false;
+
+	if(e2 >= 0){
+		i32 q = fmt_log10_pow2(e2) - (e2 > 3);
+		i32 k = FMT_POW5_INV_BITCOUNT + fmt_pow5_bits(q) - 1;
+		i32 i = -e2 + q + k;
+		e10 = q;
+		vr = fmt_mul_shift64(4 * m2, fmt_pow5_inv_split[q], i);
+		vp = fmt_mul_shift64(4 * m2 + 2, fmt_pow5_inv_split[q], i);
+		vm = fmt_mul_shift64(4 * m2 - 1 - mm_shift, fmt_pow5_inv_split[q], i);
+		if(q <= 21){
+			if(mv % 5 == 0){
+				vr_trailing_zeros = fmt_multiple_of_pow5(mv, q);
+			}
+			else if(accept_bounds){
+				vm_trailing_zeros = fmt_multiple_of_pow5(mv - 1 - mm_shift, q);
+			}
+			else {
+				vp -= fmt_multiple_of_pow5(mv + 2, q);
+			}
+		}
+	}
+	else {
+		i32 q = fmt_log10_pow5(-e2) - (-e2 > 1);
+		i32 i = -e2 - q;
+		i32 k = fmt_pow5_bits(i) - FMT_POW5_BITCOUNT;
+		i32 j = q - k;
+		e10 = q + e2;
+		vr = fmt_mul_shift64(4 * m2, fmt_pow5_split[i], j);
+		vp = fmt_mul_shift64(4 * m2 + 2, fmt_pow5_split[i], j);
+		vm = fmt_mul_shift64(4 * m2 - 1 - mm_shift, fmt_pow5_split[i], j);
+		if(q <= 1){
+			vr_trailing_zeros = true;
+			if(accept_bounds){
+				vm_trailing_zeros = mm_shift == 1;
+			}
+			else {
+				vp -= 1;
+			}
+		}
+		else if(q < 63){
+			vr_trailing_zeros = fmt_multiple_of_pow2(mv, q);
+		}
+	}
+
+	i32 removed = 0;
+	u64 output = 0;
+	if(vm_trailing_zeros || vr_trailing_zeros){
+		/* Rare: exact ties need to know whether the removed digits were all zero */
+		u32 last_removed = 0;
+		while(vp / 10 > vm / 10){
+			vm_trailing_zeros &= vm % 10 == 0;
+			vr_trailing_zeros &= last_removed == 0;
+			last_removed = (u32)(vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed += 1;
+		}
+		if(vm_trailing_zeros){
+			while(vm % 10 == 0){
+				vr_trailing_zeros &= last_removed == 0;
+				last_removed = (u32)(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed += 1;
+			}
+		}
+		if(vr_trailing_zeros && last_removed == 5 && vr % 2 == 0){
+			last_removed = 4; /* Round half to even */
+		}
+		output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+	}
+	else {
+		bool round_up = false;
+		if(vp / 100 > vm / 100){
+			round_up = vr % 100 >= 50;
+			vr /= 100;
+			vp /= 100;
+			vm /= 100;
+			removed += 2;
+		}
+		while(vp / 10 > vm / 10){
+			round_up = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed += 1;
+		}
+		output = vr + (vr == vm || round_up);
+	}
+
+	return (FmtDecimal){ .digits = output, .exponent = e10 + removed };
+}
+
+/* Plain notation for 1e-6 <= |v| < 1e21, scientific otherwise (the same
+ * rules as JavaScript's Number.toString) */
+isize fmt_f64(byte* buf, f64 v){
+	u64 bits = 0;
+	mem_copy_no_overlap(&bits, &v, sizeof(bits));
+	bool sign = (bits >> 63) != 0;
+	u64 mantissa = bits & ((1ull << 52) - 1);
+	i32 exponent = (i32)((bits >> 52) & 0x7ff);
+
+	isize n = 0;
+	if(exponent == 0x7ff){
+		if(mantissa != 0){
+			mem_copy_no_overlap(buf, "nan", 3);
+			return 3;
+		}
+		if(sign){ buf[n++] = '-'; }
+		mem_copy_no_overlap(buf + n, "inf", 3);
+		return n + 3;
+	}
+
+	if(sign){ buf[n++] = '-'; }
+	if(exponent == 0 && mantissa == 0){
+		buf[n++] = '0';
+		return n;
+	}
+
+	FmtDecimal d = fmt_f64_decimal(mantissa, exponent);
+	i32 len = fmt_decimal_length(d.digits);
+	i32 sci = d.exponent + len - 1;
+
+	if(sci < -6 || sci >= 21){
+		/* d.ddde[+-]x */
+		fmt_write_digits(buf + n + 1, d.digits, len);
+		buf[n] = buf[n + 1];
+		if(len > 1){
+			buf[n + 1] = '.';
+			n += len + 1;
+		} else {
+			n += 1;
+		}
+		buf[n++] = 'e';
+		buf[n++] = sci < 0 ? '-' : '+';
+		n += fmt_u64(buf + n, (u64)(sci < 0 ? -sci : sci));
+	}
+	else if(d.exponent >= 0){
+		/* ddd000 */
+		fmt_write_digits(buf + n, d.digits, len);
+		n += len;
+		mem_set(buf + n, '0', d.exponent);
+		n += d.exponent;
+	}
+	else if(sci >= 0){
+		/* dd.ddd */
+		fmt_write_digits(buf + n + 1, d.digits, len);
+		mem_copy(buf + n, buf + n + 1, sci + 1);
+		buf[n + sci + 1] = '.';
+		n += len + 1;
+	}
+	else {
+		/* 0.000ddd */
+		i32 zeros = -sci - 1;
+		buf[n++] = '0';
+		buf[n++] = '.';
+		mem_set(buf + n, '0', zeros);
+		n += zeros;
+		fmt_write_digits(buf + n, d.digits, len);
+		n += len;
+	}
+	return n;
+}
+
+#undef FMT_POW5_INV_BITCOUNT
+#undef FMT_POW5_BITCOUNT
@@ -0,0 +1,337 @@
+#include "hash_map.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define HASH_MAP_SSE2 1
+#endif
+
+#define HASH_P0 0xa0761d6478bd642full
+#define HASH_P1 0xe7037ed1a0b428dbull
+#define HASH_P2 0x8ebc6af09c88c6e3ull
+
+#define HASH_MAP_GROUP    16
+#define HASH_MAP_EMPTY    ((u8)0x80)
+#define HASH_MAP_MIN_CAP  16
+
+static inline
+u64 hash_mul_fold(u64 a, u64 b){
+#if defined(COMPILER_MSVC)
+	u64 hi = 0;
+	u64 lo = _umul128(a, b, &hi);
+	return lo ^ hi;
+#else
+	__uint128_t r = (__uint128_t)a * b;
+	return (u64)r ^ (u64)(r >> 64);
+#endif
+}
+
+static inline
+u64 hash_read64(byte const* p){
+	u64 v;
+	mem_copy_no_overlap(&v, p, 8);
+	return v;
+}
+
+static inline
+u64 hash_read32(byte const* p){
+	u32 v;
+	mem_copy_no_overlap(&v, p, 4);
+	return v;
+}
+
+/* wyhash style: fold 16 bytes per round with a 64x64->128 multiply */
+u64 hash_bytes(void const* data, isize len){
+	byte const* p = data;
+	u64 seed = HASH_P0 ^ (u64)len;
+	u64 a = 0, b = 0;
+
+	if(len <= 16){
+		if(len >= 4){
+			isize mid = (len >> 3) << 2;
+			a = (hash_read32(p) << 32) | hash_read32(p + mid);
+			b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - mid);
+		}
+		else if(len > 0){
+			a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+		}
+	}
+	else {
+		isize i = len;
+		while(i > 16){
+			seed = hash_mul_fold(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = hash_read64(p + i - 16);
+		b = hash_read64(p + i - 8);
+	}
+
+	return hash_mul_fold(HASH_P1 ^ (u64)len, hash_mul_fold(a ^ HASH_P1, b ^ seed));
+}
+
+u64 hash_u64(u64 x){
+	return hash_mul_fold(x ^ HASH_P0, HASH_P2);
+}
+
+//// Map internals
+static inline
+u8 hash_map_tag(u64 hash){
+	return (u8)(hash & 0x7f);
+}
+
+/* Bitmask of the bytes in ctrl[0..16) equal to tag */
+static inline
+u32 hash_map_match(u8 const* ctrl, u8 tag){
+#if defined(HASH_MAP_SSE2)
+	__m128i group = _mm_loadu_si128((__m128i const*)ctrl);
+	return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+	u32 mask = 0;
+	for(int i = 0; i < HASH_MAP_GROUP; i += 1){
+		mask |= (u32)(ctrl[i] == tag) << i;
+	}
+	return mask;
+#endif
+}
+
+static inline
+u64* hash_map_slot_hash(HashMap const* m, isize idx){
+	return (u64*)(m->slots + idx * m->slot_size);
+}
+
+static inline
+void* hash_map_slot_key(HashMap const* m, isize idx){
+	return m->slots + idx * m->slot_size + sizeof(u64);
+}
+
+static inline
+void* hash_map_slot_value(HashMap const* m, isize idx){
+	return m->slots + idx * m->slot_size + m->value_offset;
+}
+
+static inline
+void hash_map_set_ctrl(HashMap* m, isize idx, u8 c){
+	m->ctrl[idx] = c;
+	if(idx < HASH_MAP_GROUP - 1){
+		m->ctrl[m->cap + idx] = c;
+	}
+}
+
+static inline
+bool hash_map_key_equal(HashMap const* m, void const* stored, void const* key){
+	if(m->key_kind == MapKey_String){
+		String const* l = stored;
+		String const* r = key;
+		return l->len == r->len && mem_compare(l->v, r->v, l->len) == 0;
+	}
+	return mem_compare(stored, key, m->key_size) == 0;
+}
+
+static
+isize hash_map_find(HashMap const* m, void const* key, u64 hash){
+	if(m->cap == 0){
+		return -1;
+	}
+
+	isize mask = m->cap - 1;
+	isize pos = (isize)(hash >> 7) & mask;
+	u8 tag = hash_map_tag(hash);
+
+	for(;;){
+		u32 hits = hash_map_match(m->ctrl + pos, tag);
+		while(hits != 0){
+			isize idx = (pos + bit_ctz32(hits)) & mask;
+			if(*hash_map_slot_hash(m, idx) == hash && hash_map_key_equal(m, hash_map_slot_key(m, idx), key)){
+				return idx;
+			}
+			hits &= hits - 1;
+		}
+		if(hash_map_match(m->ctrl + pos, HASH_MAP_EMPTY) != 0){
+			return -1;
+		}
+		pos = (pos + HASH_MAP_GROUP) & mask;
+	}
+}
+
+/* First empty slot on the probe sequence of hash, the map must not be full */
+static
+isize hash_map_find_empty(HashMap const* m, u64 hash){
+	isize mask = m->cap - 1;
+	isize pos = (isize)(hash >> 7) & mask;
+	for(;;){
+		u32 empty = hash_map_match(m->ctrl + pos, HASH_MAP_EMPTY);
+		if(empty != 0){
+			return (pos + bit_ctz32(empty)) & mask;
+		}
+		pos = (pos + HASH_MAP_GROUP) & mask;
+	}
+}
+
+static
+bool hash_map_rehash(HashMap* m, isize new_cap){
+	isize ctrl_size = mem_align_forward_size(new_cap + HASH_MAP_GROUP - 1, m->slot_align);
+	isize total = ctrl_size + new_cap * m->slot_size;
+
+	byte* mem = mem_alloc(m->allocator, total, max(m->slot_align, (isize)HASH_MAP_GROUP));
+	if(mem == NULL){
+		return false;
+	}
+
+	HashMap old = *m;
+	m->ctrl  = mem;
+	m->slots = mem + ctrl_size;
+	m->cap   = new_cap;
+	mem_set(m->ctrl, HASH_MAP_EMPTY, new_cap + HASH_MAP_GROUP - 1);
+
+	for(isize i = 0; i < old.cap; i += 1){
+		if(old.ctrl[i] == HASH_MAP_EMPTY){ continue; }
+
+		u64 hash = *hash_map_slot_hash(&old, i);
+		isize idx = hash_map_find_empty(m, hash);
+		hash_map_set_ctrl(m, idx, hash_map_tag(hash));
+		mem_copy_no_overlap(m->slots + idx * m->slot_size, old.slots + i * old.slot_size, m->slot_size);
+	}
+
+	if(old.cap > 0){
+		isize old_ctrl_size = mem_align_forward_size(old.cap + HASH_MAP_GROUP - 1, old.slot_align);
+		mem_free(m->allocator, old.ctrl, old_ctrl_size + old.cap * old.slot_size);
+	}
+	return true;
+}
+
+//// Public API
+HashMap hash_map_create(Allocator allocator, isize key_size, isize key_align, isize value_size, isize value_align, MapKeyKind key_kind){
+	ensure(key_align <= (isize)alignof(u64), "Key alignment too large");
+	isize slot_align   = max((isize)alignof(u64), value_align);
+	isize value_offset = mem_align_forward_size(sizeof(u64) + key_size, max(value_align, (isize)1));
+	isize slot_size    = mem_align_forward_size(value_offset + value_size, slot_align);
+
+	return (HashMap){
+		.key_size = key_size,
+		.value_size = value_size,
+		.value_offset = value_offset,
+		.slot_size = slot_size,
+		.slot_align = slot_align,
+		.key_kind = key_kind,
+		.allocator = allocator,
+	};
+}
+
+u64 hash_map_hash(HashMap const* m, void const* key){
+	if(m->key_kind == MapKey_String){
+		return hash_string(*(String const*)key);
+	}
+	if(m->key_size == sizeof(u64)){
+		u64 k;
+		mem_copy_no_overlap(&k, key, sizeof(k));
+		return hash_u64(k);
+	}
+	if(m->key_size == sizeof(u32)){
+		u32 k;
+		mem_copy_no_overlap(&k, key, sizeof(k));
+		return hash_u64(k);
+	}
+	return hash_bytes(key, m->key_size);
+}
+
+void* hash_map_get_hashed(HashMap* m, void const* key, u64 hash){
+	isize idx = hash_map_find(m, key, hash);
+	return idx < 0 ? NULL : hash_map_slot_value(m, idx);
+}
+
+void* hash_map_get(HashMap* m, void const* key){
+	return hash_map_get_hashed(m, key, hash_map_hash(m, key));
+}
+
+bool hash_map_reserve(HashMap* m, isize count){
+	/* Keep the load factor at or below 7/8 */
+	isize needed = max((isize)HASH_MAP_MIN_CAP, count + count / 7 + 1);
+	if(needed <= m->cap){
+		return true;
+	}
+	isize new_cap = max(m->cap, (isize)HASH_MAP_MIN_CAP);
+	while(new_cap < needed){
+		new_cap *= 2;
+	}
+	return hash_map_rehash(m, new_cap);
+}
+
+void* hash_map_insert_hashed(HashMap* m, void const* key, u64 hash, void const* value){
+	isize idx = hash_map_find(m, key, hash);
+	if(idx < 0){
+		if(!hash_map_reserve(m, m->len + 1)){
+			return NULL;
+		}
+		idx = hash_map_find_empty(m, hash);
+		hash_map_set_ctrl(m, idx, hash_map_tag(hash));
+		*hash_map_slot_hash(m, idx) = hash;
+		mem_copy_no_overlap(hash_map_slot_key(m, idx), key, m->key_size);
+		m->len += 1;
+	}
+
+	void* slot_value = hash_map_slot_value(m, idx);
+	if(value != NULL){
+		mem_copy_no_overlap(slot_value, value, m->value_size);
+	} else {
+		mem_set(slot_value, 0, m->value_size);
+	}
+	return slot_value;
+}
+
+void* hash_map_insert(HashMap* m, void const* key, void const* value){
+	return hash_map_insert_hashed(m, key, hash_map_hash(m, key), value);
+}
+
+bool hash_map_remove_hashed(HashMap* m, void const* key, u64 hash){
+	isize hole = hash_map_find(m, key, hash);
+	if(hole < 0){
+		return false;
+	}
+
+	/* Backward shift: pull later entries of the run into the hole as long as
+	 * that doesn't move them in front of their home slot. */
+	isize mask = m->cap - 1;
+	for(isize j = (hole + 1) & mask; m->ctrl[j] != HASH_MAP_EMPTY; j = (j + 1) & mask){
+		isize home = (isize)(*hash_map_slot_hash(m, j) >> 7) & mask;
+		bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+		if(stays){ continue; }
+
+		hash_map_set_ctrl(m, hole, m->ctrl[j]);
+		mem_copy_no_overlap(m->slots + hole * m->slot_size, m->slots + j * m->slot_size, m->slot_size);
+		hole = j;
+	}
+
+	hash_map_set_ctrl(m, hole, HASH_MAP_EMPTY);
+	m->len -= 1;
+	return true;
+}
+
+bool hash_map_remove(HashMap* m, void const* key){
+	return hash_map_remove_hashed(m, key, hash_map_hash(m, key));
+}
+
+void hash_map_clear(HashMap* m){
+	if(m->cap > 0){
+		mem_set(m->ctrl, HASH_MAP_EMPTY, m->cap + HASH_MAP_GROUP - 1);
+	}
+	m->len = 0;
+}
+
+void hash_map_destroy(HashMap* m){
+	if(m->cap > 0){
+		isize ctrl_size = mem_align_forward_size(m->cap + HASH_MAP_GROUP - 1, m->slot_align);
+		mem_free(m->allocator, m->ctrl, ctrl_size + m->cap * m->slot_size);
+	}
+	m->ctrl = NULL;
+	m->slots = NULL;
+	m->cap = 0;
+	m->len = 0;
+}
+
+#undef HASH_P0
+#undef HASH_P1
+#undef HASH_P2
+#undef HASH_MAP_GROUP
+#undef HASH_MAP_EMPTY
+#undef HASH_MAP_MIN_CAP
+#undef HASH_MAP_SSE2
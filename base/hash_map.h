@@ -0,0 +1,78 @@
+#pragma once
+#include "types.h"
+#include "memory.h"
+
+//// Hashing
+u64 hash_bytes(void const* data, isize len);
+
+u64 hash_u64(u64 x);
+
+static inline
+u64 hash_string(String s){
+	return hash_bytes(s.v, s.len);
+}
+
+//// Hash map
+/* Open addressing map with SIMD control byte probing. Each slot has one
+ * control byte: 0x80 when empty, or the low 7 bits of its hash when full.
+ * Lookups compare 16 control bytes at a time against the 7 bit tag and only
+ * look at keys on a match. Probing is linear, so deletion shifts the rest of
+ * the run back instead of leaving tombstones.
+ *
+ * Keys are either raw bytes (integers, atoms, small PODs) compared with
+ * memcmp, or String compared by contents. String bytes are not copied and
+ * must outlive the map. Slots keep the full hash, so growing never rehashes
+ * keys and precomputed hashes stay valid. Value pointers are invalidated by
+ * the next insert or remove. */
+typedef enum {
+	MapKey_Bytes,
+	MapKey_String,
+} MapKeyKind;
+
+typedef struct {
+	u8* ctrl;    /* cap + 15 bytes, the last 15 mirror the first so a 16 byte window never wraps */
+	byte* slots; /* cap slots of slot_size: [u64 hash][key][value] */
+	isize cap;   /* Power of 2, 0 until first insert */
+	isize len;
+
+	isize key_size;
+	isize value_size;
+	isize value_offset;
+	isize slot_size;
+	isize slot_align;
+	MapKeyKind key_kind;
+
+	Allocator allocator;
+} HashMap;
+
+#define hash_map_key_kind(K) _Generic((K){0}, String: MapKey_String, default: MapKey_Bytes)
+
+/* Typed helper: hash_map_make(alloc, String, i32) */
+#define hash_map_make(Allocator_, K, V) \
+	hash_map_create((Allocator_), sizeof(K), alignof(K), sizeof(V), alignof(V), hash_map_key_kind(K))
+
+HashMap hash_map_create(Allocator allocator, isize key_size, isize key_align, isize value_size, isize value_align, MapKeyKind key_kind);
+
+u64 hash_map_hash(HashMap const* m, void const* key);
+
+/* Returns a pointer to the value, or NULL if key is not present */
+void* hash_map_get(HashMap* m, void const* key);
+
+void* hash_map_get_hashed(HashMap* m, void const* key, u64 hash);
+
+/* Inserts or overwrites, value may be NULL to zero it. Returns a pointer to
+ * the stored value, or NULL on allocation failure. */
+void* hash_map_insert(HashMap* m, void const* key, void const* value);
+
+void* hash_map_insert_hashed(HashMap* m, void const* key, u64 hash, void const* value);
+
+bool hash_map_remove(HashMap* m, void const* key);
+
+bool hash_map_remove_hashed(HashMap* m, void const* key, u64 hash);
+
+/* Make room for `count` entries without growing */
+bool hash_map_reserve(HashMap* m, isize count);
+
+void hash_map_clear(HashMap* m);
+
+void hash_map_destroy(HashMap* m);
@@ -1,36 +1,334 @@
 #include "memory.h"
-#include <stdlib.h>
 
-void* heap_alloc(isize size, isize align){
+/* Size-class heap allocator.
+ *
+ * Small requests are rounded up to one of HEAP_CLASS_COUNT size classes and
+ * carved out of HEAP_SPAN_SIZE spans. Every span starts with a HeapSpan header
+ * on a HEAP_SPAN_SIZE boundary, so the header of any pointer is found by
+ * masking. Freed blocks go into a per-thread cache which trades batches with a
+ * central, locked free list for its class.
+ *
+ * Large requests get a mapping of their own, with a header laid out the same
+ * way so heap_free and heap_usable_size can tell both kinds apart. */
+
+#define HEAP_SPAN_SIZE    (256 * mem_kilobyte)
+#define HEAP_SEGMENT_SIZE (16 * HEAP_SPAN_SIZE)
+#define HEAP_SMALL_MAX    (16 * mem_kilobyte)
+#define HEAP_MIN_ALIGN    ((isize)16)
+#define HEAP_CLASS_COUNT  36
+#define HEAP_CACHE_LIMIT  64 /* Blocks per class a thread keeps before flushing */
+
+typedef struct HeapSpan HeapSpan;
+struct HeapSpan {
+	i32 size_class; /* -1 for large allocations */
+	void* map_base;
+	isize map_size;
+};
+
+typedef struct HeapBlock HeapBlock;
+struct HeapBlock {
+	HeapBlock* next;
+};
+
+typedef struct {
+	atomic_int lock;
+	HeapBlock* free_list;
+	byte* bump;
+	byte* bump_end;
+} HeapCentral;
+
+typedef struct {
+	HeapBlock* head;
+	i32 count;
+} HeapCacheBin;
+
+static HeapCentral heap_central[HEAP_CLASS_COUNT];
+
+static struct {
+	atomic_int lock;
+	byte* current;
+	byte* end;
+} heap_segment;
+
+static thread_local HeapCacheBin heap_cache[HEAP_CLASS_COUNT];
+
+static inline
+void heap_lock(atomic_int* lock){
+	while(atomic_exchange_explicit(lock, 1, memory_order_acquire)){
+		while(atomic_load_explicit(lock, memory_order_relaxed)){}
+	}
+}
+
+static inline
+void heap_unlock(atomic_int* lock){
+	atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+/* 16 to 128 in steps of 16, then 4 classes per doubling up to HEAP_SMALL_MAX */
+static inline
+isize heap_class_size(i32 c){
+	if(c < 8){
+		return (c + 1) * 16;
+	}
+	i32 k = (c - 8) / 4;
+	i32 j = (c - 8) % 4;
+	return (128ll << k) + (j + 1) * (32ll << k);
+}
+
+/* Smallest class fitting size whose blocks are naturally aligned to align, -1 if none */
+static inline
+i32 heap_size_class(isize size, isize align){
+	size = max(size, align);
+	if(size > HEAP_SMALL_MAX){
+		return -1;
+	}
+
+	i32 c = 0;
+	if(size <= 128){
+		c = (i32)((max(size, (isize)1) + 15) / 16) - 1;
+	}
+	else {
+		u64 s = (u64)size - 1;
+		i32 msb = 63 - bit_clz64(s);
+		c = 8 + (msb - 7) * 4 + (i32)((s >> (msb - 2)) & 3);
+	}
+
+	for(; c < HEAP_CLASS_COUNT; c += 1){
+		isize class_size = heap_class_size(c);
+		if((class_size & -class_size) >= align){
+			return c;
+		}
+	}
+	return -1;
+}
+
+static inline
+i32 heap_batch_size(i32 c){
+	return (i32)clamp((isize)2, (64 * mem_kilobyte) / heap_class_size(c), (isize)32);
+}
+
+static inline
+HeapSpan* heap_span_of(void* ptr){
+	return (HeapSpan*)(((uintptr)ptr - 1) & ~(uintptr)(HEAP_SPAN_SIZE - 1));
+}
+
+static
+byte* heap_span_acquire(){
+	heap_lock(&heap_segment.lock);
+	if(heap_segment.current == heap_segment.end){
+		byte* segment = mem_os_map(HEAP_SEGMENT_SIZE, HEAP_SPAN_SIZE);
+		if(segment == NULL){
+			heap_unlock(&heap_segment.lock);
+			return NULL;
+		}
+		heap_segment.current = segment;
+		heap_segment.end = segment + HEAP_SEGMENT_SIZE;
+	}
+	byte* span = heap_segment.current;
+	heap_segment.current += HEAP_SPAN_SIZE;
+	heap_unlock(&heap_segment.lock);
+	return span;
+}
+
+/* Move up to count blocks from the central list (or fresh spans) into bin */
+static
+void heap_central_take(i32 c, HeapCacheBin* bin, i32 count){
+	HeapCentral* central = &heap_central[c];
+	isize size = heap_class_size(c);
+
+	heap_lock(&central->lock);
+	for(i32 i = 0; i < count; i += 1){
+		HeapBlock* block = central->free_list;
+		if(block != NULL){
+			central->free_list = block->next;
+		}
+		else {
+			if((central->bump_end - central->bump) < size){
+				byte* span = heap_span_acquire();
+				if(span == NULL){ break; }
+
+				((HeapSpan*)span)->size_class = c;
+				central->bump = span + mem_align_forward_size(sizeof(HeapSpan), size & -size);
+				central->bump_end = span + HEAP_SPAN_SIZE;
+			}
+			block = (HeapBlock*)central->bump;
+			central->bump += size;
+		}
+
+		block->next = bin->head;
+		bin->head = block;
+		bin->count += 1;
+	}
+	heap_unlock(&central->lock);
+}
+
+static
+void heap_central_give(i32 c, HeapCacheBin* bin, i32 count){
+	HeapCentral* central = &heap_central[c];
+
+	heap_lock(&central->lock);
+	for(i32 i = 0; i < count && bin->head != NULL; i += 1){
+		HeapBlock* block = bin->head;
+		bin->head = block->next;
+		bin->count -= 1;
+
+		block->next = central->free_list;
+		central->free_list = block;
+	}
+	heap_unlock(&central->lock);
+}
+
+static
+void* heap_alloc_large(isize size, isize align){
+	isize offset   = mem_align_forward_size(sizeof(HeapSpan), align);
+	isize map_size = mem_align_forward_size(offset + size, mem_os_page_size());
+
+	byte* base = mem_os_map(map_size, max(align, HEAP_SPAN_SIZE));
+	ensure(base != NULL, "Heap allocation failed");
+
+	/* For alignments above the span size the header sits right below ptr's span boundary */
+	byte* ptr = base + offset;
+	HeapSpan* span = heap_span_of(ptr);
+	span->size_class = -1;
+	span->map_base = base;
+	span->map_size = map_size;
+	return ptr;
+}
+
+void* (heap_alloc)(isize size, isize align){
 	ensure(mem_valid_alignment(align), "Invalid alignment");
-	align = max(align, (isize)alignof(void*));
+	ensure(size >= 0, "Invalid size");
+	align = max(align, HEAP_MIN_ALIGN);
+
+	i32 c = heap_size_class(size, align);
+	if(c < 0){
+		return heap_alloc_large(size, align);
+	}
+
+	HeapCacheBin* bin = &heap_cache[c];
+	if(bin->head == NULL){
+		heap_central_take(c, bin, heap_batch_size(c));
+		ensure(bin->head != NULL, "Heap allocation failed");
+	}
 
-	isize space = align - 1 + sizeof(void*) + size;
-	void* allocated_mem = calloc(space, 1);
+	HeapBlock* block = bin->head;
+	bin->head = block->next;
+	bin->count -= 1;
+	return block;
+}
 
-	ensure(allocated_mem != NULL, "Heap allocation failed");
-	void* aligned_mem = (void*)((uintptr)allocated_mem + sizeof(void*));
+isize heap_usable_size(void* ptr){
+	if(ptr == NULL){
+		return 0;
+	}
+	HeapSpan* span = heap_span_of(ptr);
+	if(span->size_class < 0){
+		return ((byte*)span->map_base + span->map_size) - (byte*)ptr;
+	}
+	return heap_class_size(span->size_class);
+}
 
-	/* Align the pointer by rounding down */ {
-		uintptr aligned_ptr = 0;
-		uintptr p = (uintptr)aligned_mem;
-		uintptr a = (uintptr)align;
-		aligned_ptr = (p + a - 1) & ~(a - 1);
+bool heap_resize_in_place(void* ptr, isize new_size){
+	if(ptr == NULL){
+		return false;
+	}
+	if(new_size <= heap_usable_size(ptr)){
+		return true;
+	}
 
-		aligned_mem = (void*)aligned_ptr;
-	};
+	HeapSpan* span = heap_span_of(ptr);
+	if(span->size_class < 0){
+		isize map_size = ((byte*)ptr - (byte*)span->map_base) + new_size;
+		map_size = mem_align_forward_size(map_size, mem_os_page_size());
+		if(mem_os_extend(span->map_base, span->map_size, map_size)){
+			span->map_size = map_size;
+			return true;
+		}
+	}
+	return false;
+}
 
-	/* Store actual memory address before the aligned one */ {
-		void** ptr_loc = ((void**)aligned_mem) - 1;
-		*ptr_loc = allocated_mem;
+void* heap_realloc(void* ptr, isize new_size, isize align){
+	if(ptr == NULL){
+		return heap_alloc(new_size, align);
 	}
+	ensure(mem_valid_alignment(align), "Invalid alignment");
+	align = max(align, HEAP_MIN_ALIGN);
+
+	isize old_size = heap_usable_size(ptr);
+	bool aligned = ((uintptr)ptr & (uintptr)(align - 1)) == 0;
 
-	return aligned_mem;
+	if(aligned && heap_resize_in_place(ptr, new_size)){
+		return ptr;
+	}
+
+	void* new_ptr = heap_alloc(new_size, align);
+	mem_copy_no_overlap(new_ptr, ptr, min(old_size, new_size));
+	heap_free(ptr);
+	return new_ptr;
 }
 
 void heap_free(void* ptr){
-	void** pointer_array = (void**)ptr;
-	void* actual_memory = pointer_array[-1];
-	free(actual_memory);
+	if(ptr == NULL){
+		return;
+	}
+
+	HeapSpan* span = heap_span_of(ptr);
+	if(span->size_class < 0){
+		mem_os_unmap(span->map_base, span->map_size);
+		return;
+	}
+
+	i32 c = span->size_class;
+	HeapCacheBin* bin = &heap_cache[c];
+	HeapBlock* block = ptr;
+	block->next = bin->head;
+	bin->head = block;
+	bin->count += 1;
+
+	if(bin->count > HEAP_CACHE_LIMIT){
+		heap_central_give(c, bin, heap_batch_size(c));
+	}
+}
+
+void heap_thread_flush(){
+	for(i32 c = 0; c < HEAP_CLASS_COUNT; c += 1){
+		HeapCacheBin* bin = &heap_cache[c];
+		if(bin->head != NULL){
+			heap_central_give(c, bin, bin->count);
+		}
+	}
+}
+
+static
+void* heap_allocator_func(void* impl, AllocatorMode mode, void* ptr, isize old_size, isize size, isize align){
+	(void)impl;
+	(void)old_size;
+
+	switch(mode){
+	case AllocatorMode_Alloc:
+		return heap_alloc(size, align);
+	case AllocatorMode_Resize:
+		return heap_resize_in_place(ptr, size) ? ptr : NULL;
+	case AllocatorMode_Free:
+		heap_free(ptr);
+		break;
+	case AllocatorMode_FreeAll:
+		break; /* Not supported */
+	}
+	return NULL;
+}
+
+Allocator heap_allocator(){
+	return (Allocator){
+		.func = heap_allocator_func,
+		.impl = NULL,
+	};
 }
 
+#undef HEAP_SPAN_SIZE
+#undef HEAP_SEGMENT_SIZE
+#undef HEAP_SMALL_MAX
+#undef HEAP_MIN_ALIGN
+#undef HEAP_CLASS_COUNT
+#undef HEAP_CACHE_LIMIT
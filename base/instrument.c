@@ -0,0 +1,337 @@
+#include "memory.h"
+
+#if defined(MEM_INSTRUMENT)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_INSTRUMENT_MAX_ARENAS 256
+#define MEM_INSTRUMENT_MAX_SITES  1024 /* Must be a power of 2 */
+#define MEM_INSTRUMENT_BUCKETS    32   /* Bucket i holds sizes in (2^(i-1), 2^i] */
+
+typedef struct {
+	void* data; /* Identifies the arena, survives copies of the Arena struct */
+	isize capacity;
+	isize high_water;
+	isize alloc_count;
+	isize alloc_bytes;
+	isize padding_bytes;
+	isize resize_count;
+	isize resize_in_place;
+	isize failures;
+	isize overruns;
+	isize overrun_bytes;
+} MemArenaStats;
+
+typedef struct {
+	char const* file;
+	int line;
+	bool heap;
+	isize count;
+	isize bytes;
+	isize padding_bytes;
+	isize histogram[MEM_INSTRUMENT_BUCKETS];
+} MemSiteStats;
+
+static struct {
+	atomic_int lock;
+	bool report_registered;
+
+	MemArenaStats arenas[MEM_INSTRUMENT_MAX_ARENAS];
+	isize arena_count;
+
+	MemSiteStats sites[MEM_INSTRUMENT_MAX_SITES];
+	isize site_count;
+
+	isize dropped;
+} mem_instrument;
+
+static void mem_instrument_report();
+
+static thread_local MemInstrumentCaller mem_instrument_caller;
+
+MemInstrumentCaller mem_instrument_caller_begin(char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller;
+	if(prev.file == NULL){
+		mem_instrument_caller = (MemInstrumentCaller){ .file = file, .line = line };
+	}
+	return prev;
+}
+
+void mem_instrument_caller_end(MemInstrumentCaller prev){
+	mem_instrument_caller = prev;
+}
+
+/* The wrapper's own site unless an outer caller was recorded */
+static inline
+MemInstrumentCaller mem_instrument_site_of(char const* file, int line){
+	if(mem_instrument_caller.file != NULL){
+		return mem_instrument_caller;
+	}
+	return (MemInstrumentCaller){ .file = file, .line = line };
+}
+
+static inline
+void mem_instrument_lock(){
+	while(atomic_exchange_explicit(&mem_instrument.lock, 1, memory_order_acquire)){
+		while(atomic_load_explicit(&mem_instrument.lock, memory_order_relaxed)){}
+	}
+	if(!mem_instrument.report_registered){
+		mem_instrument.report_registered = true;
+		atexit(mem_instrument_report);
+	}
+}
+
+static inline
+void mem_instrument_unlock(){
+	atomic_store_explicit(&mem_instrument.lock, 0, memory_order_release);
+}
+
+static
+void arena_totals(Arena* a, isize* used, isize* capacity){
+	*used = 0;
+	*capacity = 0;
+	for(; a != NULL; a = a->next){
+		*used += a->offset;
+		*capacity += a->capacity;
+	}
+}
+
+static
+MemArenaStats* mem_instrument_arena(Arena* a){
+	for(isize i = 0; i < mem_instrument.arena_count; i += 1){
+		if(mem_instrument.arenas[i].data == a->data){
+			return &mem_instrument.arenas[i];
+		}
+	}
+	if(mem_instrument.arena_count >= MEM_INSTRUMENT_MAX_ARENAS){
+		mem_instrument.dropped += 1;
+		return NULL;
+	}
+	MemArenaStats* stats = &mem_instrument.arenas[mem_instrument.arena_count];
+	mem_instrument.arena_count += 1;
+	*stats = (MemArenaStats){ .data = a->data };
+	return stats;
+}
+
+static
+MemSiteStats* mem_instrument_site(char const* file, int line, bool heap){
+	usize mask = MEM_INSTRUMENT_MAX_SITES - 1;
+	usize h = (((uintptr)file >> 3) * 31 + (usize)line * 2 + heap) & mask;
+
+	for(usize probe = 0; probe < MEM_INSTRUMENT_MAX_SITES; probe += 1){
+		MemSiteStats* site = &mem_instrument.sites[(h + probe) & mask];
+		if(site->file == NULL){
+			if(mem_instrument.site_count >= (MEM_INSTRUMENT_MAX_SITES * 3) / 4){
+				break;
+			}
+			*site = (MemSiteStats){ .file = file, .line = line, .heap = heap };
+			mem_instrument.site_count += 1;
+			return site;
+		}
+		if(site->line == line && site->heap == heap && (site->file == file || strcmp(site->file, file) == 0)){
+			return site;
+		}
+	}
+	mem_instrument.dropped += 1;
+	return NULL;
+}
+
+static
+void mem_instrument_site_record(MemSiteStats* site, isize size, isize padding){
+	if(site == NULL){ return; }
+	int bucket = 0;
+	while(bucket < MEM_INSTRUMENT_BUCKETS - 1 && ((isize)1 << bucket) < size){
+		bucket += 1;
+	}
+	site->count += 1;
+	site->bytes += size;
+	site->padding_bytes += padding;
+	site->histogram[bucket] += 1;
+}
+
+static
+void mem_instrument_arena_record(MemArenaStats* stats, Arena* a){
+	if(stats == NULL){ return; }
+	isize used = 0, capacity = 0;
+	arena_totals(a, &used, &capacity);
+	stats->capacity = capacity;
+	stats->high_water = max(stats->high_water, used);
+}
+
+void* arena_alloc_site(Arena* a, isize size, isize align, char const* file, int line){
+	MemInstrumentCaller site = mem_instrument_site_of(file, line);
+	isize used_before = 0, capacity = 0;
+	arena_totals(a, &used_before, &capacity);
+
+	void* ptr = (arena_alloc)(a, size, align);
+
+	isize used_after = 0;
+	arena_totals(a, &used_after, &capacity);
+	isize padding = max(used_after - used_before - size, (isize)0);
+
+	mem_instrument_lock();
+	MemArenaStats* stats = mem_instrument_arena(a);
+	if(stats != NULL){
+		stats->alloc_count += 1;
+		stats->alloc_bytes += size;
+		stats->padding_bytes += padding;
+		stats->failures += ptr == NULL;
+	}
+	mem_instrument_arena_record(stats, a);
+	mem_instrument_site_record(mem_instrument_site(site.file, site.line, false), size, padding);
+	mem_instrument_unlock();
+
+	return ptr;
+}
+
+void* arena_realloc_site(Arena* a, void* ptr, isize old_size, isize new_size, isize align, char const* file, int line){
+	MemInstrumentCaller site = mem_instrument_site_of(file, line);
+	void* new_ptr = (arena_realloc)(a, ptr, old_size, new_size, align);
+
+	mem_instrument_lock();
+	MemArenaStats* stats = mem_instrument_arena(a);
+	if(stats != NULL){
+		stats->resize_count += 1;
+		stats->resize_in_place += (ptr != NULL && new_ptr == ptr);
+		stats->failures += new_ptr == NULL;
+	}
+	mem_instrument_arena_record(stats, a);
+	mem_instrument_site_record(mem_instrument_site(site.file, site.line, false), new_size, 0);
+	mem_instrument_unlock();
+
+	return new_ptr;
+}
+
+bool arena_resize_in_place_site(Arena* a, void* ptr, isize new_size, char const* file, int line){
+	MemInstrumentCaller site = mem_instrument_site_of(file, line);
+	bool in_place = (arena_resize_in_place)(a, ptr, new_size);
+
+	mem_instrument_lock();
+	MemArenaStats* stats = mem_instrument_arena(a);
+	if(stats != NULL){
+		stats->resize_count += 1;
+		stats->resize_in_place += in_place;
+	}
+	mem_instrument_arena_record(stats, a);
+	if(in_place){
+		mem_instrument_site_record(mem_instrument_site(site.file, site.line, false), new_size, 0);
+	}
+	mem_instrument_unlock();
+
+	return in_place;
+}
+
+void* heap_alloc_site(isize size, isize align, char const* file, int line){
+	MemInstrumentCaller site = mem_instrument_site_of(file, line);
+	void* ptr = (heap_alloc)(size, align);
+	isize padding = heap_usable_size(ptr) - size;
+
+	mem_instrument_lock();
+	mem_instrument_site_record(mem_instrument_site(site.file, site.line, true), size, padding);
+	mem_instrument_unlock();
+
+	return ptr;
+}
+
+//// Allocator interface
+void* mem_alloc_site(Allocator a, isize size, isize align, char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller_begin(file, line);
+	void* ptr = (mem_alloc)(a, size, align);
+	mem_instrument_caller_end(prev);
+	return ptr;
+}
+
+bool mem_resize_site(Allocator a, void* ptr, isize old_size, isize new_size, char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller_begin(file, line);
+	bool ok = (mem_resize)(a, ptr, old_size, new_size);
+	mem_instrument_caller_end(prev);
+	return ok;
+}
+
+void* mem_realloc_site(Allocator a, void* ptr, isize old_size, isize new_size, isize align, char const* file, int line){
+	MemInstrumentCaller prev = mem_instrument_caller_begin(file, line);
+	void* new_ptr = (mem_realloc)(a, ptr, old_size, new_size, align);
+	mem_instrument_caller_end(prev);
+	return new_ptr;
+}
+
+void mem_instrument_raw_write(Arena* a, isize requested){
+	mem_instrument_lock();
+	MemArenaStats* stats = mem_instrument_arena(a);
+	if(stats != NULL){
+		stats->alloc_count += 1;
+		stats->alloc_bytes += requested;
+		if(a->offset + 1 > a->capacity){
+			stats->overruns += 1;
+			stats->overrun_bytes = max(stats->overrun_bytes, requested);
+		}
+	}
+	mem_instrument_arena_record(stats, a);
+	mem_instrument_unlock();
+}
+
+static
+int mem_instrument_site_order(void const* left, void const* right){
+	MemSiteStats const* l = left;
+	MemSiteStats const* r = right;
+	return (l->bytes < r->bytes) - (l->bytes > r->bytes);
+}
+
+static
+void mem_instrument_report(){
+	FILE* out = stderr;
+	fprintf(out, "---- Memory report ----\n");
+
+	fprintf(out, "Arenas:\n");
+	for(isize i = 0; i < mem_instrument.arena_count; i += 1){
+		MemArenaStats* s = &mem_instrument.arenas[i];
+		fprintf(out, "  %p: high water %td / %td bytes (%.1f%%), %td allocs, %td bytes, %td padding\n",
+			s->data, s->high_water, s->capacity,
+			s->capacity > 0 ? (100.0 * s->high_water) / s->capacity : 0.0,
+			s->alloc_count, s->alloc_bytes, s->padding_bytes);
+		if(s->resize_count > 0){
+			fprintf(out, "    resizes: %td, in place: %td (%.1f%%)\n",
+				s->resize_count, s->resize_in_place, (100.0 * s->resize_in_place) / s->resize_count);
+		}
+		if(s->failures > 0 || s->overruns > 0){
+			fprintf(out, "    failures: %td, overruns: %td (largest %td bytes)\n",
+				s->failures, s->overruns, s->overrun_bytes);
+		}
+	}
+
+	MemSiteStats* sites = malloc(sizeof(MemSiteStats) * (mem_instrument.site_count + 1));
+	isize count = 0;
+	for(isize i = 0; i < MEM_INSTRUMENT_MAX_SITES && sites != NULL; i += 1){
+		if(mem_instrument.sites[i].file != NULL){
+			sites[count] = mem_instrument.sites[i];
+			count += 1;
+		}
+	}
+	if(sites != NULL){
+		qsort(sites, count, sizeof(MemSiteStats), mem_instrument_site_order);
+	}
+
+	fprintf(out, "Call sites (by bytes):\n");
+	for(isize i = 0; i < count; i += 1){
+		MemSiteStats* s = &sites[i];
+		fprintf(out, "  %s:%d [%s] %td allocs, %td bytes, %td padding\n    sizes:",
+			s->file, s->line, s->heap ? "heap" : "arena", s->count, s->bytes, s->padding_bytes);
+		for(int b = 0; b < MEM_INSTRUMENT_BUCKETS; b += 1){
+			if(s->histogram[b] > 0){
+				fprintf(out, " <=%lld:%td", 1ll << b, s->histogram[b]);
+			}
+		}
+		fprintf(out, "\n");
+	}
+	free(sites);
+
+	if(mem_instrument.dropped > 0){
+		fprintf(out, "(%td records dropped, tables full)\n", mem_instrument.dropped);
+	}
+}
+
+#undef MEM_INSTRUMENT_MAX_ARENAS
+#undef MEM_INSTRUMENT_MAX_SITES
+#undef MEM_INSTRUMENT_BUCKETS
+#endif
@@ -0,0 +1,200 @@
+#include "intern.h"
+#include "hash_map.h"
+
+#define INTERNER_PAGE_SIZE   (1 << INTERNER_PAGE_SHIFT)
+#define INTERNER_TABLE_MIN   64
+#define INTERNER_CHUNK_SIZE  (64 * mem_kilobyte)
+
+/* Open addressing table of (hash high bits << 32 | atom), 0 means empty.
+ * Replaced tables are kept on the `retired` list until destroy, since
+ * lock-free readers may still be probing them. */
+struct InternTable {
+	InternTable* retired;
+	isize cap;
+	_Atomic(u64) slots[];
+};
+
+static
+InternTable* intern_table_create(isize cap){
+	InternTable* t = heap_alloc(sizeof(InternTable) + sizeof(u64) * cap, alignof(InternTable));
+	t->retired = NULL;
+	t->cap = cap;
+	for(isize i = 0; i < cap; i += 1){
+		atomic_init(&t->slots[i], 0);
+	}
+	return t;
+}
+
+static inline
+void interner_lock(atomic_int* lock){
+	while(atomic_exchange_explicit(lock, 1, memory_order_acquire)){
+		while(atomic_load_explicit(lock, memory_order_relaxed)){}
+	}
+}
+
+static inline
+void interner_unlock(atomic_int* lock){
+	atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+static inline
+String interner_entry_string(Interner* in, InternEntry e){
+	return (String){ .v = in->bytes.data + e.offset, .len = e.len };
+}
+
+static inline
+InternEntry interner_entry(Interner* in, Atom atom){
+	InternEntry* page = atomic_load_explicit(&in->pages[atom >> INTERNER_PAGE_SHIFT], memory_order_acquire);
+	return page[atom & (INTERNER_PAGE_SIZE - 1)];
+}
+
+/* Probe t for s, returns the atom or 0 */
+static
+Atom interner_probe(Interner* in, InternTable* t, String s, u64 hash){
+	isize mask = t->cap - 1;
+	u32 tag = (u32)(hash >> 32);
+	for(isize i = (isize)(hash >> 6) & mask;; i = (i + 1) & mask){
+		u64 slot = atomic_load_explicit(&t->slots[i], memory_order_acquire);
+		if(slot == 0){
+			return 0;
+		}
+		if((u32)(slot >> 32) == tag){
+			Atom atom = (Atom)slot;
+			String other = interner_entry_string(in, interner_entry(in, atom));
+			if(other.len == s.len && mem_compare(other.v, s.v, s.len) == 0){
+				return atom;
+			}
+		}
+	}
+}
+
+static
+void intern_table_put(InternTable* t, u64 hash, u64 slot){
+	isize mask = t->cap - 1;
+	isize i = (isize)(hash >> 6) & mask;
+	while(atomic_load_explicit(&t->slots[i], memory_order_relaxed) != 0){
+		i = (i + 1) & mask;
+	}
+	atomic_store_explicit(&t->slots[i], slot, memory_order_release);
+}
+
+Interner* interner_create(isize byte_capacity){
+	ensure(byte_capacity > 0 && byte_capacity <= 4 * mem_gigabyte, "Invalid interner capacity");
+
+	Interner* in = heap_alloc(sizeof(Interner), alignof(Interner));
+	mem_set(in, 0, sizeof(Interner));
+
+	byte* bytes = mem_os_map(byte_capacity, mem_os_page_size());
+	ensure(bytes != NULL, "Failed to reserve interner memory");
+	in->bytes = shared_arena_create(bytes, byte_capacity, INTERNER_CHUNK_SIZE);
+
+	atomic_init(&in->next_atom, 1);
+	for(isize i = 0; i < INTERNER_STRIPES; i += 1){
+		atomic_init(&in->stripes[i].table, intern_table_create(INTERNER_TABLE_MIN));
+	}
+	return in;
+}
+
+void interner_destroy(Interner* in){
+	for(isize i = 0; i < INTERNER_STRIPES; i += 1){
+		InternTable* t = atomic_load(&in->stripes[i].table);
+		while(t != NULL){
+			InternTable* retired = t->retired;
+			heap_free(t);
+			t = retired;
+		}
+	}
+	for(isize i = 0; i < INTERNER_MAX_PAGES; i += 1){
+		heap_free(atomic_load(&in->pages[i]));
+	}
+	mem_os_unmap(in->bytes.data, in->bytes.capacity);
+	heap_free(in);
+}
+
+Atom interner_find(Interner* in, String s){
+	u64 hash = hash_string(s);
+	InternStripe* stripe = &in->stripes[hash & (INTERNER_STRIPES - 1)];
+	return interner_probe(in, atomic_load_explicit(&stripe->table, memory_order_acquire), s, hash);
+}
+
+Atom interner_intern_hashed(Interner* in, String s, u64 hash){
+	InternStripe* stripe = &in->stripes[hash & (INTERNER_STRIPES - 1)];
+
+	/* Fast path, no lock */
+	Atom atom = interner_probe(in, atomic_load_explicit(&stripe->table, memory_order_acquire), s, hash);
+	if(atom != 0){
+		return atom;
+	}
+
+	interner_lock(&stripe->lock);
+	InternTable* t = atomic_load_explicit(&stripe->table, memory_order_relaxed);
+
+	/* Someone may have inserted it while we waited */
+	atom = interner_probe(in, t, s, hash);
+	if(atom != 0){
+		interner_unlock(&stripe->lock);
+		return atom;
+	}
+
+	byte* data = shared_arena_alloc(&in->bytes, s.len + 1, 1);
+	ensure(data != NULL, "Interner out of memory");
+	mem_copy_no_overlap(data, s.v, s.len);
+
+	atom = atomic_fetch_add_explicit(&in->next_atom, 1, memory_order_relaxed);
+	ensure(atom != 0, "Interner ran out of atoms");
+
+	_Atomic(InternEntry*)* page_slot = &in->pages[atom >> INTERNER_PAGE_SHIFT];
+	InternEntry* page = atomic_load_explicit(page_slot, memory_order_acquire);
+	if(page == NULL){
+		InternEntry* fresh = heap_alloc(sizeof(InternEntry) * INTERNER_PAGE_SIZE, alignof(InternEntry));
+		if(atomic_compare_exchange_strong(page_slot, &page, fresh)){
+			page = fresh;
+		} else {
+			heap_free(fresh); /* Another stripe got there first */
+		}
+	}
+	page[atom & (INTERNER_PAGE_SIZE - 1)] = (InternEntry){
+		.offset = (u32)(data - in->bytes.data),
+		.len = (u32)s.len,
+	};
+
+	/* Keep the load factor under 1/2, old tables stay alive for readers */
+	if((stripe->len + 1) * 2 > t->cap){
+		InternTable* grown = intern_table_create(t->cap * 2);
+		for(isize i = 0; i < t->cap; i += 1){
+			u64 slot = atomic_load_explicit(&t->slots[i], memory_order_relaxed);
+			if(slot == 0){ continue; }
+			String other = interner_entry_string(in, interner_entry(in, (Atom)slot));
+			intern_table_put(grown, hash_string(other), slot);
+		}
+		grown->retired = t;
+		atomic_store_explicit(&stripe->table, grown, memory_order_release);
+		t = grown;
+	}
+
+	intern_table_put(t, hash, ((hash >> 32) << 32) | atom);
+	stripe->len += 1;
+
+	interner_unlock(&stripe->lock);
+	return atom;
+}
+
+Atom interner_intern(Interner* in, String s){
+	return interner_intern_hashed(in, s, hash_string(s));
+}
+
+String interner_string(Interner* in, Atom atom){
+	if(atom == 0){
+		return (String){0};
+	}
+	ensure(atom < atomic_load_explicit(&in->next_atom, memory_order_relaxed), "Invalid atom");
+	return interner_entry_string(in, interner_entry(in, atom));
+}
+
+isize interner_count(Interner* in){
+	return atomic_load_explicit(&in->next_atom, memory_order_relaxed) - 1;
+}
+
+#undef INTERNER_PAGE_SIZE
+#undef INTERNER_TABLE_MIN
+#undef INTERNER_CHUNK_SIZE
@@ -0,0 +1,55 @@
+#pragma once
+#include "types.h"
+#include "memory.h"
+
+//// String interner
+/* Maps strings to dense u32 atoms, safe to use from many threads at once.
+ *
+ * String bytes go into a SharedArena over a reserved mapping, so they never
+ * move and an atom's String stays valid until the interner is destroyed.
+ * Lookups are lock-free. Inserts take one of INTERNER_STRIPES spinlocks
+ * picked by hash, so threads interning different strings rarely contend.
+ * Atom 0 is never handed out and maps to the empty string. */
+typedef u32 Atom;
+
+#define INTERNER_STRIPES    64
+#define INTERNER_PAGE_SHIFT 16
+#define INTERNER_MAX_PAGES  (1 << (32 - INTERNER_PAGE_SHIFT))
+
+typedef struct InternTable InternTable;
+
+/* Where an atom's bytes live, relative to the start of the byte arena */
+typedef struct {
+	u32 offset;
+	u32 len;
+} InternEntry;
+
+typedef struct {
+	atomic_int lock;
+	_Atomic(InternTable*) table;
+	isize len;
+} InternStripe;
+
+typedef struct {
+	SharedArena bytes;
+	_Atomic(u32) next_atom;
+	_Atomic(InternEntry*) pages[INTERNER_MAX_PAGES];
+	InternStripe stripes[INTERNER_STRIPES];
+} Interner;
+
+/* Reserves `byte_capacity` bytes of address space for string data, at most 4 GiB */
+Interner* interner_create(isize byte_capacity);
+
+void interner_destroy(Interner* in);
+
+Atom interner_intern(Interner* in, String s);
+
+/* `hash` must be hash_string(s) */
+Atom interner_intern_hashed(Interner* in, String s, u64 hash);
+
+/* Returns 0 if s was never interned */
+Atom interner_find(Interner* in, String s);
+
+String interner_string(Interner* in, Atom atom);
+
+isize interner_count(Interner* in);
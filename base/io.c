@@ -0,0 +1,143 @@
+#include "io.h"
+#include "string.h"
+#include "stb_sprintf.h"
+
+#if defined(OS_LINUX)
+#include <sys/uio.h>
+#include <unistd.h>
+#elif defined(OS_WINDOWS)
+#include <io.h>
+#endif
+
+bool io_write_all(int fd, void const* data, isize len){
+	byte const* p = data;
+	while(len > 0){
+#if defined(OS_WINDOWS)
+		int n = _write(fd, p, (unsigned)min(len, (isize)INT32_MAX));
+#else
+		isize n = write(fd, p, len);
+#endif
+		if(n <= 0){ return false; }
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool io_write_pair(int fd, void const* a, isize a_len, void const* b, isize b_len){
+#if defined(OS_LINUX)
+	struct iovec iov[2] = {
+		{ .iov_base = (void*)a, .iov_len = a_len },
+		{ .iov_base = (void*)b, .iov_len = b_len },
+	};
+	isize written = writev(fd, iov, 2);
+	if(written < 0){
+		return false;
+	}
+	if(written < a_len){
+		return io_write_all(fd, (byte const*)a + written, a_len - written) && io_write_all(fd, b, b_len);
+	}
+	written -= a_len;
+	return io_write_all(fd, (byte const*)b + written, b_len - written);
+#else
+	return io_write_all(fd, a, a_len) && io_write_all(fd, b, b_len);
+#endif
+}
+
+Writer writer_create(int fd, byte* buf, isize cap){
+	ensure(cap >= WRITER_NUMBER_MAX, "Writer buffer too small");
+	return (Writer){
+		.fd = fd,
+		.buf = buf,
+		.cap = cap,
+	};
+}
+
+bool writer_flush(Writer* w){
+	if(!w->failed && w->len > 0){
+		w->failed = !io_write_all(w->fd, w->buf, w->len);
+	}
+	w->len = 0;
+	return !w->failed;
+}
+
+void writer_append(Writer* w, String s){
+	if(s.len <= w->cap - w->len){
+		mem_copy_no_overlap(w->buf + w->len, s.v, s.len);
+		w->len += s.len;
+		return;
+	}
+
+	if(s.len < w->cap / 2){
+		writer_flush(w);
+		mem_copy_no_overlap(w->buf, s.v, s.len);
+		w->len = s.len;
+		return;
+	}
+
+	/* Big piece, send it along with what's buffered without copying */
+	if(!w->failed){
+		w->failed = !io_write_pair(w->fd, w->buf, w->len, s.v, s.len);
+	}
+	w->len = 0;
+}
+
+void writer_append_byte(Writer* w, byte b){
+	if(w->len == w->cap){
+		writer_flush(w);
+	}
+	w->buf[w->len] = b;
+	w->len += 1;
+}
+
+/* Room for one typed append, so numbers are formatted in place */
+static inline
+byte* writer_reserve_number(Writer* w){
+	if(w->cap - w->len < WRITER_NUMBER_MAX){
+		writer_flush(w);
+	}
+	return w->buf + w->len;
+}
+
+void writer_append_i64(Writer* w, i64 v){
+	w->len += fmt_i64(writer_reserve_number(w), v);
+}
+
+void writer_append_u64(Writer* w, u64 v){
+	w->len += fmt_u64(writer_reserve_number(w), v);
+}
+
+void writer_append_f64(Writer* w, f64 v){
+	w->len += fmt_f64(writer_reserve_number(w), v);
+}
+
+typedef struct {
+	Writer* w;
+	char scratch[STB_SPRINTF_MIN];
+} WriterFormatContext;
+
+static
+char* writer_format_callback(char const* buf, void* user, int len){
+	WriterFormatContext* ctx = user;
+	Writer* w = ctx->w;
+
+	if(buf == (char*)w->buf + w->len){
+		w->len += len;
+	} else if(len > 0){
+		writer_append(w, (String){ .v = (byte const*)buf, .len = len });
+	}
+
+	if(w->cap - w->len < STB_SPRINTF_MIN){
+		writer_flush(w);
+	}
+	return w->cap - w->len >= STB_SPRINTF_MIN ? (char*)w->buf + w->len : ctx->scratch;
+}
+
+void writer_format(Writer* w, char const * restrict fmt, ...){
+	WriterFormatContext ctx = { .w = w };
+	va_list argp;
+	va_start(argp, fmt);
+	stbsp_vsprintfcb(writer_format_callback, &ctx, writer_format_callback(ctx.scratch, &ctx, 0), fmt, argp);
+	va_end(argp);
+}
+
@@ -0,0 +1,43 @@
+#pragma once
+#include "types.h"
+#include "memory.h"
+#include "string.h"
+
+//// Raw output
+/* Keeps writing until everything went out or an error happened */
+bool io_write_all(int fd, void const* data, isize len);
+
+/* Write two buffers with a single syscall where the OS allows it */
+bool io_write_pair(int fd, void const* a, isize a_len, void const* b, isize b_len);
+
+//// Buffered writer
+/* Collects output in a caller provided buffer and hands it to the OS only when
+ * full. Appends larger than the free space go out together with the buffered
+ * bytes in one writev instead of being copied. Errors are sticky: once a write
+ * fails, `failed` stays set and further output is dropped. */
+typedef struct {
+	int fd;
+	byte* buf;
+	isize len;
+	isize cap;
+	bool failed;
+} Writer;
+
+/* Room kept free for one typed append, at least FMT_F64_MAX */
+#define WRITER_NUMBER_MAX 64
+
+Writer writer_create(int fd, byte* buf, isize cap);
+
+void writer_append(Writer* w, String s);
+
+void writer_append_byte(Writer* w, byte b);
+
+void writer_append_i64(Writer* w, i64 v);
+
+void writer_append_u64(Writer* w, u64 v);
+
+void writer_append_f64(Writer* w, f64 v);
+
+void writer_format(Writer* w, char const * restrict fmt, ...) str_attribute_format(2, 3);
+
+bool writer_flush(Writer* w);
@@ -35,3 +35,214 @@ int mem_compare(void const* left, void const* right, isize count){
 }
 #endif
 
+
+void* (mem_alloc)(Allocator a, isize size, isize align){
+	ensure(mem_valid_alignment(align), "Alignment must be a power of 2 greater than 0");
+	return a.func(a.impl, AllocatorMode_Alloc, NULL, 0, size, align);
+}
+
+bool (mem_resize)(Allocator a, void* ptr, isize old_size, isize new_size){
+	if(ptr == NULL){ return false; }
+	return a.func(a.impl, AllocatorMode_Resize, ptr, old_size, new_size, 1) != NULL;
+}
+
+void* (mem_realloc)(Allocator a, void* ptr, isize old_size, isize new_size, isize align){
+	if(ptr == NULL){
+		return (mem_alloc)(a, new_size, align);
+	}
+	if(((uintptr)ptr & (uintptr)(align - 1)) == 0 && (mem_resize)(a, ptr, old_size, new_size)){
+		return ptr;
+	}
+
+	void* new_ptr = (mem_alloc)(a, new_size, align);
+	if(new_ptr == NULL){
+		return NULL;
+	}
+	mem_copy_no_overlap(new_ptr, ptr, min(old_size, new_size));
+	mem_free(a, ptr, old_size);
+	return new_ptr;
+}
+
+void mem_free(Allocator a, void* ptr, isize size){
+	if(ptr == NULL){ return; }
+	a.func(a.impl, AllocatorMode_Free, ptr, size, 0, 1);
+}
+
+void mem_free_all(Allocator a){
+	a.func(a.impl, AllocatorMode_FreeAll, NULL, 0, 0, 1);
+}
+
+#if defined(OS_LINUX)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+isize mem_os_page_size(){
+	static isize page_size = 0;
+	if(page_size == 0){
+		page_size = sysconf(_SC_PAGESIZE);
+	}
+	return page_size;
+}
+
+void* mem_os_map(isize size, isize align){
+	isize page = mem_os_page_size();
+	align = max(align, page);
+	size  = mem_align_forward_size(size, page);
+
+	/* Over-map and trim both ends to get the requested alignment */
+	isize total = size + align - page;
+	byte* p = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED){
+		return NULL;
+	}
+
+	byte* aligned = (byte*)mem_align_forward_ptr((uintptr)p, align);
+	isize head = aligned - p;
+	isize tail = total - head - size;
+	if(head > 0){ munmap(p, head); }
+	if(tail > 0){ munmap(aligned + size, tail); }
+
+	return aligned;
+}
+
+void mem_os_unmap(void* ptr, isize size){
+	munmap(ptr, mem_align_forward_size(size, mem_os_page_size()));
+}
+
+/* Transparent huge pages can be turned off system wide, in which case
+ * madvise still succeeds but does nothing. */
+static
+bool mem_os_thp_enabled(){
+	int fd = open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	char buf[128] = {0};
+	isize n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(n <= 0){
+		return false;
+	}
+	String mode = { .v = (byte const*)buf, .len = n };
+	for(isize i = 0; i + 7 <= mode.len; i += 1){
+		if(mem_compare(mode.v + i, "[never]", 7) == 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+void* mem_os_map_pages(isize size, MemPagePolicy policy, MemPagePolicy* applied){
+	MemPagePolicy ignored;
+	if(applied == NULL){
+		applied = &ignored;
+	}
+	*applied = MemPages_Default;
+
+	if(policy == MemPages_Huge){
+		isize huge_size = mem_align_forward_size(size, mem_huge_page_size);
+		void* p = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+		if(p != MAP_FAILED){
+			*applied = MemPages_Huge;
+			return p;
+		}
+		policy = MemPages_Transparent; /* No reserved huge pages, try THP */
+	}
+
+	if(policy == MemPages_Transparent){
+		isize huge_size = mem_align_forward_size(size, mem_huge_page_size);
+		byte* p = mem_os_map(huge_size, mem_huge_page_size);
+		if(p == NULL){
+			return NULL;
+		}
+		if(madvise(p, huge_size, MADV_HUGEPAGE) == 0 && mem_os_thp_enabled()){
+			*applied = MemPages_Transparent;
+		}
+		return p;
+	}
+
+	return mem_os_map(size, mem_os_page_size());
+}
+
+bool mem_os_extend(void* ptr, isize old_size, isize new_size){
+	isize page = mem_os_page_size();
+	old_size = mem_align_forward_size(old_size, page);
+	new_size = mem_align_forward_size(new_size, page);
+	if(new_size <= old_size){
+		return true;
+	}
+	void* res = mremap(ptr, old_size, new_size, 0);
+	return res != MAP_FAILED;
+}
+#elif defined(OS_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+isize mem_os_page_size(){
+	static isize page_size = 0;
+	if(page_size == 0){
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		page_size = info.dwPageSize;
+	}
+	return page_size;
+}
+
+void* mem_os_map(isize size, isize align){
+	isize page = mem_os_page_size();
+	align = max(align, page);
+	size  = mem_align_forward_size(size, page);
+
+	/* Reservations can't be trimmed, so find an aligned spot by reserving a
+	 * bigger range, releasing it and retrying at the aligned address. */
+	for(int attempt = 0; attempt < 16; attempt += 1){
+		byte* p = VirtualAlloc(NULL, size + align, MEM_RESERVE, PAGE_NOACCESS);
+		if(p == NULL){
+			return NULL;
+		}
+		byte* aligned = (byte*)mem_align_forward_ptr((uintptr)p, align);
+		VirtualFree(p, 0, MEM_RELEASE);
+
+		p = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if(p != NULL){
+			return p;
+		}
+	}
+	return NULL;
+}
+
+void mem_os_unmap(void* ptr, isize size){
+	(void)size;
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+/* Large pages need SeLockMemoryPrivilege, there is no transparent variant */
+void* mem_os_map_pages(isize size, MemPagePolicy policy, MemPagePolicy* applied){
+	MemPagePolicy ignored;
+	if(applied == NULL){
+		applied = &ignored;
+	}
+	*applied = MemPages_Default;
+
+	if(policy != MemPages_Default){
+		isize large_page = GetLargePageMinimum();
+		if(large_page > 0){
+			void* p = VirtualAlloc(NULL, mem_align_forward_size(size, large_page),
+				MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if(p != NULL){
+				*applied = MemPages_Huge;
+				return p;
+			}
+		}
+	}
+
+	return mem_os_map(size, mem_os_page_size());
+}
+
+bool mem_os_extend(void* ptr, isize old_size, isize new_size){
+	(void)ptr;
+	return new_size <= mem_align_forward_size(old_size, mem_os_page_size());
+}
+#endif
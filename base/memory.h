@@ -41,6 +41,59 @@ isize mem_align_forward_size(isize p, isize a){
 	return p;
 }
 
+//// OS virtual memory
+/* Sizes are rounded up to the page size. Returns NULL on failure */
+void* mem_os_map(isize size, isize align);
+
+void mem_os_unmap(void* ptr, isize size);
+
+/* Try to grow a mapping without moving it */
+bool mem_os_extend(void* ptr, isize old_size, isize new_size);
+
+isize mem_os_page_size();
+
+#define mem_huge_page_size (2ll * mem_megabyte)
+
+typedef enum {
+	MemPages_Default,
+	MemPages_Transparent, /* 2 MiB aligned mapping with transparent huge pages requested */
+	MemPages_Huge,        /* Explicit huge pages, falls back to MemPages_Transparent */
+} MemPagePolicy;
+
+/* Map with a page size policy, `applied` receives the policy that actually
+ * took effect (MemPages_Default if huge pages could not be used). It may be
+ * NULL when the caller doesn't care. */
+void* mem_os_map_pages(isize size, MemPagePolicy policy, MemPagePolicy* applied);
+
+//// Allocator interface
+typedef enum {
+	AllocatorMode_Alloc,   /* Returns memory aligned to `align`, or NULL */
+	AllocatorMode_Resize,  /* Returns ptr if it could grow/shrink in place, NULL otherwise */
+	AllocatorMode_Free,
+	AllocatorMode_FreeAll,
+} AllocatorMode;
+
+typedef void* (*AllocatorFunc)(void* impl, AllocatorMode mode, void* ptr, isize old_size, isize size, isize align);
+
+typedef struct {
+	AllocatorFunc func;
+	void* impl;
+} Allocator;
+
+#define mem_make(A, Type, Count) \
+	((Type *)mem_alloc((A), sizeof(Type) * (Count), alignof(Type)))
+
+void* mem_alloc(Allocator a, isize size, isize align);
+
+bool mem_resize(Allocator a, void* ptr, isize old_size, isize new_size);
+
+/* Resize in place if possible, otherwise allocate, copy and free */
+void* mem_realloc(Allocator a, void* ptr, isize old_size, isize new_size, isize align);
+
+void mem_free(Allocator a, void* ptr, isize size);
+
+void mem_free_all(Allocator a);
+
 //// Arena allocator
 typedef struct Arena Arena;
 
@@ -55,9 +108,15 @@ struct Arena {
 	bool dynamic;
 };
 
+/* Only the newest overflow chunk takes allocations, so the base arena and that
+ * chunk are all a region has to remember. Chunks added later get freed. */
 typedef struct {
 	Arena* arena;
 	isize offset;
+	void* last_allocation;
+	Arena* chunk;
+	isize chunk_offset;
+	void* chunk_last_allocation;
 } ArenaRegion;
 
 #define arena_make(A, Type, Count) \
@@ -67,6 +126,12 @@ Arena arena_create_buffer(byte* buf, isize buf_size);
 
 Arena arena_create_dynamic(byte* buf, isize buf_size);
 
+/* Arena over its own OS mapping, see mem_os_map_pages for the policy */
+Arena arena_create_mapped(isize capacity, MemPagePolicy policy, MemPagePolicy* applied);
+
+/* Unmaps a mapped arena and frees any overflow chunks */
+void arena_destroy_mapped(Arena* a);
+
 void* arena_alloc(Arena* arena, isize size, isize align);
 
 bool arena_resize_in_place(Arena* arena, void* ptr, isize size);
@@ -77,10 +142,144 @@ ArenaRegion arena_region_begin(Arena* a);
 
 void arena_region_end(ArenaRegion reg);
 
+/* Close a region but keep everything allocated inside it */
+void arena_region_keep(ArenaRegion reg);
+
 void* arena_realloc(Arena* a, void* ptr, isize old_size, isize new_size, isize align);
 
+Allocator arena_allocator(Arena* a);
+
+//// Shared arena
+/* Bump allocator many threads can allocate from at once. Space is claimed
+ * with an atomic add on `offset`, in chunks of `chunk_size` which each thread
+ * then bumps through privately. Only requests larger than a quarter chunk go
+ * straight to the shared offset. */
+typedef struct {
+	byte* data;
+	isize capacity;
+	isize chunk_size;
+	_Atomic(isize) offset;
+	_Atomic(u64) generation; /* Unique per create and reset, invalidates thread chunks */
+} SharedArena;
+
+SharedArena shared_arena_create(byte* buf, isize buf_size, isize chunk_size);
+
+/* Memory is zeroed, returns NULL when the arena is full */
+void* shared_arena_alloc(SharedArena* a, isize size, isize align);
+
+/* Not thread safe, no other thread may be allocating */
+void shared_arena_reset(SharedArena* a);
+
+Allocator shared_arena_allocator(SharedArena* a);
+
 //// Heap allocator
+/* Returned memory is not zeroed */
 void* heap_alloc(isize size, isize align);
 
+void* heap_realloc(void* ptr, isize new_size, isize align);
+
+/* Number of bytes actually usable at ptr, always >= the requested size */
+isize heap_usable_size(void* ptr);
+
+bool heap_resize_in_place(void* ptr, isize new_size);
+
 void heap_free(void* ptr);
 
+/* Hand the calling thread's cached blocks back to the shared free lists.
+ * Threads started with thread_create do this when they exit. */
+void heap_thread_flush();
+
+Allocator heap_allocator();
+
+//// Pool allocator
+typedef struct PoolBlock PoolBlock;
+
+struct PoolBlock {
+	PoolBlock* next;
+};
+
+/* Fixed size blocks carved from a buffer */
+typedef struct {
+	byte* data;
+	isize capacity;
+	isize offset;
+	isize block_size;
+	isize block_align;
+	PoolBlock* free_list;
+} Pool;
+
+Pool pool_create(byte* buf, isize buf_size, isize block_size, isize block_align);
+
+void* pool_alloc(Pool* p);
+
+void pool_free(Pool* p, void* ptr);
+
+void pool_reset(Pool* p);
+
+Allocator pool_allocator(Pool* p);
+
+
+//// Instrumentation
+/* Building with -DMEM_INSTRUMENT routes arena_alloc, arena_realloc,
+ * arena_resize_in_place and heap_alloc through wrappers that record per-arena
+ * high-water marks, padding and in-place resize rates, plus per call site size
+ * histograms. A report is printed at exit. The allocator sources define and
+ * call the real functions with parenthesized names so these macros don't
+ * expand there.
+ *
+ * mem_alloc, mem_resize and mem_realloc are wrapped too. They remember their
+ * caller while the allocator runs, so memory requested through an Allocator
+ * (dynamic arrays, maps, builders) is charged to that call site instead of to
+ * the allocator's own source. */
+#if defined(MEM_INSTRUMENT)
+void* arena_alloc_site(Arena* a, isize size, isize align, char const* file, int line);
+
+void* arena_realloc_site(Arena* a, void* ptr, isize old_size, isize new_size, isize align, char const* file, int line);
+
+bool arena_resize_in_place_site(Arena* a, void* ptr, isize new_size, char const* file, int line);
+
+void* heap_alloc_site(isize size, isize align, char const* file, int line);
+
+void* mem_alloc_site(Allocator a, isize size, isize align, char const* file, int line);
+
+bool mem_resize_site(Allocator a, void* ptr, isize old_size, isize new_size, char const* file, int line);
+
+void* mem_realloc_site(Allocator a, void* ptr, isize old_size, isize new_size, isize align, char const* file, int line);
+
+typedef struct {
+	char const* file;
+	int line;
+} MemInstrumentCaller;
+
+/* Charge the calling thread's allocations to file:line until the matching
+ * end, for wrappers around helpers that allocate. Nested calls keep the
+ * outermost caller. */
+MemInstrumentCaller mem_instrument_caller_begin(char const* file, int line);
+
+void mem_instrument_caller_end(MemInstrumentCaller prev);
+
+/* For code that writes straight into an arena's free space and then bumps its
+ * offset. Updates the high-water mark and flags writes that didn't fit. */
+void mem_instrument_raw_write(Arena* a, isize requested);
+
+#define arena_alloc(A, Size, Align) \
+	arena_alloc_site((A), (Size), (Align), __FILE__, __LINE__)
+
+#define arena_realloc(A, Ptr, OldSize, NewSize, Align) \
+	arena_realloc_site((A), (Ptr), (OldSize), (NewSize), (Align), __FILE__, __LINE__)
+
+#define arena_resize_in_place(A, Ptr, NewSize) \
+	arena_resize_in_place_site((A), (Ptr), (NewSize), __FILE__, __LINE__)
+
+#define heap_alloc(Size, Align) \
+	heap_alloc_site((Size), (Align), __FILE__, __LINE__)
+
+#define mem_alloc(A, Size, Align) \
+	mem_alloc_site((A), (Size), (Align), __FILE__, __LINE__)
+
+#define mem_resize(A, Ptr, OldSize, NewSize) \
+	mem_resize_site((A), (Ptr), (OldSize), (NewSize), __FILE__, __LINE__)
+
+#define mem_realloc(A, Ptr, OldSize, NewSize, Align) \
+	mem_realloc_site((A), (Ptr), (OldSize), (NewSize), (Align), __FILE__, __LINE__)
+#endif
@@ -0,0 +1,77 @@
+#include "memory.h"
+
+Pool pool_create(byte* buf, isize buf_size, isize block_size, isize block_align){
+	ensure(mem_valid_alignment(block_align), "Invalid alignment");
+	block_align = max(block_align, (isize)alignof(PoolBlock));
+	block_size  = mem_align_forward_size(max(block_size, (isize)sizeof(PoolBlock)), block_align);
+
+	isize start = (isize)(mem_align_forward_ptr((uintptr)buf, block_align) - (uintptr)buf);
+	return (Pool){
+		.data = buf,
+		.capacity = buf_size,
+		.offset = start,
+		.block_size = block_size,
+		.block_align = block_align,
+		.free_list = NULL,
+	};
+}
+
+void* pool_alloc(Pool* p){
+	void* block = p->free_list;
+	if(block != NULL){
+		p->free_list = p->free_list->next;
+	}
+	else {
+		if(p->offset + p->block_size > p->capacity){
+			return NULL; /* Out of memory */
+		}
+		block = p->data + p->offset;
+		p->offset += p->block_size;
+	}
+
+	mem_set(block, 0, p->block_size);
+	return block;
+}
+
+void pool_free(Pool* p, void* ptr){
+	if(ptr == NULL){ return; }
+	ensure((byte*)ptr >= p->data && (byte*)ptr < p->data + p->capacity, "Pointer is not owned by pool");
+
+	PoolBlock* block = ptr;
+	block->next = p->free_list;
+	p->free_list = block;
+}
+
+void pool_reset(Pool* p){
+	*p = pool_create(p->data, p->capacity, p->block_size, p->block_align);
+}
+
+static
+void* pool_allocator_func(void* impl, AllocatorMode mode, void* ptr, isize old_size, isize size, isize align){
+	Pool* p = impl;
+	(void)old_size;
+
+	switch(mode){
+	case AllocatorMode_Alloc:
+		if(size > p->block_size || align > p->block_align){
+			return NULL;
+		}
+		return pool_alloc(p);
+	case AllocatorMode_Resize:
+		return size <= p->block_size ? ptr : NULL;
+	case AllocatorMode_Free:
+		pool_free(p, ptr);
+		break;
+	case AllocatorMode_FreeAll:
+		pool_reset(p);
+		break;
+	}
+	return NULL;
+}
+
+Allocator pool_allocator(Pool* p){
+	return (Allocator){
+		.func = pool_allocator_func,
+		.impl = p,
+	};
+}
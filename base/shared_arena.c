@@ -0,0 +1,128 @@
+#include "memory.h"
+
+#define SHARED_ARENA_CACHE_SLOTS 4
+#define SHARED_ARENA_CHUNK_ALIGN 64 /* Keep chunks of different threads off the same cache line */
+
+typedef struct {
+	SharedArena* arena;
+	u64 generation;
+	byte* current;
+	byte* end;
+} SharedArenaChunk;
+
+static thread_local SharedArenaChunk shared_arena_chunks[SHARED_ARENA_CACHE_SLOTS];
+
+/* Thread caches are keyed by address, so an arena created again at the same
+ * address must not look like the old one. Every create and reset takes a
+ * fresh generation from here. */
+static _Atomic(u64) shared_arena_generations = 1;
+
+static inline
+u64 shared_arena_next_generation(){
+	return atomic_fetch_add_explicit(&shared_arena_generations, 1, memory_order_relaxed);
+}
+
+SharedArena shared_arena_create(byte* buf, isize buf_size, isize chunk_size){
+	ensure(chunk_size >= SHARED_ARENA_CHUNK_ALIGN, "Chunk size too small");
+	SharedArena a = {
+		.data = buf,
+		.capacity = buf_size,
+		.chunk_size = mem_align_forward_size(chunk_size, SHARED_ARENA_CHUNK_ALIGN),
+	};
+	atomic_init(&a.offset, 0);
+	atomic_init(&a.generation, shared_arena_next_generation());
+	return a;
+}
+
+/* Claim `size` bytes from the shared offset, aligned to `align` relative to data */
+static
+byte* shared_arena_claim(SharedArena* a, isize size, isize align){
+	isize reserve = size + align - 1;
+	isize start = atomic_fetch_add_explicit(&a->offset, reserve, memory_order_relaxed);
+	if(start + reserve > a->capacity){
+		return NULL; /* Out of memory, offset stays past capacity until reset */
+	}
+	return (byte*)mem_align_forward_ptr((uintptr)(a->data + start), align);
+}
+
+void* shared_arena_alloc(SharedArena* a, isize size, isize align){
+	ensure(mem_valid_alignment(align), "Invalid alignment");
+
+	/* Chunks are only SHARED_ARENA_CHUNK_ALIGN aligned, so larger alignments
+	 * could land past the end of one. Those, and big sizes, get their own claim. */
+	if(size > a->chunk_size / 4 || align > SHARED_ARENA_CHUNK_ALIGN){
+		byte* ptr = shared_arena_claim(a, size, align);
+		if(ptr != NULL){
+			mem_set(ptr, 0, size);
+		}
+		return ptr;
+	}
+
+	u64 generation = atomic_load_explicit(&a->generation, memory_order_relaxed);
+
+	SharedArenaChunk* chunk = NULL;
+	for(isize i = 0; i < SHARED_ARENA_CACHE_SLOTS; i += 1){
+		if(shared_arena_chunks[i].arena == a){
+			chunk = &shared_arena_chunks[i];
+			break;
+		}
+	}
+	if(chunk == NULL){
+		/* Evict the last slot, move everything else down */
+		mem_copy(&shared_arena_chunks[1], &shared_arena_chunks[0], sizeof(SharedArenaChunk) * (SHARED_ARENA_CACHE_SLOTS - 1));
+		chunk = &shared_arena_chunks[0];
+		*chunk = (SharedArenaChunk){ .arena = a, .generation = generation };
+	}
+	if(chunk->generation != generation){
+		*chunk = (SharedArenaChunk){ .arena = a, .generation = generation };
+	}
+
+	uintptr aligned = mem_align_forward_ptr((uintptr)chunk->current, align);
+	if(chunk->current == NULL || aligned + size > (uintptr)chunk->end){
+		byte* fresh = shared_arena_claim(a, a->chunk_size, SHARED_ARENA_CHUNK_ALIGN);
+		if(fresh == NULL){
+			return NULL;
+		}
+		chunk->current = fresh;
+		chunk->end = fresh + a->chunk_size;
+		aligned = mem_align_forward_ptr((uintptr)chunk->current, align);
+	}
+
+	chunk->current = (byte*)(aligned + size);
+	void* ptr = (void*)aligned;
+	mem_set(ptr, 0, size);
+	return ptr;
+}
+
+void shared_arena_reset(SharedArena* a){
+	atomic_store_explicit(&a->offset, 0, memory_order_relaxed);
+	atomic_store_explicit(&a->generation, shared_arena_next_generation(), memory_order_release);
+}
+
+static
+void* shared_arena_allocator_func(void* impl, AllocatorMode mode, void* ptr, isize old_size, isize size, isize align){
+	SharedArena* a = impl;
+
+	switch(mode){
+	case AllocatorMode_Alloc:
+		return shared_arena_alloc(a, size, align);
+	case AllocatorMode_Resize:
+		return size <= old_size ? ptr : NULL;
+	case AllocatorMode_Free:
+		break; /* Individual frees are a no-op */
+	case AllocatorMode_FreeAll:
+		shared_arena_reset(a);
+		break;
+	}
+	return NULL;
+}
+
+Allocator shared_arena_allocator(SharedArena* a){
+	return (Allocator){
+		.func = shared_arena_allocator_func,
+		.impl = a,
+	};
+}
+
+#undef SHARED_ARENA_CACHE_SLOTS
+#undef SHARED_ARENA_CHUNK_ALIGN
@@ -1,6 +1,13 @@
 #include "string.h"
 #include <stdlib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define STR_SSE2 1
+#endif
+
+#define STR_BLOCK 16
+
 bool rune_is_digit(rune r, int base){
 	switch(base){
 	case 2:  return r >= '0' && r <= '1';
@@ -11,16 +18,33 @@ bool rune_is_digit(rune r, int base){
 	return false;
 }
 
-isize str_compare(String left, String right){
-	if(left.len > right.len){
-		return left.len;
+/* Index of the first byte where left and right differ, count if none */
+static inline
+isize str_mismatch(byte const* left, byte const* right, isize count){
+	isize i = 0;
+#if defined(STR_SSE2)
+	for(; i + STR_BLOCK <= count; i += STR_BLOCK){
+		__m128i l = _mm_loadu_si128((__m128i const*)(left + i));
+		__m128i r = _mm_loadu_si128((__m128i const*)(right + i));
+		u32 same = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(l, r));
+		if(same != 0xffff){
+			return i + bit_ctz32(~same);
+		}
 	}
-	if(left.len < right.len){
-		return -right.len;
+#endif
+	for(; i < count; i += 1){
+		if(left[i] != right[i]){ return i; }
 	}
+	return count;
+}
 
-	isize cmp = mem_compare(left.v, right.v, min(left.len, right.len));
-	return cmp;
+isize str_compare(String left, String right){
+	isize n = min(left.len, right.len);
+	isize i = str_mismatch(left.v, right.v, n);
+	if(i < n){
+		return (isize)left.v[i] - (isize)right.v[i];
+	}
+	return (left.len > right.len) - (left.len < right.len);
 }
 
 bool str_equals(String left, String right){
@@ -46,14 +70,279 @@ String str_sub(String s, isize start, isize end){
 	return (String){ .v = s.v + start, .len = end - start };
 }
 
+//// Search
+isize str_find_byte(String s, byte b){
+	isize i = 0;
+#if defined(STR_SSE2)
+	__m128i target = _mm_set1_epi8((char)b);
+	for(; i + STR_BLOCK <= s.len; i += STR_BLOCK){
+		__m128i block = _mm_loadu_si128((__m128i const*)(s.v + i));
+		u32 hits = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+		if(hits != 0){
+			return i + bit_ctz32(hits);
+		}
+	}
+#endif
+	for(; i < s.len; i += 1){
+		if(s.v[i] == b){ return i; }
+	}
+	return -1;
+}
+
+isize str_find_last_byte(String s, byte b){
+	isize i = s.len;
+#if defined(STR_SSE2)
+	__m128i target = _mm_set1_epi8((char)b);
+	for(; i >= STR_BLOCK; i -= STR_BLOCK){
+		__m128i block = _mm_loadu_si128((__m128i const*)(s.v + i - STR_BLOCK));
+		u32 hits = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+		if(hits != 0){
+			return i - STR_BLOCK + (63 - bit_clz64(hits));
+		}
+	}
+#endif
+	for(; i > 0; i -= 1){
+		if(s.v[i - 1] == b){ return i - 1; }
+	}
+	return -1;
+}
+
+ByteSet byte_set_make(String bytes){
+	ByteSet set = {0};
+	for(isize i = 0; i < bytes.len; i += 1){
+		byte b = bytes.v[i];
+		if(byte_set_has(&set, b)){ continue; }
+		set.bits[b >> 5] |= 1u << (b & 31);
+		if(set.count >= 0 && set.count < (i32)sizeof(set.members)){
+			set.members[set.count] = b;
+			set.count += 1;
+		}
+		else {
+			set.count = -1;
+		}
+	}
+	return set;
+}
+
+isize str_find_any(String s, ByteSet const* set){
+	isize i = 0;
+#if defined(STR_SSE2)
+	/* Small sets compare every block against each member, larger ones use the bitmap */
+	if(set->count > 0){
+		__m128i members[16];
+		for(i32 m = 0; m < set->count; m += 1){
+			members[m] = _mm_set1_epi8((char)set->members[m]);
+		}
+		for(; i + STR_BLOCK <= s.len; i += STR_BLOCK){
+			__m128i block = _mm_loadu_si128((__m128i const*)(s.v + i));
+			__m128i any = _mm_cmpeq_epi8(block, members[0]);
+			for(i32 m = 1; m < set->count; m += 1){
+				any = _mm_or_si128(any, _mm_cmpeq_epi8(block, members[m]));
+			}
+			u32 hits = (u32)_mm_movemask_epi8(any);
+			if(hits != 0){
+				return i + bit_ctz32(hits);
+			}
+		}
+	}
+#endif
+	for(; i < s.len; i += 1){
+		if(byte_set_has(set, s.v[i])){ return i; }
+	}
+	return -1;
+}
+
+isize str_count_byte(String s, byte b){
+	isize count = 0;
+	isize i = 0;
+#if defined(STR_SSE2)
+	/* cmpeq gives -1 per match, so subtracting it counts matches per lane. Lanes
+	 * are summed before they can wrap at 255 blocks. */
+	__m128i target = _mm_set1_epi8((char)b);
+	__m128i zero = _mm_setzero_si128();
+	while(i + STR_BLOCK <= s.len){
+		__m128i lanes = zero;
+		isize end = min(s.len - STR_BLOCK, i + 254 * STR_BLOCK);
+		for(; i <= end; i += STR_BLOCK){
+			__m128i block = _mm_loadu_si128((__m128i const*)(s.v + i));
+			lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, target));
+		}
+		__m128i sums = _mm_sad_epu8(lanes, zero);
+		count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+	}
+#endif
+	for(; i < s.len; i += 1){
+		count += s.v[i] == b;
+	}
+	return count;
+}
+
+/* Candidates are positions where both the first and last byte of the needle
+ * match, tested 16 at a time. Only those get a full comparison. */
+static
+isize str_find_candidates(String s, String needle, isize i, u32 hits){
+	while(hits != 0){
+		isize pos = i + bit_ctz32(hits);
+		if(mem_compare(s.v + pos + 1, needle.v + 1, needle.len - 2) == 0){
+			return pos;
+		}
+		hits &= hits - 1;
+	}
+	return -1;
+}
+
+isize str_find(String s, String needle){
+	if(needle.len == 0){ return 0; }
+	if(needle.len > s.len){ return -1; }
+	if(needle.len == 1){ return str_find_byte(s, needle.v[0]); }
+
+	isize last = needle.len - 1;
+	isize end = s.len - needle.len; /* Last valid start */
+	isize i = 0;
+#if defined(STR_SSE2)
+	/* The scan loop has no calls, so the needle bytes stay in registers */
+	for(;;){
+		__m128i first_byte = _mm_set1_epi8((char)needle.v[0]);
+		__m128i last_byte = _mm_set1_epi8((char)needle.v[last]);
+		u32 hits = 0;
+		for(; i + STR_BLOCK - 1 <= end; i += STR_BLOCK){
+			__m128i head = _mm_loadu_si128((__m128i const*)(s.v + i));
+			__m128i tail = _mm_loadu_si128((__m128i const*)(s.v + i + last));
+			__m128i both = _mm_and_si128(_mm_cmpeq_epi8(head, first_byte), _mm_cmpeq_epi8(tail, last_byte));
+			hits = (u32)_mm_movemask_epi8(both);
+			if(hits != 0){ break; }
+		}
+		if(hits == 0){ break; }
+
+		isize pos = str_find_candidates(s, needle, i, hits);
+		if(pos >= 0){ return pos; }
+		i += STR_BLOCK;
+	}
+#endif
+	for(; i <= end; i += 1){
+		if(s.v[i] == needle.v[0] && s.v[i + last] == needle.v[last] &&
+		   mem_compare(s.v + i + 1, needle.v + 1, needle.len - 2) == 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
 static inline
-i64 str_ipow10(int exponent){
-	ensure(exponent >= 0, "Invalid exponent");
-	i64 n = 1;
-	for(int i = 0; i < exponent; i++){
-		n *= 10;
+byte str_ascii_lower(byte c){
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+bool str_equals_ignore_case(String left, String right){
+	if(left.len != right.len){ return false; }
+	isize i = 0;
+#if defined(STR_SSE2)
+	/* Shift 'A'..'Z' to the bottom of the signed range to find them with one compare */
+	__m128i shift = _mm_set1_epi8((char)(0x80 - 'A'));
+	__m128i upper_limit = _mm_set1_epi8((char)(0x80 + 26));
+	__m128i case_bit = _mm_set1_epi8(0x20);
+	for(; i + STR_BLOCK <= left.len; i += STR_BLOCK){
+		__m128i l = _mm_loadu_si128((__m128i const*)(left.v + i));
+		__m128i r = _mm_loadu_si128((__m128i const*)(right.v + i));
+		__m128i l_upper = _mm_cmplt_epi8(_mm_add_epi8(l, shift), upper_limit);
+		__m128i r_upper = _mm_cmplt_epi8(_mm_add_epi8(r, shift), upper_limit);
+		l = _mm_or_si128(l, _mm_and_si128(l_upper, case_bit));
+		r = _mm_or_si128(r, _mm_and_si128(r_upper, case_bit));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xffff){
+			return false;
+		}
+	}
+#endif
+	for(; i < left.len; i += 1){
+		if(str_ascii_lower(left.v[i]) != str_ascii_lower(right.v[i])){ return false; }
 	}
-	return n;
+	return true;
+}
+
+//// Iterators
+StrSplitIter str_split(String s, byte delimiter){
+	return (StrSplitIter){ .source = s, .delimiter = delimiter };
+}
+
+bool str_split_next(StrSplitIter* it, String* piece){
+	if(it->offset > it->source.len){ return false; }
+
+	String rest = str_sub(it->source, it->offset, it->source.len);
+	isize end = str_find_byte(rest, it->delimiter);
+	if(end < 0){
+		end = rest.len;
+	}
+	*piece = str_sub(rest, 0, end);
+	it->offset += end + 1;
+	return true;
+}
+
+StrSplitAnyIter str_split_any(String s, String delimiters){
+	return (StrSplitAnyIter){ .source = s, .delimiters = byte_set_make(delimiters) };
+}
+
+StrSplitAnyIter str_fields(String s){
+	StrSplitAnyIter it = str_split_any(s, str_lit(" \t\r\n\v\f"));
+	it.skip_empty = true;
+	return it;
+}
+
+bool str_split_any_next(StrSplitAnyIter* it, String* piece){
+	while(it->offset <= it->source.len){
+		String rest = str_sub(it->source, it->offset, it->source.len);
+		isize end = str_find_any(rest, &it->delimiters);
+		if(end < 0){
+			end = rest.len;
+		}
+		it->offset += end + 1;
+		if(end > 0 || !it->skip_empty){
+			*piece = str_sub(rest, 0, end);
+			return true;
+		}
+	}
+	return false;
+}
+
+StrLineIter str_lines(String s){
+	return (StrLineIter){ .source = s };
+}
+
+bool str_lines_next(StrLineIter* it, String* line){
+	if(it->offset >= it->source.len){ return false; }
+
+	String rest = str_sub(it->source, it->offset, it->source.len);
+	isize end = str_find_byte(rest, '\n');
+	if(end < 0){
+		end = rest.len;
+		it->offset = it->source.len;
+	}
+	else {
+		it->offset += end + 1;
+	}
+	if(end > 0 && rest.v[end - 1] == '\r'){
+		end -= 1;
+	}
+	*line = str_sub(rest, 0, end);
+	return true;
+}
+
+StrRuneIter str_runes(String s){
+	return (StrRuneIter){ .source = s };
+}
+
+bool str_runes_next(StrRuneIter* it, rune* r){
+	if(it->offset >= it->source.len){ return false; }
+
+	byte b = it->source.v[it->offset];
+	if(b < 0x80){
+		*r = b;
+		it->offset += 1;
+		return true;
+	}
+	UTF8Decoded dec = utf8_decode(it->source.v + it->offset, it->source.len - it->offset);
+	*r = dec.codepoint;
+	it->offset += dec.len;
+	return true;
 }
 
 static inline
@@ -88,43 +377,45 @@ int str_digit_value(char c, int base){
 	return val;
 }
 
-bool str_parse_i64(String s, u32 base, i64* out){
-	if(s.len == 0){ return false; }
-
-	bool negate = false;
-	if(s.v[0] == '-'){
-		negate = true;
-		s = str_sub(s, 1, s.len);
-	}
-
-	i64 n = 0;
+bool str_parse_u64(String s, u32 base, u64* out){
 	*out = 0;
-
-	int digit_count = 0;
-	for(isize i = s.len - 1; i >= 0; i -= 1){
+	u64 n = 0;
+	isize digit_count = 0;
+	for(isize i = 0; i < s.len; i += 1){
 		char c = s.v[i];
 		if(c == '_'){ continue; }
 
-		i64 dig = str_digit_value(c, 16);
+		int dig = str_digit_value(c, base);
 		if(dig < 0){
 			return false;
 		}
-
-		switch(base){
-		case 2:  n |= dig << digit_count; break;
-		case 8:  n |= dig << (digit_count * 3); break;
-		case 16: n |= dig << (digit_count * 4); break;
-		case 10: n += dig * str_ipow10(digit_count); break;
+		if(n > (UINT64_MAX - (u64)dig) / base){
+			return false; /* Doesn't fit */
 		}
-
+		n = n * base + (u64)dig;
 		digit_count += 1;
 	}
+	if(digit_count == 0){
+		return false;
+	}
 
+	*out = n;
+	return true;
+}
+
+bool str_parse_i64(String s, u32 base, i64* out){
+	*out = 0;
+	bool negate = s.len > 0 && s.v[0] == '-';
 	if(negate){
-		n = -n;
+		s = str_sub(s, 1, s.len);
 	}
 
-	*out = n;
+	u64 n = 0;
+	if(!str_parse_u64(s, base, &n) || n > (u64)INT64_MAX + negate){
+		return false;
+	}
+
+	*out = negate ? (i64)(0 - n) : (i64)n;
 	return true;
 }
 
@@ -159,3 +450,5 @@ bool str_parse_f64(String s, f64* out){
 }
 
 #undef STRCONV_TEMP_BUFFER_SIZE
+#undef STR_BLOCK
+#undef STR_SSE2
@@ -37,14 +37,62 @@ UTF8Encoded utf8_encode(rune r);
 
 UTF8Decoded utf8_decode(byte const* buf, isize n);
 
+/* Offset of the first byte of the first ill-formed sequence, -1 if all of buf
+ * is valid UTF-8 */
+isize utf8_validate(byte const* buf, isize n);
+
+/* Bulk helpers. Counts only look at lead bytes and are exact for valid
+ * UTF-8. Conversions handle invalid input like utf8_decode, every bad byte
+ * becomes one U+FFFD. */
+isize utf8_rune_count(byte const* buf, isize n);
+
+/* UTF-16 units needed for buf, which is also the UTF-16 offset of byte n */
+isize utf8_utf16_length(byte const* buf, isize n);
+
+/* Byte offset of a UTF-16 offset, stops at n */
+isize utf8_offset_from_utf16(byte const* buf, isize n, isize utf16_offset);
+
+/* Transcode into out and return the number of units written. out needs room
+ * for n units (utf8_to_*) or 3 * n bytes (utf16_to_utf8). */
+isize utf8_to_utf16(byte const* buf, isize n, u16* out);
+
+isize utf8_to_utf32(byte const* buf, isize n, rune* out);
+
+isize utf16_to_utf8(u16 const* buf, isize n, byte* out);
+
+/* Decode without any checks, buf must hold a complete, valid sequence (e.g.
+ * from a buffer that passed utf8_validate) */
+static inline
+UTF8Decoded utf8_decode_unchecked(byte const* buf){
+	byte b = buf[0];
+	if(b < 0x80){
+		return (UTF8Decoded){ .codepoint = b, .len = 1 };
+	}
+	if(b < 0xe0){
+		return (UTF8Decoded){ .codepoint = ((b & 0x1f) << 6) | (buf[1] & 0x3f), .len = 2 };
+	}
+	if(b < 0xf0){
+		return (UTF8Decoded){ .codepoint = ((b & 0x0f) << 12) | ((buf[1] & 0x3f) << 6) | (buf[2] & 0x3f), .len = 3 };
+	}
+	return (UTF8Decoded){
+		.codepoint = ((b & 0x07) << 18) | ((buf[1] & 0x3f) << 12) | ((buf[2] & 0x3f) << 6) | (buf[3] & 0x3f),
+		.len = 4,
+	};
+}
+
 String str_format(Arena* arena, char const * restrict fmt, ...) str_attribute_format(2, 3);
 
 String str_vformat(Arena* arena, char const * restrict fmt, va_list argp);
 
 String str_sub(String s, isize start, isize end);
 
+/* Byte order: negative if left sorts first, 0 if equal, positive otherwise.
+ * A prefix sorts before any longer string. */
 isize str_compare(String left, String right);
 
+/* Parsing fails on a value that doesn't fit, '_' separators are skipped */
+bool str_parse_u64(String s, u32 base, u64* out);
+
 bool str_parse_i64(String s, u32 base, i64* out);
 
 bool str_parse_f64(String s, f64* out);
@@ -56,3 +104,146 @@ bool str_starts_with(String s, String prefix);
 bool str_ends_with(String s, String postfix);
 
 bool rune_is_digit(rune r, int base);
+
+/* Unicode identifier classes (UAX #31). ASCII is checked inline, anything
+ * else costs two table loads. '_' is XID_Continue but not XID_Start. */
+bool rune_is_xid_start(rune r);
+
+bool rune_is_xid_continue(rune r);
+
+//// Search
+/* Searches return a byte index, or -1 when there is no match. They scan 16
+ * bytes per step with SSE2 when available. */
+typedef struct {
+	u32 bits[8];     /* Membership bitmap */
+	u8 members[16];  /* Listed for the SIMD path */
+	i32 count;       /* Listed members, -1 if there are more than 16 */
+} ByteSet;
+
+ByteSet byte_set_make(String bytes);
+
+static inline
+bool byte_set_has(ByteSet const* set, byte b){
+	return (set->bits[b >> 5] >> (b & 31)) & 1;
+}
+
+isize str_find(String s, String needle);
+
+isize str_find_byte(String s, byte b);
+
+isize str_find_last_byte(String s, byte b);
+
+/* First byte that is in set */
+isize str_find_any(String s, ByteSet const* set);
+
+isize str_count_byte(String s, byte b);
+
+bool str_equals_ignore_case(String left, String right);
+
+//// Iterators
+/* Zero-copy iterators: every piece is a view into the source string. Use as
+ *
+ *     StrLineIter it = str_lines(source);
+ *     for(String line; str_lines_next(&it, &line);){ ... }
+ */
+typedef struct {
+	String source;
+	isize offset; /* Start of the next piece, past source.len once done */
+	byte delimiter;
+} StrSplitIter;
+
+typedef struct {
+	String source;
+	isize offset;
+	ByteSet delimiters;
+	bool skip_empty;
+} StrSplitAnyIter;
+
+typedef struct {
+	String source;
+	isize offset;
+} StrLineIter;
+
+typedef struct {
+	String source;
+	isize offset;
+} StrRuneIter;
+
+/* Pieces between delimiters, including empty ones: "a,,b" gives "a", "", "b" */
+StrSplitIter str_split(String s, byte delimiter);
+
+bool str_split_next(StrSplitIter* it, String* piece);
+
+/* Split on any byte of delimiters */
+StrSplitAnyIter str_split_any(String s, String delimiters);
+
+/* Runs of non-whitespace, empty pieces skipped */
+StrSplitAnyIter str_fields(String s);
+
+bool str_split_any_next(StrSplitAnyIter* it, String* piece);
+
+/* Lines without their "\n" or "\r\n" terminator. A final terminator does not
+ * start another (empty) line. */
+StrLineIter str_lines(String s);
+
+bool str_lines_next(StrLineIter* it, String* line);
+
+/* Decoded codepoints, invalid bytes come out one at a time as UTF8_ERROR */
+StrRuneIter str_runes(String s);
+
+bool str_runes_next(StrRuneIter* it, rune* r);
+
+//// Number formatting
+/* Write the decimal form into buf and return its length, no NUL terminator.
+ * buf must have room for FMT_INT_MAX / FMT_F64_MAX bytes. */
+#define FMT_INT_MAX 20
+#define FMT_F64_MAX 32
+
+isize fmt_u64(byte* buf, u64 v);
+
+isize fmt_i64(byte* buf, i64 v);
+
+/* Shortest digits that parse back to exactly v */
+isize fmt_f64(byte* buf, f64 v);
+
+//// String builder
+/* Appends go into a list of chunks that are never moved, so building a large
+ * string never copies what was already written. Chunks are kept on reset. */
+typedef struct StrChunk StrChunk;
+
+struct StrChunk {
+	StrChunk* next;
+	isize len;
+	isize cap;
+	byte data[];
+};
+
+typedef struct {
+	StrChunk* first;
+	StrChunk* last;
+	isize len;
+	isize chunk_size;
+	Allocator allocator;
+} StrBuilder;
+
+StrBuilder str_builder_create(Allocator allocator, isize chunk_size);
+
+void str_builder_append(StrBuilder* sb, String s);
+
+void str_builder_append_byte(StrBuilder* sb, byte b);
+
+void str_builder_format(StrBuilder* sb, char const * restrict fmt, ...) str_attribute_format(2, 3);
+
+void str_builder_vformat(StrBuilder* sb, char const * restrict fmt, va_list argp);
+
+/* Contiguous view of the contents. Zero-copy when everything is in one chunk,
+ * otherwise the chunks are merged into one (which stays owned by the builder).
+ * Valid until the next append, reset or destroy. */
+String str_builder_build(StrBuilder* sb);
+
+/* Write everything to a file descriptor (writev on Linux) and reset */
+bool str_builder_flush(StrBuilder* sb, int fd);
+
+void str_builder_reset(StrBuilder* sb);
+
+void str_builder_destroy(StrBuilder* sb);
@@ -0,0 +1,213 @@
+#include "string.h"
+#include "io.h"
+#include "stb_sprintf.h"
+
+#if defined(OS_LINUX)
+#include <sys/uio.h>
+#endif
+
+#define STR_BUILDER_DEFAULT_CHUNK (4 * mem_kilobyte)
+#define STR_BUILDER_IOV_BATCH     64
+
+StrBuilder str_builder_create(Allocator allocator, isize chunk_size){
+	return (StrBuilder){
+		.chunk_size = chunk_size > 0 ? chunk_size : STR_BUILDER_DEFAULT_CHUNK,
+		.allocator = allocator,
+	};
+}
+
+/* Make sure the current chunk has at least `want` free bytes, moving on to a
+ * (possibly recycled) next chunk or allocating a new one */
+static
+bool str_builder_reserve(StrBuilder* sb, isize want){
+	if(sb->last != NULL && sb->last->cap - sb->last->len >= want){
+		return true;
+	}
+
+	/* Chunks kept around by reset */
+	if(sb->last != NULL && sb->last->next != NULL && sb->last->next->cap >= want){
+		sb->last = sb->last->next;
+		sb->last->len = 0;
+		return true;
+	}
+
+	isize cap = max(sb->chunk_size, want);
+	StrChunk* chunk = mem_alloc(sb->allocator, sizeof(StrChunk) + cap, alignof(StrChunk));
+	if(chunk == NULL){
+		return false;
+	}
+	chunk->len = 0;
+	chunk->cap = cap;
+
+	if(sb->last == NULL){
+		chunk->next = sb->first; /* Empty builder, keep any recycled chunks after it */
+		sb->first = chunk;
+	} else {
+		chunk->next = sb->last->next;
+		sb->last->next = chunk;
+	}
+	sb->last = chunk;
+	return true;
+}
+
+void str_builder_append(StrBuilder* sb, String s){
+	while(s.len > 0){
+		isize room = sb->last != NULL ? sb->last->cap - sb->last->len : 0;
+		if(room == 0){
+			if(!str_builder_reserve(sb, min(s.len, sb->chunk_size))){ return; }
+			room = sb->last->cap - sb->last->len;
+		}
+
+		isize n = min(room, s.len);
+		mem_copy_no_overlap(sb->last->data + sb->last->len, s.v, n);
+		sb->last->len += n;
+		sb->len += n;
+		s.v += n;
+		s.len -= n;
+	}
+}
+
+void str_builder_append_byte(StrBuilder* sb, byte b){
+	if(!str_builder_reserve(sb, 1)){ return; }
+	sb->last->data[sb->last->len] = b;
+	sb->last->len += 1;
+	sb->len += 1;
+}
+
+typedef struct {
+	StrBuilder* sb;
+	char scratch[STB_SPRINTF_MIN];
+} StrBuilderFormatContext;
+
+/* stb_sprintf hands back at most STB_SPRINTF_MIN bytes at a time. Let it write
+ * straight into the chunk when there's room, otherwise into scratch. */
+static
+char* str_builder_format_callback(char const* buf, void* user, int len){
+	StrBuilderFormatContext* ctx = user;
+	StrBuilder* sb = ctx->sb;
+
+	if(buf != ctx->scratch && sb->last != NULL && buf == (char*)sb->last->data + sb->last->len){
+		sb->last->len += len;
+		sb->len += len;
+	} else if(len > 0){
+		str_builder_append(sb, (String){ .v = (byte const*)buf, .len = len });
+	}
+
+	if(sb->last != NULL && sb->last->cap - sb->last->len >= STB_SPRINTF_MIN){
+		return (char*)sb->last->data + sb->last->len;
+	}
+	return ctx->scratch;
+}
+
+void str_builder_vformat(StrBuilder* sb, char const * restrict fmt, va_list argp){
+	StrBuilderFormatContext ctx = { .sb = sb };
+	stbsp_vsprintfcb(str_builder_format_callback, &ctx, str_builder_format_callback(ctx.scratch, &ctx, 0), fmt, argp);
+}
+
+void str_builder_format(StrBuilder* sb, char const * restrict fmt, ...){
+	va_list argp;
+	va_start(argp, fmt);
+	str_builder_vformat(sb, fmt, argp);
+	va_end(argp);
+}
+
+String str_builder_build(StrBuilder* sb){
+	if(sb->len == 0){
+		return (String){0};
+	}
+	if(sb->first == sb->last){
+		return (String){ .v = sb->first->data, .len = sb->len };
+	}
+
+	StrChunk* merged = mem_alloc(sb->allocator, sizeof(StrChunk) + sb->len, alignof(StrChunk));
+	if(merged == NULL){
+		return (String){0};
+	}
+	merged->cap = sb->len;
+	merged->len = 0;
+
+	StrChunk* chunk = sb->first;
+	StrChunk* end = sb->last->next;
+	while(chunk != end){
+		StrChunk* next = chunk->next;
+		mem_copy_no_overlap(merged->data + merged->len, chunk->data, chunk->len);
+		merged->len += chunk->len;
+		mem_free(sb->allocator, chunk, sizeof(StrChunk) + chunk->cap);
+		chunk = next;
+	}
+
+	merged->next = end;
+	sb->first = merged;
+	sb->last = merged;
+	return (String){ .v = merged->data, .len = merged->len };
+}
+
+bool str_builder_flush(StrBuilder* sb, int fd){
+	bool ok = true;
+	StrChunk* end = sb->last != NULL ? sb->last->next : NULL;
+
+#if defined(OS_LINUX)
+	StrChunk* chunk = sb->first;
+	while(ok && chunk != end){
+		struct iovec iov[STR_BUILDER_IOV_BATCH];
+		int count = 0;
+		isize total = 0;
+		for(; chunk != end && count < STR_BUILDER_IOV_BATCH; chunk = chunk->next){
+			if(chunk->len == 0){ continue; }
+			iov[count] = (struct iovec){ .iov_base = chunk->data, .iov_len = chunk->len };
+			total += chunk->len;
+			count += 1;
+		}
+		if(count == 0){ break; }
+
+		isize written = writev(fd, iov, count);
+		if(written < 0){
+			ok = false;
+			break;
+		}
+
+		/* Short write, finish the batch one buffer at a time */
+		for(int i = 0; ok && written < total && i < count; i += 1){
+			isize len = iov[i].iov_len;
+			if(written >= len){
+				written -= len;
+				total -= len;
+				continue;
+			}
+			ok = io_write_all(fd, (byte const*)iov[i].iov_base + written, len - written);
+			total -= len;
+			written = 0;
+		}
+	}
+#else
+	for(StrChunk* chunk = sb->first; ok && chunk != end; chunk = chunk->next){
+		ok = io_write_all(fd, chunk->data, chunk->len);
+	}
+#endif
+
+	str_builder_reset(sb);
+	return ok;
+}
+
+void str_builder_reset(StrBuilder* sb){
+	if(sb->first != NULL){
+		sb->first->len = 0;
+	}
+	sb->last = sb->first;
+	sb->len = 0;
+}
+
+void str_builder_destroy(StrBuilder* sb){
+	StrChunk* chunk = sb->first;
+	while(chunk != NULL){
+		StrChunk* next = chunk->next;
+		mem_free(sb->allocator, chunk, sizeof(StrChunk) + chunk->cap);
+		chunk = next;
+	}
+	sb->first = NULL;
+	sb->last = NULL;
+	sb->len = 0;
+}
+
+#undef STR_BUILDER_DEFAULT_CHUNK
+#undef STR_BUILDER_IOV_BATCH
@@ -0,0 +1,213 @@
+#include "thread.h"
+
+typedef struct {
+	ThreadFunc func;
+	void* arg;
+} ThreadStart;
+
+#if defined(OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+static
+void* thread_trampoline(void* p){
+	ThreadStart start = *(ThreadStart*)p;
+	heap_free(p);
+	start.func(start.arg);
+	heap_thread_flush();
+	return NULL;
+}
+
+bool thread_create(Thread* t, ThreadFunc func, void* arg){
+	ThreadStart* start = heap_alloc(sizeof(ThreadStart), alignof(ThreadStart));
+	*start = (ThreadStart){ .func = func, .arg = arg };
+
+	pthread_t handle;
+	if(pthread_create(&handle, NULL, thread_trampoline, start) != 0){
+		heap_free(start);
+		return false;
+	}
+	t->handle = (uintptr)handle;
+	return true;
+}
+
+void thread_join(Thread* t){
+	pthread_join((pthread_t)t->handle, NULL);
+}
+
+void thread_yield(){
+	sched_yield();
+}
+
+i32 thread_cpu_count(){
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (i32)n : 1;
+}
+
+#elif defined(OS_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static
+DWORD WINAPI thread_trampoline(void* p){
+	ThreadStart start = *(ThreadStart*)p;
+	heap_free(p);
+	start.func(start.arg);
+	heap_thread_flush();
+	return 0;
+}
+
+bool thread_create(Thread* t, ThreadFunc func, void* arg){
+	ThreadStart* start = heap_alloc(sizeof(ThreadStart), alignof(ThreadStart));
+	*start = (ThreadStart){ .func = func, .arg = arg };
+
+	HANDLE handle = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+	if(handle == NULL){
+		heap_free(start);
+		return false;
+	}
+	t->handle = (uintptr)handle;
+	return true;
+}
+
+void thread_join(Thread* t){
+	WaitForSingleObject((HANDLE)t->handle, INFINITE);
+	CloseHandle((HANDLE)t->handle);
+}
+
+void thread_yield(){
+	SwitchToThread();
+}
+
+i32 thread_cpu_count(){
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (i32)info.dwNumberOfProcessors : 1;
+}
+#endif
+
+//// Parallel for
+/* A worker's remaining indices packed as begin << 32 | end, so taking from
+ * either side is a single compare and swap */
+typedef struct {
+	alignas(64) _Atomic(u64) range;
+} ParallelSlice;
+
+typedef struct {
+	ParallelSlice* slices;
+	u32 worker_count;
+	ParallelFunc func;
+	void* ctx;
+} ParallelJob;
+
+typedef struct {
+	ParallelJob* job;
+	u32 worker;
+} ParallelWorker;
+
+static inline
+u64 parallel_range(u32 begin, u32 end){
+	return ((u64)begin << 32) | end;
+}
+
+/* Front of the worker's own slice, false when it is empty */
+static
+bool parallel_take(ParallelSlice* slice, u32* index){
+	u64 range = atomic_load_explicit(&slice->range, memory_order_acquire);
+	for(;;){
+		u32 begin = (u32)(range >> 32);
+		u32 end = (u32)range;
+		if(begin >= end){
+			return false;
+		}
+		if(atomic_compare_exchange_weak_explicit(&slice->range, &range, parallel_range(begin + 1, end), memory_order_acq_rel, memory_order_acquire)){
+			*index = begin;
+			return true;
+		}
+	}
+}
+
+/* Back half of a victim's slice */
+static
+bool parallel_steal(ParallelSlice* victim, u32* begin, u32* end){
+	u64 range = atomic_load_explicit(&victim->range, memory_order_acquire);
+	for(;;){
+		u32 b = (u32)(range >> 32);
+		u32 e = (u32)range;
+		if(b >= e){
+			return false;
+		}
+		u32 mid = e - (e - b + 1) / 2;
+		if(atomic_compare_exchange_weak_explicit(&victim->range, &range, parallel_range(b, mid), memory_order_acq_rel, memory_order_acquire)){
+			*begin = mid;
+			*end = e;
+			return true;
+		}
+	}
+}
+
+static
+void parallel_worker_run(void* arg){
+	ParallelWorker* w = arg;
+	ParallelJob* job = w->job;
+	ParallelSlice* own = &job->slices[w->worker];
+
+	for(;;){
+		u32 index = 0;
+		while(parallel_take(own, &index)){
+			job->func(job->ctx, w->worker, index);
+		}
+
+		/* Every index is either in some slice or already being run by a
+		 * thief, so one empty pass over the others means we're done */
+		bool stole = false;
+		for(u32 i = 1; i < job->worker_count && !stole; i += 1){
+			u32 begin = 0, end = 0;
+			if(parallel_steal(&job->slices[(w->worker + i) % job->worker_count], &begin, &end)){
+				/* Our slice is empty, so nobody else is changing it */
+				atomic_store_explicit(&own->range, parallel_range(begin, end), memory_order_release);
+				stole = true;
+			}
+		}
+		if(!stole){
+			return;
+		}
+	}
+}
+
+void parallel_for(u32 worker_count, u32 count, ParallelFunc func, void* ctx){
+	worker_count = max(min(worker_count, count), 1u);
+	ParallelJob job = {
+		.slices = heap_alloc(sizeof(ParallelSlice) * worker_count, alignof(ParallelSlice)),
+		.worker_count = worker_count,
+		.func = func,
+		.ctx = ctx,
+	};
+	ParallelWorker* workers = heap_alloc(sizeof(ParallelWorker) * worker_count, alignof(ParallelWorker));
+	Thread* threads = heap_alloc(sizeof(Thread) * worker_count, alignof(Thread));
+
+	for(u32 i = 0; i < worker_count; i += 1){
+		u32 begin = (u32)(((u64)count * i) / worker_count);
+		u32 end = (u32)(((u64)count * (i + 1)) / worker_count);
+		atomic_init(&job.slices[i].range, parallel_range(begin, end));
+		workers[i] = (ParallelWorker){ .job = &job, .worker = i };
+	}
+
+	/* Threads that fail to start leave their slice to be stolen */
+	bool* started = heap_alloc(sizeof(bool) * worker_count, alignof(bool));
+	for(u32 i = 1; i < worker_count; i += 1){
+		started[i] = thread_create(&threads[i], parallel_worker_run, &workers[i]);
+	}
+	parallel_worker_run(&workers[0]);
+	for(u32 i = 1; i < worker_count; i += 1){
+		if(started[i]){
+			thread_join(&threads[i]);
+		}
+	}
+
+	heap_free(started);
+	heap_free(threads);
+	heap_free(workers);
+	heap_free(job.slices);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "types.h"
+#include "memory.h"
+
+//// Threads
+typedef void (*ThreadFunc)(void* arg);
+
+typedef struct {
+	uintptr handle;
+} Thread;
+
+/* Returns false if the OS could not start the thread */
+bool thread_create(Thread* t, ThreadFunc func, void* arg);
+
+void thread_join(Thread* t);
+
+/* Give up the rest of the time slice, for spin-wait loops */
+void thread_yield();
+
+/* Logical processors available to the process, at least 1 */
+i32 thread_cpu_count();
+
+//// Parallel for
+/* Runs func(ctx, worker, index) once for every index in [0, count), on
+ * worker_count threads where the calling thread is worker 0. Each worker
+ * starts with an even slice of the indices and takes from its front; one
+ * that runs dry steals the back half of another worker's slice, so uneven
+ * tasks still keep every thread busy. Returns once all of them are done. */
+typedef void (*ParallelFunc)(void* ctx, u32 worker, u32 index);
+
+void parallel_for(u32 worker_count, u32 count, ParallelFunc func, void* ctx);
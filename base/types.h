@@ -14,9 +14,15 @@
 	#define force_inline __attribute__((always_inline)) inline
 #endif
 
+#if defined(COMPILER_MSVC)
+	#define thread_local __declspec(thread)
+#else
+	#define thread_local _Thread_local
+#endif
+
 #define c_array_length(A) ((isize)(sizeof(A) / sizeof(A[0])))
 
-#define static_assert(Pred, Msg) _Static_assert((Pred), (Msg))
+#define static_assert(Pred, Msg) _Static_assert((Pred), Msg)
 
 #define min(A, B) (((A) < (B)) ? (A) : (B))
 
@@ -62,3 +68,18 @@ typedef struct {
 // To be used with `%.*s`
 #define str_fmt(S) (int)(S.len), (char const*)(S.v)
 
+
+//// Bit operations
+/* Arguments must be non-zero */
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+static inline int bit_ctz32(u32 x){ unsigned long i; _BitScanForward(&i, x); return (int)i; }
+static inline int bit_ctz64(u64 x){ unsigned long i; _BitScanForward64(&i, x); return (int)i; }
+static inline int bit_clz64(u64 x){ unsigned long i; _BitScanReverse64(&i, x); return 63 - (int)i; }
+static inline int bit_popcount64(u64 x){ return (int)__popcnt64(x); }
+#else
+static inline int bit_ctz32(u32 x){ return __builtin_ctz(x); }
+static inline int bit_ctz64(u64 x){ return __builtin_ctzll(x); }
+static inline int bit_clz64(u64 x){ return __builtin_clzll(x); }
+static inline int bit_popcount64(u64 x){ return __builtin_popcountll(x); }
+#endif
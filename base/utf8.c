@@ -1,5 +1,23 @@
 #include "string.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define UTF8_SSE2 1
+#endif
+
+/* Builds without -mssse3 still get the block validator on GCC and Clang, it
+ * is compiled for SSSE3 on its own and picked at runtime */
+#if defined(__SSSE3__) || defined(__AVX__)
+	#include <tmmintrin.h>
+	#define UTF8_SSSE3 1
+	#define UTF8_SSSE3_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <tmmintrin.h>
+	#define UTF8_SSSE3 1
+	#define UTF8_SSSE3_DISPATCH 1
+	#define UTF8_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
 #define UTF8_RANGE1 ((i32)0x7f)
 #define UTF8_RANGE2 ((i32)0x7ff)
 #define UTF8_RANGE3 ((i32)0xffff)
@@ -33,10 +51,7 @@ i32 utf8_rune_size(rune c){
 UTF8Encoded utf8_encode(rune c){
 	UTF8Encoded res = {};
 
-	if(utf8_is_continuation_byte(c) ||
-	   (c >= UTF16_SURROGATE1 && c <= UTF16_SURROGATE2) ||
-	   (c > UTF8_RANGE4))
-	{
+	if((c >= UTF16_SURROGATE1 && c <= UTF16_SURROGATE2) || (c < 0) || (c > UTF8_RANGE4)){
 		return UTF8_ERROR_ENCODED;
 	}
 
@@ -102,6 +117,9 @@ UTF8Decoded utf8_decode(byte const* buf, isize len){
 	if(res.codepoint >= UTF16_SURROGATE1 && res.codepoint <= UTF16_SURROGATE2){
 		return UTF8_DECODE_ERROR;
 	}
+	if(res.codepoint > UTF8_RANGE4 || utf8_rune_size(res.codepoint) != res.len){
+		return UTF8_DECODE_ERROR; /* Out of range or overlong */
+	}
 	if(res.len > 1 && !utf8_is_continuation_byte(buf[1])){
 		return UTF8_DECODE_ERROR;
 	}
@@ -115,6 +133,393 @@ UTF8Decoded utf8_decode(byte const* buf, isize len){
 	return res;
 }
 
+//// Validation
+/* Length of the well formed sequence at buf, 0 if there is none. Rejects
+ * overlong forms, surrogates and anything above U+10FFFF. */
+static inline
+i32 utf8_valid_length(byte const* buf, isize len){
+	byte b = buf[0];
+	if(b < 0x80){ return 1; }
+	if(b < 0xc2){ return 0; } /* Continuation, or overlong 2 byte lead */
+
+	if(b < 0xe0){
+		return (len >= 2 && utf8_is_continuation_byte(buf[1])) ? 2 : 0;
+	}
+	if(b < 0xf0){
+		if(len < 3){ return 0; }
+		byte lo = (b == 0xe0) ? 0xa0 : 0x80; /* Overlong */
+		byte hi = (b == 0xed) ? 0x9f : 0xbf; /* Surrogates */
+		return (buf[1] >= lo && buf[1] <= hi && utf8_is_continuation_byte(buf[2])) ? 3 : 0;
+	}
+	if(b < 0xf5){
+		if(len < 4){ return 0; }
+		byte lo = (b == 0xf0) ? 0x90 : 0x80; /* Overlong */
+		byte hi = (b == 0xf4) ? 0x8f : 0xbf; /* Above U+10FFFF */
+		return (buf[1] >= lo && buf[1] <= hi && utf8_is_continuation_byte(buf[2]) && utf8_is_continuation_byte(buf[3])) ? 4 : 0;
+	}
+	return 0;
+}
+
+/* Rune by rune from offset, skipping all-ASCII blocks */
+static
+isize utf8_validate_from(byte const* buf, isize len, isize i){
+	while(i < len){
+#if defined(UTF8_SSE2)
+		if(i + 16 <= len && _mm_movemask_epi8(_mm_loadu_si128((__m128i const*)(buf + i))) == 0){
+			i += 16;
+			continue;
+		}
+#endif
+		i32 n = utf8_valid_length(buf + i, len - i);
+		if(n == 0){
+			return i;
+		}
+		i += n;
+	}
+	return -1;
+}
+
+#if defined(UTF8_SSSE3)
+/* Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+ * Every error shows up in the first 12 bits of a byte pair (the previous byte
+ * and the high nibble of the current one). Three 16 entry tables, one per
+ * nibble, each give the set of errors that nibble allows, and their AND is
+ * non-zero only for a real error. Errors needing 3 or 4 bytes of context are
+ * found by checking continuations against the leads 2 and 3 bytes back. */
+#define UTF8_TOO_SHORT   (1 << 0) /* Lead or ASCII followed by a lead */
+#define UTF8_TOO_LONG    (1 << 1) /* ASCII followed by a continuation */
+#define UTF8_OVERLONG_3  (1 << 2)
+#define UTF8_TOO_LARGE   (1 << 3)
+#define UTF8_SURROGATE   (1 << 4)
+#define UTF8_OVERLONG_2  (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4  (1 << 6)
+#define UTF8_TWO_CONTS   (1 << 7) /* Continuation without a lead */
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static inline UTF8_SSSE3_TARGET
+__m128i utf8_high_nibbles(__m128i v){
+	return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+}
+
+static inline UTF8_SSSE3_TARGET
+__m128i utf8_check_block(__m128i input, __m128i prev_input){
+	__m128i const byte_1_high_table = _mm_setr_epi8(
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+		UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+		UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+		UTF8_TOO_SHORT,
+		UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+		(char)(UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4));
+	__m128i const byte_1_low_table = _mm_setr_epi8(
+		(char)(UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4),
+		(char)(UTF8_CARRY | UTF8_OVERLONG_2),
+		(char)UTF8_CARRY,
+		(char)UTF8_CARRY,
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+		(char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000));
+	__m128i const byte_2_high_table = _mm_setr_epi8(
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+		(char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4),
+		(char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE),
+		(char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE),
+		(char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE),
+		UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+	__m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+	__m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table, utf8_high_nibbles(prev1));
+	__m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, _mm_set1_epi8(0x0f)));
+	__m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table, utf8_high_nibbles(input));
+	__m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+	/* Bytes 2 and 3 after a 3 or 4 byte lead must be continuations, which
+	 * the tables flagged as TWO_CONTS (bit 7). Flip those off, and flip on
+	 * any such byte that is not a continuation. */
+	__m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+	__m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+	__m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xe0 - 0x80)));
+	__m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+	__m128i must_continue = _mm_and_si128(_mm_or_si128(is_third, is_fourth), _mm_set1_epi8((char)0x80));
+	return _mm_xor_si128(must_continue, special);
+}
+
+/* Non-zero if the block ends in the middle of a sequence */
+static inline UTF8_SSSE3_TARGET
+__m128i utf8_block_incomplete(__m128i input){
+	__m128i const max_value = _mm_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		(char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+	return _mm_subs_epu8(input, max_value);
+}
+
+/* Start of the sequence holding buf[i], everything before it is known good */
+static inline
+isize utf8_sequence_start(byte const* buf, isize i){
+	for(isize back = 0; back < 3 && i > 0 && utf8_is_continuation_byte(buf[i]); back += 1){
+		i -= 1;
+	}
+	return i;
+}
+
+static UTF8_SSSE3_TARGET
+isize utf8_validate_ssse3(byte const* buf, isize len){
+	isize i = 0;
+	__m128i prev_input = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+
+	for(; i + 16 <= len; i += 16){
+		__m128i input = _mm_loadu_si128((__m128i const*)(buf + i));
+		__m128i error;
+		if(_mm_movemask_epi8(input) == 0){
+			error = prev_incomplete;
+			prev_incomplete = _mm_setzero_si128();
+		}
+		else {
+			error = utf8_check_block(input, prev_input);
+			prev_incomplete = utf8_block_incomplete(input);
+		}
+		prev_input = input;
+
+		/* Something is wrong in here or at the end of the previous block,
+		 * find exactly where with the scalar path */
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xffff){
+			return utf8_validate_from(buf, len, i > 0 ? utf8_sequence_start(buf, i - 1) : 0);
+		}
+	}
+	if(i > 0){
+		i = utf8_sequence_start(buf, i - 1);
+	}
+	return utf8_validate_from(buf, len, i);
+}
+
+static inline
+bool utf8_has_ssse3(){
+#if defined(UTF8_SSSE3_DISPATCH)
+	return __builtin_cpu_supports("ssse3");
+#else
+	return true;
+#endif
+}
+#endif
+
+isize utf8_validate(byte const* buf, isize len){
+#if defined(UTF8_SSSE3)
+	if(utf8_has_ssse3()){
+		return utf8_validate_ssse3(buf, len);
+	}
+#endif
+	return utf8_validate_from(buf, len, 0);
+}
+
+//// Bulk conversion
+/* Counting only looks at lead bytes: a rune is one byte that is not a
+ * continuation, and takes two UTF-16 units when that byte is a 4 byte lead. */
+static
+isize utf8_count_units(byte const* buf, isize n, bool utf16){
+	isize count = 0;
+	isize i = 0;
+#if defined(UTF8_SSE2)
+	/* As signed bytes continuations are -128..-65. Lanes count up by
+	 * subtracting the -1 compare masks, and are summed before they wrap: a
+	 * block adds at most 1 per lane, or 2 when 4 byte leads count twice. */
+	__m128i lead_limit = _mm_set1_epi8(-65);
+	__m128i long_lead = _mm_set1_epi8((char)0xf0);
+	__m128i zero = _mm_setzero_si128();
+	isize blocks = utf16 ? 127 : 255;
+	while(i + 16 <= n){
+		__m128i lanes = zero;
+		isize end = min(n - 16, i + (blocks - 1) * 16);
+		for(; i <= end; i += 16){
+			__m128i v = _mm_loadu_si128((__m128i const*)(buf + i));
+			lanes = _mm_sub_epi8(lanes, _mm_cmpgt_epi8(v, lead_limit));
+			if(utf16){
+				__m128i is_long = _mm_cmpeq_epi8(_mm_max_epu8(v, long_lead), v);
+				lanes = _mm_sub_epi8(lanes, is_long);
+			}
+		}
+		__m128i sums = _mm_sad_epu8(lanes, zero);
+		count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+	}
+#endif
+	for(; i < n; i += 1){
+		count += !utf8_is_continuation_byte(buf[i]);
+		count += utf16 && buf[i] >= 0xf0;
+	}
+	return count;
+}
+
+isize utf8_rune_count(byte const* buf, isize n){
+	return utf8_count_units(buf, n, false);
+}
+
+isize utf8_utf16_length(byte const* buf, isize n){
+	return utf8_count_units(buf, n, true);
+}
+
+isize utf8_offset_from_utf16(byte const* buf, isize n, isize utf16_offset){
+	isize i = 0;
+	isize units = 0;
+	while(i < n && units < utf16_offset){
+#if defined(UTF8_SSE2)
+		if(i + 16 <= n && units + 16 <= utf16_offset &&
+		   _mm_movemask_epi8(_mm_loadu_si128((__m128i const*)(buf + i))) == 0){
+			i += 16;
+			units += 16;
+			continue;
+		}
+#endif
+		UTF8Decoded dec = utf8_decode(buf + i, n - i);
+		i += dec.len;
+		units += (dec.codepoint > UTF8_RANGE3) ? 2 : 1;
+	}
+	return i;
+}
+
+isize utf8_to_utf16(byte const* buf, isize n, u16* out){
+	isize i = 0;
+	isize w = 0;
+	while(i < n){
+#if defined(UTF8_SSE2)
+		if(i + 16 <= n){
+			__m128i v = _mm_loadu_si128((__m128i const*)(buf + i));
+			if(_mm_movemask_epi8(v) == 0){
+				__m128i zero = _mm_setzero_si128();
+				_mm_storeu_si128((__m128i*)(out + w), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(out + w + 8), _mm_unpackhi_epi8(v, zero));
+				i += 16;
+				w += 16;
+				continue;
+			}
+		}
+#endif
+		if(buf[i] < 0x80){
+			out[w] = buf[i];
+			i += 1;
+			w += 1;
+			continue;
+		}
+
+		UTF8Decoded dec = utf8_decode(buf + i, n - i);
+		i += dec.len;
+		if(dec.codepoint > UTF8_RANGE3){
+			rune c = dec.codepoint - 0x10000;
+			out[w]     = (u16)(UTF16_SURROGATE1 | (c >> 10));
+			out[w + 1] = (u16)(0xdc00 | (c & 0x3ff));
+			w += 2;
+		} else {
+			out[w] = (u16)dec.codepoint;
+			w += 1;
+		}
+	}
+	return w;
+}
+
+isize utf8_to_utf32(byte const* buf, isize n, rune* out){
+	isize i = 0;
+	isize w = 0;
+	while(i < n){
+#if defined(UTF8_SSE2)
+		if(i + 16 <= n){
+			__m128i v = _mm_loadu_si128((__m128i const*)(buf + i));
+			if(_mm_movemask_epi8(v) == 0){
+				__m128i zero = _mm_setzero_si128();
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				_mm_storeu_si128((__m128i*)(out + w),      _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128((__m128i*)(out + w + 4),  _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128((__m128i*)(out + w + 8),  _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128((__m128i*)(out + w + 12), _mm_unpackhi_epi16(hi, zero));
+				i += 16;
+				w += 16;
+				continue;
+			}
+		}
+#endif
+		UTF8Decoded dec = utf8_decode(buf + i, n - i);
+		out[w] = dec.codepoint;
+		i += dec.len;
+		w += 1;
+	}
+	return w;
+}
+
+isize utf16_to_utf8(u16 const* buf, isize n, byte* out){
+	isize i = 0;
+	isize w = 0;
+	while(i < n){
+#if defined(UTF8_SSE2)
+		if(i + 8 <= n){
+			__m128i v = _mm_loadu_si128((__m128i const*)(buf + i));
+			__m128i high = _mm_and_si128(v, _mm_set1_epi16((short)0xff80));
+			if(_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xffff){
+				_mm_storel_epi64((__m128i*)(out + w), _mm_packus_epi16(v, v));
+				i += 8;
+				w += 8;
+				continue;
+			}
+		}
+#endif
+		rune c = buf[i];
+		i += 1;
+		if(c >= UTF16_SURROGATE1 && c <= UTF16_SURROGATE2){
+			/* Needs a high surrogate followed by a low one */
+			if(c <= 0xdbff && i < n && buf[i] >= 0xdc00 && buf[i] <= UTF16_SURROGATE2){
+				c = 0x10000 + ((c - UTF16_SURROGATE1) << 10) + (buf[i] - 0xdc00);
+				i += 1;
+			} else {
+				c = UTF8_ERROR;
+			}
+		}
+
+		UTF8Encoded enc = utf8_encode(c);
+		if(c == UTF8_ERROR){
+			enc.len = 3; /* UTF8_ERROR_ENCODED has len 0 */
+		}
+		mem_copy_no_overlap(out + w, enc.bytes, enc.len);
+		w += enc.len;
+	}
+	return w;
+}
+
+//// Identifiers
+#include "unicode_tables.h"
+
+bool rune_is_xid_start(rune c){
+	if(c < 0x80){
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+	if(c >= XID_TABLE_LIMIT){
+		return false;
+	}
+	u8 const* block = xid_stage2[xid_stage1[c >> XID_TABLE_SHIFT]];
+	u32 bit = (u32)c & 127;
+	return (block[bit >> 3] >> (bit & 7)) & 1;
+}
+
+bool rune_is_xid_continue(rune c){
+	if(c < 0x80){
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c == '_');
+	}
+	if(c >= XID_TABLE_LIMIT){
+		return c >= 0xe0100 && c <= 0xe01ef;
+	}
+	u8 const* block = xid_stage2[xid_stage1[c >> XID_TABLE_SHIFT]];
+	u32 bit = (u32)c & 127;
+	return (block[16 + (bit >> 3)] >> (bit & 7)) & 1;
+}
+
 #undef UTF8_RANGE1
 #undef UTF8_RANGE2
 #undef UTF8_RANGE3
@@ -129,4 +534,19 @@ UTF8Decoded utf8_decode(byte const* buf, isize len){
 #undef UTF8_SIZE3
 #undef UTF8_SIZE4
 #undef CONT
-
+#undef UTF8_SSE2
+#undef UTF8_SSSE3
+#undef UTF8_SSSE3_DISPATCH
+#undef UTF8_SSSE3_TARGET
+#undef UTF8_TOO_SHORT
+#undef UTF8_TOO_LONG
+#undef UTF8_OVERLONG_3
+#undef UTF8_TOO_LARGE
+#undef UTF8_SURROGATE
+#undef UTF8_OVERLONG_2
+#undef UTF8_TOO_LARGE_1000
+#undef UTF8_OVERLONG_4
+#undef UTF8_TWO_CONTS
+#undef UTF8_CARRY
+#undef XID_TABLE_SHIFT
+#undef XID_TABLE_LIMIT
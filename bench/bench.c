@@ -0,0 +1,38 @@
+#include "../base/base.c"
+#include "../cx.c"
+
+#include "bench.h"
+#include "hash_map.c"
+#include "mapped_arena.c"
+#include "shared_arena.c"
+#include "format.c"
+#include "string.c"
+#include "pipeline.c"
+
+typedef struct {
+	char const* name;
+	void (*run)();
+} BenchGroup;
+
+static BenchGroup const bench_groups[] = {
+	{ "hash_map", bench_hash_map },
+	{ "mapped_arena", bench_mapped_arena },
+	{ "shared_arena", bench_shared_arena },
+	{ "format", bench_format },
+	{ "string", bench_string },
+	{ "pipeline", bench_pipeline },
+};
+
+/* `bench.exe [group...]` runs the named groups, or all of them */
+int main(int argc, char** argv){
+	for(isize i = 0; i < (isize)(sizeof(bench_groups) / sizeof(bench_groups[0])); i += 1){
+		bool selected = argc <= 1;
+		for(int a = 1; a < argc; a += 1){
+			selected = selected || strcmp(argv[a], bench_groups[i].name) == 0;
+		}
+		if(selected){
+			bench_groups[i].run();
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+
+#if defined(OS_LINUX)
+#include <time.h>
+#elif defined(OS_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/* Seconds on a monotonic clock */
+static inline
+f64 bench_now(){
+#if defined(OS_LINUX)
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+#elif defined(OS_WINDOWS)
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (f64)now.QuadPart / (f64)freq.QuadPart;
+#endif
+}
+
+/* Results are folded in here so the work can't be optimized out */
+static volatile u64 bench_sink;
+
+static inline
+void bench_report(char const* group, char const* name, f64 seconds, isize ops){
+	printf("%-14s %-44s %10.2f ns/op %10.3f ms\n", group, name, (seconds * 1e9) / (f64)max(ops, (isize)1), seconds * 1e3);
+}
+
+static inline
+u64 bench_rand(u64* state){
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
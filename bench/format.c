@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#define BENCH_FORMAT_COUNT (1 << 21)
+
+/* The dedicated formatters against libc and stb_sprintf on the same values */
+static
+void bench_format(){
+	i64* ints = heap_alloc(BENCH_FORMAT_COUNT * sizeof(i64), alignof(i64));
+	f64* reals = heap_alloc(BENCH_FORMAT_COUNT * sizeof(f64), alignof(f64));
+	u64 seed = 11;
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		u64 r = bench_rand(&seed);
+		ints[i] = (i64)(r >> (r & 63)) * ((r & 64) ? -1 : 1); /* Every length */
+		f64 f;
+		do {
+			u64 bits = bench_rand(&seed);
+			mem_copy_no_overlap(&f, &bits, sizeof(f));
+		} while(f != f || f - f != 0); /* Finite only */
+		reals[i] = f;
+	}
+
+	byte buf[64];
+	u64 sum = 0;
+
+	f64 t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += fmt_i64(buf, ints[i]) + buf[0];
+	}
+	bench_report("format", "fmt_i64", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += stbsp_snprintf((char*)buf, sizeof(buf), "%lld", (long long)ints[i]) + buf[0];
+	}
+	bench_report("format", "stbsp_snprintf %lld", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += snprintf((char*)buf, sizeof(buf), "%lld", (long long)ints[i]) + buf[0];
+	}
+	bench_report("format", "libc snprintf %lld", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += fmt_f64(buf, reals[i]) + buf[0];
+	}
+	bench_report("format", "fmt_f64 (shortest)", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += stbsp_snprintf((char*)buf, sizeof(buf), "%g", reals[i]) + buf[0];
+	}
+	bench_report("format", "stbsp_snprintf %g (lossy)", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	/* What round-tripping costs without a shortest formatter */
+	t = bench_now();
+	for(isize i = 0; i < BENCH_FORMAT_COUNT; i += 1){
+		sum += snprintf((char*)buf, sizeof(buf), "%.17g", reals[i]) + buf[0];
+	}
+	bench_report("format", "libc snprintf %.17g", bench_now() - t, BENCH_FORMAT_COUNT);
+
+	bench_sink += sum;
+	heap_free(reals);
+	heap_free(ints);
+}
+
+#undef BENCH_FORMAT_COUNT
@@ -0,0 +1,218 @@
+#include "bench.h"
+
+#define BENCH_MAP_OPS (1 << 20) /* Lookups per case, small maps repeat their keys */
+
+/* Baseline the map is meant to beat: separate chaining, one heap node per key */
+typedef struct BenchChainNode BenchChainNode;
+
+struct BenchChainNode {
+	BenchChainNode* next;
+	u64 hash;
+	String key;
+	u32 value;
+};
+
+typedef struct {
+	BenchChainNode** buckets;
+	isize cap;
+	isize len;
+} BenchChainMap;
+
+static
+void bench_chain_insert(BenchChainMap* m, String key, u32 value){
+	if(m->len >= m->cap){
+		isize new_cap = max(m->cap * 2, (isize)16);
+		BenchChainNode** buckets = heap_alloc(new_cap * sizeof(BenchChainNode*), alignof(BenchChainNode*));
+		mem_set(buckets, 0, new_cap * sizeof(BenchChainNode*));
+		for(isize i = 0; i < m->cap; i += 1){
+			for(BenchChainNode* n = m->buckets[i]; n != NULL;){
+				BenchChainNode* next = n->next;
+				isize idx = (isize)(n->hash & (u64)(new_cap - 1));
+				n->next = buckets[idx];
+				buckets[idx] = n;
+				n = next;
+			}
+		}
+		heap_free(m->buckets);
+		m->buckets = buckets;
+		m->cap = new_cap;
+	}
+
+	u64 hash = hash_string(key);
+	BenchChainNode* n = heap_alloc(sizeof(BenchChainNode), alignof(BenchChainNode));
+	*n = (BenchChainNode){ .hash = hash, .key = key, .value = value };
+	isize idx = (isize)(hash & (u64)(m->cap - 1));
+	n->next = m->buckets[idx];
+	m->buckets[idx] = n;
+	m->len += 1;
+}
+
+static
+u32* bench_chain_get(BenchChainMap* m, String key){
+	u64 hash = hash_string(key);
+	for(BenchChainNode* n = m->buckets[hash & (u64)(m->cap - 1)]; n != NULL; n = n->next){
+		if(n->hash == hash && str_equals(n->key, key)){
+			return &n->value;
+		}
+	}
+	return NULL;
+}
+
+static
+void bench_chain_destroy(BenchChainMap* m){
+	for(isize i = 0; i < m->cap; i += 1){
+		for(BenchChainNode* n = m->buckets[i]; n != NULL;){
+			BenchChainNode* next = n->next;
+			heap_free(n);
+			n = next;
+		}
+	}
+	heap_free(m->buckets);
+}
+
+/* Identifier-like keys, `miss` ones never collide with the others */
+static
+String* bench_map_keys(Arena* arena, isize count, char prefix){
+	String* keys = arena_make(arena, String, count);
+	u64 seed = 0x9e3779b97f4a7c15ull ^ (u64)prefix;
+	for(isize i = 0; i < count; i += 1){
+		keys[i] = str_format(arena, "%c%llx_%td", prefix, (unsigned long long)(bench_rand(&seed) & 0xffffff), i);
+	}
+	return keys;
+}
+
+static
+char const* bench_map_name(char* buf, char const* name, isize n){
+	snprintf(buf, 64, "%s, %td keys", name, n);
+	return buf;
+}
+
+static
+void bench_hash_map_size(isize n){
+	Arena arena = arena_create_mapped(256 * mem_megabyte, MemPages_Default, NULL);
+	isize ops = BENCH_MAP_OPS;
+	isize rounds = max(ops / n, (isize)1); /* Small maps are built again and again */
+	char name[64];
+	String* keys = bench_map_keys(&arena, n, 'h');
+	String* misses = bench_map_keys(&arena, n, 'm');
+	u64 sum = 0;
+
+	/* Lookups go in random order, otherwise the chained map walks its nodes
+	 * in allocation order and gets a free prefetch */
+	String* lookups = arena_make(&arena, String, n);
+	mem_copy(lookups, keys, n * sizeof(String));
+	u64 seed = 7;
+	for(isize i = n - 1; i > 0; i -= 1){
+		isize j = (isize)(bench_rand(&seed) % (u64)(i + 1));
+		String tmp = lookups[i];
+		lookups[i] = lookups[j];
+		lookups[j] = tmp;
+	}
+
+	/* String keys */
+	{
+		HashMap m = hash_map_make(heap_allocator(), String, u32);
+		f64 t = bench_now();
+		for(isize r = 0; r < rounds; r += 1){
+			hash_map_destroy(&m);
+			for(isize i = 0; i < n; i += 1){
+				u32 v = (u32)i;
+				hash_map_insert(&m, &keys[i], &v);
+			}
+		}
+		bench_report("hash_map", bench_map_name(name, "String insert with growth", n), bench_now() - t, rounds * n);
+
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			sum += *(u32*)hash_map_get(&m, &lookups[i % n]);
+		}
+		bench_report("hash_map", bench_map_name(name, "String hit", n), bench_now() - t, ops);
+
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			sum += hash_map_get(&m, &misses[i % n]) != NULL;
+		}
+		bench_report("hash_map", bench_map_name(name, "String miss", n), bench_now() - t, ops);
+		hash_map_destroy(&m);
+	}
+
+	{
+		BenchChainMap m = {0};
+		f64 t = bench_now();
+		for(isize r = 0; r < rounds; r += 1){
+			bench_chain_destroy(&m);
+			m = (BenchChainMap){0};
+			for(isize i = 0; i < n; i += 1){
+				bench_chain_insert(&m, keys[i], (u32)i);
+			}
+		}
+		bench_report("hash_map", bench_map_name(name, "chained String insert with growth", n), bench_now() - t, rounds * n);
+
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			sum += *bench_chain_get(&m, lookups[i % n]);
+		}
+		bench_report("hash_map", bench_map_name(name, "chained String hit", n), bench_now() - t, ops);
+
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			sum += bench_chain_get(&m, misses[i % n]) != NULL;
+		}
+		bench_report("hash_map", bench_map_name(name, "chained String miss", n), bench_now() - t, ops);
+		bench_chain_destroy(&m);
+	}
+
+	/* Atom keys, dense u32 like the interner hands out */
+	{
+		HashMap m = hash_map_make(heap_allocator(), u32, u32);
+		f64 t = bench_now();
+		for(isize r = 0; r < rounds; r += 1){
+			hash_map_destroy(&m);
+			for(u32 i = 0; i < (u32)n; i += 1){
+				hash_map_insert(&m, &i, &i);
+			}
+		}
+		bench_report("hash_map", bench_map_name(name, "u32 insert with growth", n), bench_now() - t, rounds * n);
+
+		seed = 42;
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			u32 key = (u32)(bench_rand(&seed) % (u64)n);
+			sum += *(u32*)hash_map_get(&m, &key);
+		}
+		bench_report("hash_map", bench_map_name(name, "u32 hit", n), bench_now() - t, ops);
+
+		t = bench_now();
+		for(isize i = 0; i < ops; i += 1){
+			u32 key = (u32)(n + i % n);
+			sum += hash_map_get(&m, &key) != NULL;
+		}
+		bench_report("hash_map", bench_map_name(name, "u32 miss", n), bench_now() - t, ops);
+
+		HashMap reserved = hash_map_make(heap_allocator(), u32, u32);
+		t = bench_now();
+		for(isize r = 0; r < rounds; r += 1){
+			hash_map_destroy(&reserved);
+			hash_map_reserve(&reserved, n);
+			for(u32 i = 0; i < (u32)n; i += 1){
+				hash_map_insert(&reserved, &i, &i);
+			}
+		}
+		bench_report("hash_map", bench_map_name(name, "u32 insert, reserved", n), bench_now() - t, rounds * n);
+
+		hash_map_destroy(&reserved);
+		hash_map_destroy(&m);
+	}
+
+	bench_sink += sum;
+	arena_destroy_mapped(&arena);
+}
+
+/* One size that stays in cache and one that doesn't */
+static
+void bench_hash_map(){
+	bench_hash_map_size(1 << 12);
+	bench_hash_map_size(1 << 20);
+}
+
+#undef BENCH_MAP_OPS
@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#define BENCH_TOKEN_SOURCE_SIZE (48 * mem_megabyte)
+
+static
+char const* bench_page_policy_name(MemPagePolicy p){
+	switch(p){
+	case MemPages_Default:     return "default";
+	case MemPages_Transparent: return "transparent";
+	case MemPages_Huge:        return "huge";
+	}
+	return "?";
+}
+
+/* Lex the same source into an arena with each page policy, then walk the
+ * tokens in order and in a random order that misses the TLB on small pages */
+static
+void bench_mapped_arena(){
+	byte* source_buf = heap_alloc(BENCH_TOKEN_SOURCE_SIZE, 64);
+	isize source_len = 0;
+	u64 seed = 3;
+	while(source_len < BENCH_TOKEN_SOURCE_SIZE - 64){
+		source_len += snprintf((char*)source_buf + source_len, 64, "let v%u = a + %u * (b << 2);\n", (unsigned)(bench_rand(&seed) & 0xffff), (unsigned)(bench_rand(&seed) & 0xff));
+	}
+	String source = { .v = source_buf, .len = source_len };
+
+	MemPagePolicy policies[] = { MemPages_Default, MemPages_Transparent, MemPages_Huge };
+	char name[64];
+	for(isize p = 0; p < (isize)(sizeof(policies) / sizeof(policies[0])); p += 1){
+		MemPagePolicy applied = MemPages_Default;
+		isize token_size = (2 * (source.len + 1) + 8) * (isize)sizeof(Token);
+		Arena tokens_arena = arena_create_mapped(token_size, policies[p], &applied);
+		Arena error_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+
+		f64 t = bench_now();
+		Lexer lex = lexer_create(source, &error_arena);
+		LexerResult lexed = lexer_tokenize(&lex, arena_allocator(&tokens_arena));
+		isize count = lexed.tokens.len;
+		snprintf(name, sizeof(name), "lex, %s pages (got %s)", bench_page_policy_name(policies[p]), bench_page_policy_name(applied));
+		bench_report("mapped_arena", name, bench_now() - t, count);
+
+		u64 sum = 0;
+		t = bench_now();
+		for(isize i = 0; i < count; i += 1){
+			sum += lexed.tokens.v[i].type;
+		}
+		snprintf(name, sizeof(name), "sequential walk, %s pages (got %s)", bench_page_policy_name(policies[p]), bench_page_policy_name(applied));
+		bench_report("mapped_arena", name, bench_now() - t, count);
+
+		/* Stride by a large odd number, every token is visited once */
+		isize stride = 1000003;
+		isize idx = 0;
+		t = bench_now();
+		for(isize i = 0; i < count; i += 1){
+			sum += lexed.tokens.v[idx].type;
+			idx += stride;
+			if(idx >= count){ idx -= count; }
+		}
+		snprintf(name, sizeof(name), "scattered walk, %s pages (got %s)", bench_page_policy_name(policies[p]), bench_page_policy_name(applied));
+		bench_report("mapped_arena", name, bench_now() - t, count);
+
+		bench_sink += sum;
+		arena_destroy_mapped(&error_arena);
+		arena_destroy_mapped(&tokens_arena);
+	}
+
+	heap_free(source_buf);
+}
+
+#undef BENCH_TOKEN_SOURCE_SIZE
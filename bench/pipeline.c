@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#define BENCH_PIPELINE_FNS 60000
+
+/* Lexing then parsing against streaming tokens from a lexer thread. The
+ * streamed run can at best take as long as the slower of the two stages, and
+ * needs a second core to get there. */
+static
+void bench_pipeline(){
+	StrBuilder sb = str_builder_create(heap_allocator(), 1024 * 1024);
+	u64 seed = 5;
+	for(isize i = 0; i < BENCH_PIPELINE_FNS; i += 1){
+		u32 r = (u32)bench_rand(&seed);
+		str_builder_format(&sb, "fn f%td(a: i32, b: [4]i32) i32 { let x = a * %u + b[%u] << 2; if x > %u { return f%u(x - 1, b); } return -x; }\n",
+			i, r & 0xff, r % 4, (r >> 8) & 0xfff, (r >> 20) % BENCH_PIPELINE_FNS);
+	}
+	String source = str_builder_build(&sb);
+	Arena lex_arena = arena_create_mapped(64 * mem_megabyte, MemPages_Default, NULL);
+	Arena parser_arena = arena_create_mapped(64 * mem_megabyte, MemPages_Default, NULL);
+
+	/* Separately, then back to back */
+	f64 t = bench_now();
+	Lexer lex = lexer_create(source, &lex_arena);
+	LexerResult lexed = lexer_tokenize(&lex, heap_allocator());
+	f64 lex_time = bench_now() - t;
+	isize count = lexed.tokens.len;
+	bench_report("pipeline", "lex (ns/token)", lex_time, count);
+
+	Ast ast = ast_create(heap_allocator(), count / 2);
+	t = bench_now();
+	Parser p = parser_create(source, lexed.tokens, &ast, &parser_arena);
+	parser_parse_file(&p);
+	f64 parse_time = bench_now() - t;
+	parser_destroy(&p);
+	bench_report("pipeline", "parse (ns/token)", parse_time, count);
+	bench_report("pipeline", "lex then parse (ns/token)", lex_time + parse_time, count);
+	bench_report("pipeline", "max(lex, parse) (ns/token)", max(lex_time, parse_time), count);
+	ast_destroy(&ast);
+
+	arena_reset(&lex_arena);
+	arena_reset(&parser_arena);
+	TokenArray tokens = dyn_array_create(heap_allocator());
+	ast = ast_create(heap_allocator(), count / 2);
+	t = bench_now();
+	lex = lexer_create(source, &lex_arena);
+	TokenArray none = {0};
+	p = parser_create(source, none, &ast, &parser_arena);
+	parser_parse_file_streaming(&p, &lex, &tokens);
+	f64 stream_time = bench_now() - t;
+	parser_destroy(&p);
+	bench_report("pipeline", "streamed (ns/token)", stream_time, count);
+	bench_sink += (u64)ast.len + (u64)tokens.len;
+
+	ast_destroy(&ast);
+	dyn_array_destroy(&tokens);
+	dyn_array_destroy(&lexed.tokens);
+	arena_destroy_mapped(&parser_arena);
+	arena_destroy_mapped(&lex_arena);
+	str_builder_destroy(&sb);
+}
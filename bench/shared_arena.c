@@ -0,0 +1,80 @@
+#include "bench.h"
+
+#define BENCH_SHARED_ALLOCS (1 << 20) /* Per thread */
+
+typedef struct {
+	SharedArena* shared;
+	Arena* locked;
+	atomic_int* lock;
+	_Atomic(u64) sink; /* Workers add here, bench_sink is only touched by the main thread */
+} BenchSharedArenaJob;
+
+static
+void bench_shared_arena_worker(void* arg){
+	BenchSharedArenaJob* job = arg;
+	u64 sum = 0;
+	for(isize i = 0; i < BENCH_SHARED_ALLOCS; i += 1){
+		byte* p = shared_arena_alloc(job->shared, 24, 8);
+		sum += (uintptr)p;
+	}
+	atomic_fetch_add_explicit(&job->sink, sum, memory_order_relaxed);
+}
+
+/* Baseline: one arena behind a spinlock */
+static
+void bench_locked_arena_worker(void* arg){
+	BenchSharedArenaJob* job = arg;
+	u64 sum = 0;
+	for(isize i = 0; i < BENCH_SHARED_ALLOCS; i += 1){
+		while(atomic_exchange_explicit(job->lock, 1, memory_order_acquire)){
+			while(atomic_load_explicit(job->lock, memory_order_relaxed)){}
+		}
+		byte* p = arena_alloc(job->locked, 24, 8);
+		atomic_store_explicit(job->lock, 0, memory_order_release);
+		sum += (uintptr)p;
+	}
+	atomic_fetch_add_explicit(&job->sink, sum, memory_order_relaxed);
+}
+
+static
+f64 bench_shared_arena_run(ThreadFunc func, BenchSharedArenaJob* job, i32 thread_count){
+	Thread threads[16];
+	f64 t = bench_now();
+	for(i32 i = 1; i < thread_count; i += 1){
+		ensure(thread_create(&threads[i], func, job), "Failed to start thread");
+	}
+	func(job);
+	for(i32 i = 1; i < thread_count; i += 1){
+		thread_join(&threads[i]);
+	}
+	t = bench_now() - t;
+	bench_sink += atomic_load_explicit(&job->sink, memory_order_relaxed);
+	return t;
+}
+
+static
+void bench_shared_arena(){
+	isize capacity = 16 * (isize)BENCH_SHARED_ALLOCS * 32 + 64 * mem_megabyte;
+	Arena backing = arena_create_mapped(capacity, MemPages_Default, NULL);
+	mem_set(backing.data, 0, capacity); /* Fault the pages in up front, both sides reuse them */
+	char name[64];
+
+	for(i32 threads = 1; threads <= 16; threads *= 2){
+		SharedArena shared = shared_arena_create(backing.data, backing.capacity, 64 * mem_kilobyte);
+		BenchSharedArenaJob job = { .shared = &shared };
+		f64 t = bench_shared_arena_run(bench_shared_arena_worker, &job, threads);
+		snprintf(name, sizeof(name), "shared, %d threads", threads);
+		bench_report("shared_arena", name, t, threads * (isize)BENCH_SHARED_ALLOCS);
+
+		Arena locked = arena_create_buffer(backing.data, backing.capacity);
+		atomic_int lock = 0;
+		job = (BenchSharedArenaJob){ .locked = &locked, .lock = &lock };
+		t = bench_shared_arena_run(bench_locked_arena_worker, &job, threads);
+		snprintf(name, sizeof(name), "spinlocked arena, %d threads", threads);
+		bench_report("shared_arena", name, t, threads * (isize)BENCH_SHARED_ALLOCS);
+	}
+
+	arena_destroy_mapped(&backing);
+}
+
+#undef BENCH_SHARED_ALLOCS
@@ -0,0 +1,104 @@
+#include "bench.h"
+#include <strings.h>
+
+#define BENCH_STRING_SIZE (64 * mem_megabyte)
+#define BENCH_STRING_ROUNDS 4
+
+/* Source-like text, the needles only appear at the very end */
+static
+void bench_string(){
+	byte* buf = heap_alloc(BENCH_STRING_SIZE, 64);
+	byte* copy = heap_alloc(BENCH_STRING_SIZE, 64);
+	u64 seed = 5;
+	for(isize i = 0; i < BENCH_STRING_SIZE; i += 1){
+		u64 r = bench_rand(&seed) % 40;
+		buf[i] = r < 6 ? ' ' : (r == 6 ? '\n' : (byte)('a' + r % 26));
+	}
+	String needle = str_lit("fn needle_in_a_haystack()");
+	mem_copy(buf + BENCH_STRING_SIZE - needle.len - 1, needle.v, needle.len);
+	buf[BENCH_STRING_SIZE - 1] = '@';
+	mem_copy(copy, buf, BENCH_STRING_SIZE);
+	copy[BENCH_STRING_SIZE - 1] = '#';
+
+	String s = { .v = buf, .len = BENCH_STRING_SIZE };
+	String other = { .v = copy, .len = BENCH_STRING_SIZE };
+	isize bytes = BENCH_STRING_SIZE * BENCH_STRING_ROUNDS;
+	u64 sum = 0;
+
+	/* ns/op below is per KiB scanned */
+	isize kib = bytes / 1024;
+
+	f64 t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += str_find(s, needle);
+	}
+	bench_report("string", "str_find (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += (uintptr)memmem(buf, BENCH_STRING_SIZE, needle.v, needle.len);
+	}
+	bench_report("string", "libc memmem (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += str_find_byte(s, '@');
+	}
+	bench_report("string", "str_find_byte (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += (uintptr)memchr(buf, '@', BENCH_STRING_SIZE);
+	}
+	bench_report("string", "libc memchr (ns/KiB)", bench_now() - t, kib);
+
+	ByteSet set = byte_set_make(str_lit("@#$"));
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += str_find_any(s, &set);
+	}
+	bench_report("string", "str_find_any (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += strcspn((char const*)buf, "@#$");
+	}
+	bench_report("string", "libc strcspn (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += str_count_byte(s, '\n');
+	}
+	bench_report("string", "str_count_byte (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += (u64)str_compare(s, other);
+	}
+	bench_report("string", "str_compare (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += (u64)memcmp(buf, copy, BENCH_STRING_SIZE);
+	}
+	bench_report("string", "libc memcmp (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += str_equals_ignore_case(s, other);
+	}
+	bench_report("string", "str_equals_ignore_case (ns/KiB)", bench_now() - t, kib);
+
+	t = bench_now();
+	for(isize r = 0; r < BENCH_STRING_ROUNDS; r += 1){
+		sum += strncasecmp((char const*)buf, (char const*)copy, BENCH_STRING_SIZE);
+	}
+	bench_report("string", "libc strncasecmp (ns/KiB)", bench_now() - t, kib);
+
+	bench_sink += sum;
+	heap_free(copy);
+	heap_free(buf);
+}
+
+#undef BENCH_STRING_SIZE
+#undef BENCH_STRING_ROUNDS
@@ -1,10 +1,23 @@
 #!/usr/bin/env sh
 
-cc=clang
+cc=${CC:-clang}
 cflags='-std=c17 -Os -fno-strict-aliasing -fwrapv'
 wflags='-Wall -Wextra -Werror -Wno-error=unused-variable'
 
 set -xeu
 
-$cc $cflags $wflags -o cx.exe main.c base/base.c cx.c
+case "${1:-}" in
+	test)
+		$cc $cflags $wflags -o test.exe tests/tests.c
+		./test.exe
+	;;
+	bench)
+		shift
+		$cc $cflags -O2 $wflags -o bench.exe bench/bench.c
+		./bench.exe "$@"
+	;;
+	*)
+		$cc $cflags $wflags -o cx.exe main.c base/base.c cx.c
+	;;
+esac
 
@@ -0,0 +1,422 @@
+#include "cx.h"
+
+#include <stdlib.h>
+
+#define SEMA_SCRATCH_SIZE (64 * mem_megabyte)
+#define SEMA_ERRORS_SIZE  (16 * mem_megabyte)
+
+/* Everything a thread needs to check a function on its own. Aligned so two
+ * workers never share a cache line. */
+typedef struct {
+	alignas(64) Arena scratch;
+	Arena errors;
+	Resolver resolver;
+	Infer infer;
+} SemaWorker;
+
+/* Errors one function left in its worker's arrays */
+typedef struct {
+	u32 worker;
+	u32 resolve_lo, resolve_hi;
+	u32 infer_lo, infer_hi;
+} SemaSlice;
+
+typedef struct {
+	Sema* sema;
+	SemaWorker* workers;
+	NodeIndex const* fns;
+	SemaSlice* slices; /* slices[i] belongs to fns[i] */
+} SemaJob;
+
+//// Constant folding
+static inline
+bool sema_is_integral(TypeId t){
+	return t >= Type_I8 && t <= Type_U64;
+}
+
+static inline
+bool sema_is_unsigned(TypeId t){
+	return t >= Type_U8 && t <= Type_U64;
+}
+
+static inline
+i32 sema_bit_width(TypeId t){
+	switch(t){
+	case Type_I8:  case Type_U8:  return 8;
+	case Type_I16: case Type_U16: return 16;
+	case Type_I32: case Type_U32: return 32;
+	default: return 64;
+	}
+}
+
+static inline
+ConstValue sema_const(TypeId t, i64 v){
+	switch(t){
+	case Type_Bool: v = v != 0; break;
+	case Type_I8:   v = (i8)v;  break;
+	case Type_I16:  v = (i16)v; break;
+	case Type_I32:  v = (i32)v; break;
+	case Type_U8:   v = (u8)v;  break;
+	case Type_U16:  v = (u16)v; break;
+	case Type_U32:  v = (u32)v; break;
+	default: break;
+	}
+	return (ConstValue){ .known = true, .value = v };
+}
+
+/* Largest value an integer literal of type t can have. A negated signed
+ * literal can go one further, down to the minimum. */
+static inline
+u64 sema_literal_max(TypeId t, bool negated){
+	i32 width = sema_bit_width(t);
+	if(sema_is_unsigned(t)){
+		return width == 64 ? UINT64_MAX : (1ull << width) - 1;
+	}
+	return (1ull << (width - 1)) - 1 + negated;
+}
+
+/* Literals are folded by value, one that doesn't fit its type is an error
+ * rather than being wrapped */
+static
+ConstValue sema_fold_literal(Sema* s, Infer* in, NodeIndex node, TypeId t){
+	Ast const* ast = s->ast;
+	i64 value = s->tokens[ast->main_token[node]].value_integer;
+
+	/* Operands come right before their parent, so a negated literal is
+	 * followed by the minus */
+	NodeIndex next = node + 1;
+	bool negated = next < ast->len && ast->tag[next] == Node_Unary && ast->data[next].lhs == node &&
+		s->tokens[ast->main_token[next]].type == Tk_Minus;
+
+	if((u64)value > sema_literal_max(t, negated)){
+		StrBuilder sb = str_builder_create(heap_allocator(), 64);
+		type_format(s->types, t, &sb);
+		String name = str_builder_build(&sb);
+		infer_emit_error(in, node, CompilerError_InvalidConstant, "Integer literal %llu doesn't fit in '%.*s'", (unsigned long long)value, str_fmt(name));
+		str_builder_destroy(&sb);
+		return (ConstValue){0};
+	}
+	return sema_const(t, value);
+}
+
+/* Arithmetic is done on u64 so it wraps like the target type would */
+static
+ConstValue sema_fold_binary(Sema* s, Infer* in, NodeIndex node, TypeId t){
+	NodeData data = s->ast->data[node];
+	u32 op = s->tokens[s->ast->main_token[node]].type;
+	ConstValue l = s->consts[data.lhs];
+	ConstValue r = s->consts[data.rhs];
+
+	/* A known left side decides a short circuit on its own */
+	if((op == Tk_LogicAnd || op == Tk_LogicOr) && l.known){
+		bool decided = op == Tk_LogicAnd ? !l.value : l.value;
+		return decided ? l : r;
+	}
+	if(!l.known || !r.known){
+		return (ConstValue){0};
+	}
+
+	TypeId operand = s->node_types[data.lhs];
+	bool is_unsigned = sema_is_unsigned(operand);
+	u64 a = (u64)l.value;
+	u64 b = (u64)r.value;
+	i64 result = 0;
+
+	switch(op){
+	case Tk_Plus:  result = (i64)(a + b); break;
+	case Tk_Minus: result = (i64)(a - b); break;
+	case Tk_Star:  result = (i64)(a * b); break;
+	case Tk_And:   result = (i64)(a & b); break;
+	case Tk_Or:    result = (i64)(a | b); break;
+
+	case Tk_Slash:
+	case Tk_Modulo:
+		if(b == 0){
+			infer_emit_error(in, node, CompilerError_InvalidConstant, "Division by zero");
+			return (ConstValue){0};
+		}
+		if(is_unsigned){
+			result = (i64)(op == Tk_Slash ? a / b : a % b);
+		}
+		else if(r.value == -1){
+			/* Would trap on the minimum value */
+			result = op == Tk_Slash ? (i64)(0 - a) : 0;
+		}
+		else {
+			result = op == Tk_Slash ? l.value / r.value : l.value % r.value;
+		}
+	break;
+
+	case Tk_ShLeft:
+	case Tk_ShRight: {
+		i32 width = sema_bit_width(operand);
+		bool negative = !sema_is_unsigned(s->node_types[data.rhs]) && r.value < 0;
+		if(negative || b >= (u64)width){
+			infer_emit_error(in, node, CompilerError_InvalidConstant, "Shift amount %lld is out of range for a %d bit integer", (long long)r.value, width);
+			return (ConstValue){0};
+		}
+		if(op == Tk_ShLeft){
+			result = (i64)(a << b);
+		}
+		else {
+			result = is_unsigned ? (i64)(a >> b) : l.value >> b;
+		}
+	} break;
+
+	case Tk_LogicAnd: result = l.value && r.value; break;
+	case Tk_LogicOr:  result = l.value || r.value; break;
+	case Tk_Eq:       result = a == b; break;
+	case Tk_NotEq:    result = a != b; break;
+	case Tk_Gt:       result = is_unsigned ? a > b  : l.value > r.value;  break;
+	case Tk_Lt:       result = is_unsigned ? a < b  : l.value < r.value;  break;
+	case Tk_GtEq:     result = is_unsigned ? a >= b : l.value >= r.value; break;
+	case Tk_LtEq:     result = is_unsigned ? a <= b : l.value <= r.value; break;
+
+	default: return (ConstValue){0};
+	}
+	return sema_const(t, result);
+}
+
+/* Expression nodes come after their operands, so walking a range in index
+ * order sees every operand first */
+static
+void sema_fold(Sema* s, Infer* in, u32 lo, u32 hi){
+	Ast const* ast = s->ast;
+	for(NodeIndex node = lo; node <= hi; node += 1){
+		TypeId t = s->node_types[node];
+		if(t != Type_Bool && !sema_is_integral(t)){
+			continue;
+		}
+
+		NodeData data = ast->data[node];
+		Token const* token = &s->tokens[ast->main_token[node]];
+		ConstValue v = {0};
+
+		switch((NodeTag)ast->tag[node]){
+		case Node_Integer:
+			v = sema_fold_literal(s, in, node, t);
+		break;
+
+		case Node_Bool:
+			v = sema_const(t, token->type == Tk_True);
+		break;
+
+		case Node_Unary: {
+			ConstValue operand = s->consts[data.lhs];
+			if(!operand.known){ break; }
+			switch(token->type){
+			case Tk_Plus:  v = operand; break;
+			case Tk_Minus: v = sema_const(t, (i64)(0 - (u64)operand.value)); break;
+			case Tk_Tilde: v = sema_const(t, ~operand.value); break;
+			case Tk_Bang:  v = sema_const(t, !operand.value); break;
+			default: break;
+			}
+		} break;
+
+		case Node_Binary:
+			v = sema_fold_binary(s, in, node, t);
+		break;
+
+		default: break;
+		}
+		s->consts[node] = v;
+	}
+}
+
+//// Workers
+static
+void sema_worker_init(Sema* s, SemaWorker* w, NodeIndex file){
+	MemPagePolicy applied;
+	w->scratch = arena_create_mapped(SEMA_SCRATCH_SIZE, MemPages_Default, &applied);
+	w->errors = arena_create_mapped(SEMA_ERRORS_SIZE, MemPages_Default, &applied);
+	ensure(w->scratch.data != NULL && w->errors.data != NULL, "Failed to map worker arenas");
+
+	w->resolver = resolver_create(s->source, s->ast, s->tokens, s->interner, s->binding, &w->errors, &w->scratch);
+	w->infer = infer_create(s->source, s->ast, s->tokens, s->types, s->binding, s->node_types, &w->errors, &w->scratch);
+	resolver_declare_globals(&w->resolver, file);
+}
+
+static
+void sema_worker_destroy(SemaWorker* w){
+	resolver_destroy(&w->resolver);
+	infer_destroy(&w->infer);
+	arena_destroy_mapped(&w->errors);
+	arena_destroy_mapped(&w->scratch);
+}
+
+static
+void sema_check_fn(void* ctx, u32 worker, u32 index){
+	SemaJob* job = ctx;
+	Sema* s = job->sema;
+	SemaWorker* w = &job->workers[worker];
+	SemaSlice* slice = &job->slices[index];
+	NodeIndex fn = job->fns[index];
+
+	slice->worker = worker;
+	slice->resolve_lo = w->resolver.errors.len;
+	resolver_resolve_fn(&w->resolver, fn);
+	slice->resolve_hi = w->resolver.errors.len;
+
+	slice->infer_lo = w->infer.errors.len;
+	infer_fn(&w->infer, fn);
+	NodeIndex body = s->ast->data[fn].rhs;
+	if(body != NODE_NONE && s->ast->tag[body] == Node_Block){
+		sema_fold(s, &w->infer, w->infer.unit_lo, w->infer.unit_hi);
+	}
+	slice->infer_hi = w->infer.errors.len;
+}
+
+static
+void sema_merge(Sema* s, CompilerErrorArray const* errors, u32 lo, u32 hi){
+	for(u32 i = lo; i < hi; i += 1){
+		CompilerError e = errors->v[i];
+		e.message = str_format(s->arena, "%.*s", str_fmt(e.message));
+		dyn_array_push(&s->errors, e);
+	}
+}
+
+/* Merged errors are grouped by where they were found, sorting by offset puts
+ * them in source order. Ties keep the merge order. */
+typedef struct {
+	isize offset;
+	isize index;
+} SemaErrorKey;
+
+static
+int sema_error_order(void const* left, void const* right){
+	SemaErrorKey const* l = left;
+	SemaErrorKey const* r = right;
+	if(l->offset != r->offset){
+		return (l->offset > r->offset) - (l->offset < r->offset);
+	}
+	return (l->index > r->index) - (l->index < r->index);
+}
+
+static
+void sema_sort_errors(Sema* s){
+	isize count = s->errors.len;
+	if(count < 2){
+		return;
+	}
+	SemaErrorKey* keys = heap_alloc(count * sizeof(SemaErrorKey), alignof(SemaErrorKey));
+	CompilerError* sorted = heap_alloc(count * sizeof(CompilerError), alignof(CompilerError));
+	for(isize i = 0; i < count; i += 1){
+		keys[i] = (SemaErrorKey){ .offset = s->errors.v[i].offset, .index = i };
+	}
+	qsort(keys, count, sizeof(SemaErrorKey), sema_error_order);
+	for(isize i = 0; i < count; i += 1){
+		sorted[i] = s->errors.v[keys[i].index];
+	}
+	mem_copy_no_overlap(s->errors.v, sorted, count * sizeof(CompilerError));
+	heap_free(sorted);
+	heap_free(keys);
+}
+
+//// Semantic analysis
+Sema sema_create(String source, Ast const* ast, Token const* tokens, Interner* interner, TypeTable* types, Arena* arena, u32 worker_count){
+	u32 count = ast->len;
+	NodeIndex* binding = heap_alloc(count * sizeof(NodeIndex), alignof(NodeIndex));
+	TypeId* node_types = heap_alloc(count * sizeof(TypeId), alignof(TypeId));
+	ConstValue* consts = heap_alloc(count * sizeof(ConstValue), alignof(ConstValue));
+	mem_set(binding, 0, count * sizeof(NodeIndex));
+	mem_set(node_types, 0, count * sizeof(TypeId));
+	mem_set(consts, 0, count * sizeof(ConstValue));
+
+	return (Sema){
+		.source = source,
+		.ast = ast,
+		.tokens = tokens,
+		.interner = interner,
+		.types = types,
+		.binding = binding,
+		.node_types = node_types,
+		.consts = consts,
+		.node_count = count,
+		.errors = dyn_array_create(arena_allocator(arena)),
+		.arena = arena,
+		.worker_count = worker_count,
+	};
+}
+
+void sema_destroy(Sema* s){
+	heap_free(s->binding);
+	heap_free(s->node_types);
+	heap_free(s->consts);
+	s->binding = NULL;
+	s->node_types = NULL;
+	s->consts = NULL;
+	s->node_count = 0;
+}
+
+void sema_check_file(Sema* s, NodeIndex file){
+	Ast const* ast = s->ast;
+	ensure(ast->len <= s->node_count, "AST grew after sema_create");
+	NodeList items = ast_list(ast, ast->data[file].lhs);
+
+	u32 fn_count = 0;
+	for(u32 i = 0; i < items.len; i += 1){
+		fn_count += ast->tag[items.v[i]] == Node_FnDecl;
+	}
+	NodeIndex* fns = heap_alloc(max(fn_count, 1u) * sizeof(NodeIndex), alignof(NodeIndex));
+	SemaSlice* slices = heap_alloc(max(fn_count, 1u) * sizeof(SemaSlice), alignof(SemaSlice));
+	fn_count = 0;
+	for(u32 i = 0; i < items.len; i += 1){
+		if(ast->tag[items.v[i]] == Node_FnDecl){
+			fns[fn_count] = items.v[i];
+			fn_count += 1;
+		}
+	}
+
+	u32 worker_count = s->worker_count != 0 ? s->worker_count : (u32)thread_cpu_count();
+	worker_count = max(min(worker_count, fn_count), 1u);
+	SemaWorker* workers = heap_alloc(worker_count * sizeof(SemaWorker), alignof(SemaWorker));
+	for(u32 i = 0; i < worker_count; i += 1){
+		sema_worker_init(s, &workers[i], file);
+		if(i > 0){
+			/* Redeclarations are reported once, by worker 0 */
+			dyn_array_clear(&workers[i].resolver.errors);
+		}
+	}
+
+	/* Globals and signatures, every body depends on them */
+	SemaWorker* first = &workers[0];
+	resolver_resolve_globals(&first->resolver, file);
+	infer_declarations(&first->infer, file);
+	NodeIndex prev = 0;
+	for(u32 i = 0; i < items.len; i += 1){
+		/* A global's nodes sit between the previous item and itself */
+		if(ast->tag[items.v[i]] == Node_Let){
+			sema_fold(s, &first->infer, prev + 1, items.v[i]);
+		}
+		prev = items.v[i];
+	}
+	u32 resolve_globals = first->resolver.errors.len;
+	u32 infer_globals = first->infer.errors.len;
+
+	SemaJob job = {
+		.sema = s,
+		.workers = workers,
+		.fns = fns,
+		.slices = slices,
+	};
+	parallel_for(worker_count, fn_count, sema_check_fn, &job);
+
+	sema_merge(s, &first->resolver.errors, 0, resolve_globals);
+	sema_merge(s, &first->infer.errors, 0, infer_globals);
+	for(u32 i = 0; i < fn_count; i += 1){
+		SemaWorker* w = &workers[slices[i].worker];
+		sema_merge(s, &w->resolver.errors, slices[i].resolve_lo, slices[i].resolve_hi);
+		sema_merge(s, &w->infer.errors, slices[i].infer_lo, slices[i].infer_hi);
+	}
+	sema_sort_errors(s);
+
+	for(u32 i = 0; i < worker_count; i += 1){
+		sema_worker_destroy(&workers[i]);
+	}
+	heap_free(workers);
+	heap_free(slices);
+	heap_free(fns);
+}
+
+#undef SEMA_SCRATCH_SIZE
+#undef SEMA_ERRORS_SIZE
@@ -1,3 +1,10 @@
 #include "cx.h"
 
 #include "lexer.c"
+#include "ast.c"
+#include "parser.c"
+#include "pipeline.c"
+#include "resolver.c"
+#include "type.c"
+#include "infer.c"
+#include "check.c"
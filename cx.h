@@ -2,29 +2,42 @@
 #include "base/types.h"
 #include "base/memory.h"
 #include "base/string.h"
+#include "base/array.h"
+#include "base/io.h"
+#include "base/thread.h"
+#include "base/intern.h"
 
 typedef enum {
 	CompilerError_UnknownToken,
 	CompilerError_InvalidNumber,
+	CompilerError_InvalidEncoding,
+	CompilerError_UnexpectedToken,
+	CompilerError_UndeclaredName,
+	CompilerError_Redeclared,
+	CompilerError_UnknownType,
+	CompilerError_TypeMismatch,
+	CompilerError_CannotInfer,
+	CompilerError_InvalidConstant,
 } CompilerErrorType;
 
-typedef struct CompilerError CompilerError;
-
-struct CompilerError {
+typedef struct {
 	String filename;
 	isize offset;
 	String message;
 	u32 type;
-	CompilerError* next;
-};
+} CompilerError;
+
+typedef DynArray(CompilerError) CompilerErrorArray;
 
 typedef struct {
 	String source;
 	isize current;
 	isize previous;
 
-	CompilerError* error;
+	CompilerErrorArray errors;
 	Arena* arena;
+
+	bool valid_utf8; /* Source passed utf8_validate, decode without checks */
 } Lexer;
 
 typedef enum {
@@ -108,19 +121,22 @@ typedef struct {
 
 	union {
 		f64    value_real;
-		i64    value_integer;
+		i64    value_integer; /* Holds the u64 value, literals have no sign */
 		rune   value_char;
 		String value_string;
 		u32    assign_operator; /* Only for Tk_AssignOp */
 	};
 } Token;
 
+typedef DynArray(Token) TokenArray;
+
 typedef struct {
-	Token* tokens;
-	isize  token_count;
-	CompilerError* error;
+	TokenArray tokens; /* Always ends with a Tk_EndOfFile token */
+	CompilerErrorArray errors;
 } LexerResult;
 
+Lexer lexer_create(String source, Arena* arena);
+
 rune lexer_peek(Lexer* lex, isize delta);
 
 rune lexer_advance(Lexer* lex);
@@ -137,6 +153,583 @@ Token lexer_match_string(Lexer* lex);
 
 Token lexer_next(Lexer* lex);
 
+/* Lex the whole source into a token array allocated with `allocator` */
+LexerResult lexer_tokenize(Lexer* lex, Allocator allocator);
+
+/* Checkpoint for speculative lexing. The whole error array header is saved,
+ * not just its length: if it grew inside the region its new buffer is rolled
+ * back with the arena, and the old one still holds the earlier errors. */
+typedef struct {
+	isize current;
+	isize previous;
+	CompilerErrorArray errors;
+	ArenaRegion region;
+} LexerSnapshot;
+
+/* Snapshots nest, and each one must be ended by exactly one restore or
+ * commit, innermost first */
+LexerSnapshot lexer_snapshot(Lexer* lex);
+
+/* Back to the snapshot, dropping errors and arena allocations made since */
+void lexer_restore(Lexer* lex, LexerSnapshot snap);
+
+/* Keep everything done since the snapshot */
+void lexer_commit(Lexer* lex, LexerSnapshot snap);
+
 void lexer_emit_error(Lexer* lex, CompilerErrorType errtype, char const * restrict fmt, ...) str_attribute_format(3,4);
 
+/* Writes a token the way the token dump prints it */
+void token_write(Token t, Writer* w);
+
+/* token_write into a string allocated from arena */
 String token_format(Token t, Arena* arena);
+
+//// AST
+/* Nodes live in parallel arrays (struct of arrays) and refer to each other by
+ * u32 index, so a node costs 13 bytes: a u8 tag, the index of its main token
+ * and two u32 operands. What the operands mean depends on the tag. Children
+ * that don't fit in two operands (argument lists, statements) are stored in
+ * `extra` and the node points there. Node 0 is a placeholder, so index 0 in
+ * an operand means "no node". */
+typedef u32 NodeIndex;
+
+#define NODE_NONE ((NodeIndex)0)
+
+typedef enum {
+	Node_None = 0,
+
+	// Leaves, the value is in the main token
+	Node_Integer,
+	Node_Real,
+	Node_String,
+	Node_Char,
+	Node_Bool,
+	Node_Nil,
+	Node_Identifier,
+
+	// Top level
+	Node_File,     /* lhs is an extra list of top level items */
+	Node_FnDecl,   /* main token is the name, lhs is a Node_FnProto, rhs the body */
+	Node_FnProto,  /* fn ( params ) ret, lhs is an extra list of Node_Param, rhs the return type */
+	Node_Param,    /* main token is the name, lhs is the type */
+	Node_LazyBody, /* Unparsed body, lhs and rhs are the tokens of '{' and '}' */
+
+	// Statements
+	Node_Let,      /* main token is the name, lhs is the type and rhs the value, either can be none */
+	Node_Block,    /* lhs is an extra list of statements */
+	Node_Return,   /* lhs is the value or none */
+	Node_If,       /* lhs is the condition, rhs an extra list of {then, else} */
+	Node_For,      /* lhs is the condition or none, rhs the body */
+	Node_Break,
+	Node_Continue,
+
+	// Types
+	Node_TypeName,    /* The name is the main token */
+	Node_TypePointer, /* * lhs */
+	Node_TypeArray,   /* [ lhs ] rhs, lhs is the length or none for a slice */
+	Node_TypeFn,      /* fn ( lhs ) rhs, lhs is an extra list of parameter types */
+
+	// Expressions
+	Node_Unary,  /* op lhs */
+	Node_Binary, /* lhs op rhs */
+	Node_Assign, /* lhs = rhs, main token is '=' or an AssignOp */
+	Node_Member, /* lhs . rhs, rhs is the token index of the name */
+	Node_Index,  /* lhs [ rhs ] */
+	Node_Call,   /* lhs ( args ), rhs is an extra list of arguments */
+
+	Node__COUNT,
+} NodeTag;
+
+static_assert(Node__COUNT <= 256, "Node tags must fit in a byte");
+
+typedef struct {
+	u32 lhs;
+	u32 rhs;
+} NodeData;
+
+typedef DynArray(u32) U32Array;
+
+typedef struct {
+	/* One allocation holding cap entries of each array */
+	NodeData* data;
+	u32* main_token;
+	u8* tag;
+	u32 len;
+	u32 cap;
+
+	U32Array extra;
+	Allocator allocator;
+} Ast;
+
+/* Length prefixed run of u32 in extra */
+typedef struct {
+	u32 const* v;
+	u32 len;
+} NodeList;
+
+Ast ast_create(Allocator allocator, isize node_capacity);
+
+void ast_destroy(Ast* ast);
+
+NodeIndex ast_add_node(Ast* ast, NodeTag tag, u32 main_token, u32 lhs, u32 rhs);
+
+/* Claim an index now and fill it with ast_set_node later, so a parent can sit
+ * in front of its children */
+NodeIndex ast_reserve_node(Ast* ast);
+
+void ast_set_node(Ast* ast, NodeIndex node, NodeTag tag, u32 main_token, u32 lhs, u32 rhs);
+
+/* Store count items as a list in extra, returns its index */
+u32 ast_add_list(Ast* ast, u32 const* items, u32 count);
+
+static inline
+NodeList ast_list(Ast const* ast, u32 extra_index){
+	ensure(extra_index < ast->extra.len, "Invalid extra index");
+	return (NodeList){
+		.v = ast->extra.v + extra_index + 1,
+		.len = ast->extra.v[extra_index],
+	};
+}
+
+//// Parser
+typedef enum {
+	ParserFrame_Prefix, /* Unary operator waiting for its operand */
+	ParserFrame_Infix,  /* Binary operator waiting for its right side */
+	ParserFrame_Group,  /* ( expr ) */
+	ParserFrame_Index,  /* lhs [ expr ] */
+	ParserFrame_Call,   /* lhs ( args ) */
+} ParserFrameKind;
+
+typedef struct {
+	u8 kind;
+	u8 min_bp;      /* Binding power to restore once the frame is done */
+	u32 op_token;
+	NodeIndex lhs;
+	u32 args_start; /* Call arguments collected so far start here in scratch */
+} ParserFrame;
+
+typedef DynArray(ParserFrame) ParserFrameArray;
+
+//// Token streaming
+/* Bounded single producer / single consumer ring of token batches. The
+ * batch buffers are allocated once and reused as the consumer releases them,
+ * so the lexer's working memory stays fixed however long the source is. */
+#define TOKEN_BATCH_SIZE 1024
+
+typedef struct {
+	Token tokens[TOKEN_BATCH_SIZE];
+	u32 len;
+} TokenBatch;
+
+typedef struct {
+	TokenBatch* batches;
+	u32 count; /* Power of 2 */
+	Allocator allocator;
+
+	alignas(64) _Atomic(u32) head; /* Next batch to read, owned by the consumer */
+	alignas(64) _Atomic(u32) tail; /* Next batch to write, owned by the producer */
+} TokenRing;
+
+void token_ring_init(TokenRing* ring, Allocator allocator, u32 count);
+
+void token_ring_destroy(TokenRing* ring);
+
+/* Producer: wait for a free batch, fill it, then publish it */
+TokenBatch* token_ring_begin_write(TokenRing* ring);
+
+void token_ring_end_write(TokenRing* ring);
+
+/* Consumer: wait for a published batch, then hand it back to the producer */
+TokenBatch* token_ring_begin_read(TokenRing* ring);
+
+void token_ring_end_read(TokenRing* ring);
+
+typedef struct {
+	String source;
+	Token const* tokens; /* Ends with Tk_EndOfFile, unless still streaming */
+	u32 token_count;
+	u32 current;
+
+	/* When streaming, tokens are pulled from the ring into stream_tokens as
+	 * the parser gets to them */
+	TokenRing* ring;
+	TokenArray* stream_tokens;
+
+	Ast* ast;
+	CompilerErrorArray errors;
+	Arena* arena;
+
+	/* Skip fn bodies, leaving a Node_LazyBody for parser_parse_body */
+	bool lazy_bodies;
+
+	/* Operator stack and pending lists, expression depth never touches the C stack */
+	ParserFrameArray stack;
+	U32Array scratch;
+
+	/* Open snapshots, and the (fn, old rhs) pairs parser_parse_body patched
+	 * while one was open, so a restore can put the lazy bodies back */
+	u32 snapshot_depth;
+	U32Array body_patches;
+} Parser;
+
+/* tokens is empty when they will come from parser_parse_file_streaming. The
+ * AST must not allocate from arena, restoring a snapshot would free its
+ * buffers. */
+Parser parser_create(String source, TokenArray tokens, Ast* ast, Arena* arena);
+
+void parser_destroy(Parser* p);
+
+/* Same as LexerSnapshot for the parser, the AST is cut back to its length at
+ * the snapshot. Restoring does not visit nodes, only bodies parsed since. */
+typedef struct {
+	u32 current;
+	u32 node_count;
+	u32 extra_len;
+	u32 patch_len;
+	CompilerErrorArray errors;
+	ArenaRegion region;
+} ParserSnapshot;
+
+ParserSnapshot parser_snapshot(Parser* p);
+
+void parser_restore(Parser* p, ParserSnapshot snap);
+
+void parser_commit(Parser* p, ParserSnapshot snap);
+
+NodeIndex parser_parse_expr(Parser* p);
+
+NodeIndex parser_parse_type(Parser* p);
+
+NodeIndex parser_parse_stmt(Parser* p);
+
+NodeIndex parser_parse_block(Parser* p);
+
+/* fn and let declarations until the end of the file, returns a Node_File */
+NodeIndex parser_parse_file(Parser* p);
+
+/* Body of a Node_FnDecl, parsing it first if it was skipped. The tokens the
+ * parser was created with must still be around. */
+NodeIndex parser_parse_body(Parser* p, NodeIndex fn);
+
+/* Lex on a second thread while this one parses, through a TokenRing. Every
+ * token the AST refers to ends up in `tokens`. The lexer and the parser must
+ * not share an arena. */
+NodeIndex parser_parse_file_streaming(Parser* p, Lexer* lex, TokenArray* tokens);
+
+void parser_emit_error(Parser* p, CompilerErrorType errtype, char const * restrict fmt, ...) str_attribute_format(3,4);
+
+//// Symbol table
+/* Scopes and their symbols live in an arena region, popping a scope frees
+ * them in O(1). Lookups don't walk the scope chain: atoms are dense, so the
+ * flattened (scope, atom) table is an array indexed by atom holding the
+ * innermost binding, and each symbol links to the one it shadows. Declaring
+ * and popping update that entry, so every operation is O(1) and resolving a
+ * whole program is linear in its size. */
+typedef struct Symbol Symbol;
+
+struct Symbol {
+	Atom name;
+	u32 depth;        /* Depth of the declaring scope, the file scope is 0 */
+	NodeIndex decl;   /* Node_Let, Node_Param or Node_FnDecl */
+	Symbol* shadowed; /* Binding of the same name in an enclosing scope */
+	Symbol* next;     /* Previous symbol declared in the same scope */
+};
+
+typedef struct Scope Scope;
+
+struct Scope {
+	Scope* parent;
+	Symbol* symbols;
+	u32 depth;
+	ArenaRegion region;
+};
+
+typedef DynArray(Symbol*) SymbolPtrArray;
+
+typedef struct {
+	Arena* arena;
+	Scope* current;
+	SymbolPtrArray visible; /* Innermost binding for each atom, NULL when there is none */
+} SymbolTable;
+
+SymbolTable symbol_table_create(Arena* arena, Allocator allocator);
+
+void symbol_table_destroy(SymbolTable* t);
+
+void symbol_scope_push(SymbolTable* t);
+
+/* Unbinds the scope's symbols and frees everything allocated since the push */
+void symbol_scope_pop(SymbolTable* t);
+
+/* Declare in the current scope, shadowing outer bindings of name. Returns
+ * NULL if the current scope already has it. */
+Symbol* symbol_declare(SymbolTable* t, Atom name, NodeIndex decl);
+
+/* Innermost visible binding of name, or NULL */
+static inline
+Symbol* symbol_lookup(SymbolTable const* t, Atom name){
+	return name < t->visible.len ? t->visible.v[name] : NULL;
+}
+
+//// Name resolution
+/* Single pass over the AST binding every Node_Identifier in an expression to
+ * its declaration. Top level names are declared first, so functions and
+ * globals can be used before the point they are declared, except that a
+ * global's value only sees the globals above it; locals are only visible
+ * after their let. Bodies that are still a Node_LazyBody are skipped. */
+typedef struct {
+	String source;
+	Ast const* ast;
+	Token const* tokens;
+	Interner* interner;
+
+	SymbolTable symbols; /* Scopes live in the scratch arena */
+	NodeIndex* binding;  /* Declaration of each Node_Identifier, NODE_NONE if unresolved. Caller owned, one per node */
+	u32 binding_len;
+	Allocator allocator;
+
+	CompilerErrorArray errors;
+	Arena* arena;    /* Error messages, must not be the scratch arena */
+	U32Array stack;  /* Pending expression nodes */
+	NodeIndex global; /* Global let whose value is being resolved, or NODE_NONE */
+} Resolver;
+
+/* binding must hold ast->len zeroed entries. Resolvers working on different
+ * functions of one file may share it, each only writes its own nodes. */
+Resolver resolver_create(String source, Ast const* ast, Token const* tokens, Interner* interner, NodeIndex* binding, Arena* arena, Arena* scratch);
+
+void resolver_destroy(Resolver* r);
+
+/* Opens the file scope and declares every top level name in it. The scope
+ * stays open for resolver_resolve_globals and resolver_resolve_fn. */
+void resolver_declare_globals(Resolver* r, NodeIndex file);
+
+/* Values of the top level lets */
+void resolver_resolve_globals(Resolver* r, NodeIndex file);
+
+void resolver_resolve_fn(Resolver* r, NodeIndex fn);
+
+void resolver_resolve_file(Resolver* r, NodeIndex file);
+
+void resolver_emit_error(Resolver* r, u32 token, CompilerErrorType errtype, char const * restrict fmt, ...) str_attribute_format(4,5);
+
+//// Types
+/* Every type is hash-consed into a TypeTable, so two types are equal exactly
+ * when their TypeIds are, and a type is stored once however often it is
+ * spelled. Primitives are created up front and their id is their kind.
+ *
+ * Like the Interner, lookups are lock-free: an open addressing table of
+ * (hash high bits << 32 | id), replaced under the lock when it grows with
+ * the old one kept for readers still probing it. Types live in pages that
+ * never move. */
+typedef u32 TypeId;
+
+typedef enum {
+	Type_None = 0, /* No type, the result of anything that failed to check */
+
+	// Primitives
+	Type_Void,
+	Type_Bool,
+	Type_I8,
+	Type_I16,
+	Type_I32,
+	Type_I64,
+	Type_U8,
+	Type_U16,
+	Type_U32,
+	Type_U64,
+	Type_F32,
+	Type_F64,
+	Type_Rune,
+	Type_String,
+
+	// Constructed
+	Type_Pointer, /* *elem */
+	Type_Array,   /* [len]elem */
+	Type_Slice,   /* []elem */
+	Type_Fn,      /* fn(params) elem */
+
+	Type__COUNT,
+} TypeKind;
+
+#define TYPE_PRIMITIVE_COUNT Type_Pointer
+
+#define TYPE_TABLE_PAGE_SHIFT 12
+#define TYPE_TABLE_MAX_PAGES  (1 << 16)
+
+typedef struct {
+	u8 kind;
+	u32 param_count;
+	TypeId elem; /* Pointee, element or return type */
+	union {
+		u64 len;
+		TypeId const* params;
+	};
+} Type;
+
+typedef struct TypeTableSlots TypeTableSlots;
+
+typedef struct {
+	atomic_int lock;
+	_Atomic(TypeTableSlots*) slots;
+	isize len;
+	_Atomic(u32) next_id;
+
+	Arena params; /* Parameter lists of Type_Fn, only touched under the lock */
+	_Atomic(Type*) pages[TYPE_TABLE_MAX_PAGES];
+} TypeTable;
+
+/* Reserves `param_capacity` bytes of address space for fn parameter lists */
+TypeTable* type_table_create(isize param_capacity);
+
+void type_table_destroy(TypeTable* t);
+
+/* The id of t, adding it if it is new. Parameter lists are copied. */
+TypeId type_intern(TypeTable* t, Type type);
+
+static inline
+Type const* type_get(TypeTable* t, TypeId id){
+	Type* page = atomic_load_explicit(&t->pages[id >> TYPE_TABLE_PAGE_SHIFT], memory_order_acquire);
+	return &page[id & ((1 << TYPE_TABLE_PAGE_SHIFT) - 1)];
+}
+
+TypeId type_pointer(TypeTable* t, TypeId elem);
+
+TypeId type_array(TypeTable* t, TypeId elem, u64 len);
+
+TypeId type_slice(TypeTable* t, TypeId elem);
+
+TypeId type_fn(TypeTable* t, TypeId const* params, u32 param_count, TypeId ret);
+
+/* Primitive called name, or Type_None */
+TypeId type_from_name(String name);
+
+/* Type described by type syntax. Returns Type_None, with *bad_node set to
+ * the offending node, for unknown names and array lengths that aren't
+ * integer literals. */
+TypeId type_from_node(TypeTable* t, Ast const* ast, Token const* tokens, NodeIndex node, NodeIndex* bad_node);
+
+void type_format(TypeTable* t, TypeId id, StrBuilder* sb);
+
+//// Type inference
+/* Constraint based inference over union-find. Every node of the unit being
+ * inferred (a fn body or a global let) gets a type variable; variables are
+ * merged with union by rank and path compression, and a root either has a
+ * TypeId or is still open. Constraints go on a worklist: equalities are
+ * solved right away, indexing and calls wait until the type they look into
+ * is known, and each pass runs what is left until nothing changes. Open
+ * literals then take their defaults (i64 and f64) and solving resumes, so a
+ * unit is inferred in near linear time.
+ *
+ * Nodes outside the unit (parameters, functions, globals) are read from
+ * node_types, which is why signatures and globals go first. Each unit only
+ * writes node_types inside its own node range. */
+typedef enum {
+	InferFlag_Numeric  = 1 << 0,
+	InferFlag_Integral = 1 << 1,
+	InferFlag_Float    = 1 << 2,
+	InferFlag_Nullable = 1 << 3, /* Pointer, slice or fn */
+	InferFlag_IntLit   = 1 << 4, /* Defaults to i64 */
+	InferFlag_Poison   = 1 << 5, /* Depends on something that already failed, stay quiet */
+} InferFlag;
+
+typedef struct {
+	u32 parent;
+	u8 rank;
+	u8 flags;
+	TypeId type; /* Type_None while open */
+} InferVar;
+
+typedef enum {
+	InferConstraint_Equal, /* Nodes a and b have the same type */
+	InferConstraint_Type,  /* Node a has TypeId b */
+	InferConstraint_Flags, /* Node a's type satisfies InferFlags b */
+	InferConstraint_Index, /* Node a is a Node_Index */
+	InferConstraint_Call,  /* Node a is a Node_Call */
+} InferConstraintKind;
+
+typedef struct {
+	u8 kind;
+	u32 a;
+	u32 b;
+} InferConstraint;
+
+typedef DynArray(InferConstraint) InferConstraintArray;
+
+typedef struct {
+	String source;
+	Ast const* ast;
+	Token const* tokens;
+	TypeTable* types;
+	NodeIndex const* binding; /* From the Resolver */
+	TypeId* node_types;       /* One per node, shared by every unit of the file */
+
+	/* Current unit, vars[i] belongs to node var_base + i */
+	InferVar* vars;
+	u32 var_base;
+	u32 var_end;
+	TypeId ret;
+
+	/* Nodes of the last unit inferred, kept after its variables are gone */
+	u32 unit_lo;
+	u32 unit_hi;
+
+	InferConstraintArray work;
+	InferConstraintArray deferred;
+	U32Array stack;
+
+	CompilerErrorArray errors;
+	Arena* arena;   /* Error messages */
+	Arena* scratch; /* Variables, freed after every unit */
+} Infer;
+
+Infer infer_create(String source, Ast const* ast, Token const* tokens, TypeTable* types, NodeIndex const* binding, TypeId* node_types, Arena* arena, Arena* scratch);
+
+void infer_destroy(Infer* in);
+
+/* fn signatures, parameters and global lets, in that order */
+void infer_declarations(Infer* in, NodeIndex file);
+
+/* Needs infer_declarations first */
+void infer_fn(Infer* in, NodeIndex fn);
+
+void infer_file(Infer* in, NodeIndex file);
+
+void infer_emit_error(Infer* in, NodeIndex node, CompilerErrorType errtype, char const * restrict fmt, ...) str_attribute_format(4,5);
+
+//// Semantic analysis
+/* Name resolution, type inference and constant folding for a whole file.
+ * Globals and signatures are checked first on the calling thread. After that
+ * a fn body only reads shared state and writes its own nodes, so bodies are
+ * checked in parallel with parallel_for, each worker using its own scratch
+ * and error arenas. Errors are kept per function, merged and then sorted by
+ * offset, which makes the output the same for any worker count. Bodies that are
+ * still a Node_LazyBody are skipped. */
+typedef struct {
+	bool known;
+	i64 value; /* Wrapped to the node's type, bools are 0 or 1 */
+} ConstValue;
+
+typedef struct {
+	String source;
+	Ast const* ast;
+	Token const* tokens;
+	Interner* interner;
+	TypeTable* types;
+
+	/* One entry per node */
+	NodeIndex* binding;
+	TypeId* node_types;
+	ConstValue* consts; /* Known for integer and bool expressions that fold */
+	u32 node_count;
+
+	CompilerErrorArray errors;
+	Arena* arena;     /* Error messages */
+	u32 worker_count; /* 0 uses every processor */
+} Sema;
+
+Sema sema_create(String source, Ast const* ast, Token const* tokens, Interner* interner, TypeTable* types, Arena* arena, u32 worker_count);
+
+void sema_destroy(Sema* s);
+
+void sema_check_file(Sema* s, NodeIndex file);
@@ -0,0 +1,715 @@
+#include "cx.h"
+
+/* Marks an expression stack entry whose children were already queued */
+#define INFER_EXPR_DONE (1u << 31)
+
+void infer_emit_error(Infer* in, NodeIndex node, CompilerErrorType errtype, char const * restrict fmt, ...){
+	CompilerError new_error = {
+		.type = errtype,
+		.offset = in->tokens[in->ast->main_token[node]].lexeme.v - in->source.v,
+	};
+
+	va_list argp;
+	va_start(argp, fmt);
+	new_error.message = str_vformat(in->arena, fmt, argp);
+	va_end(argp);
+
+	dyn_array_push(&in->errors, new_error);
+}
+
+Infer infer_create(String source, Ast const* ast, Token const* tokens, TypeTable* types, NodeIndex const* binding, TypeId* node_types, Arena* arena, Arena* scratch){
+	ensure(arena != scratch, "Errors would be freed with the variables");
+	ensure(ast->len <= INFER_EXPR_DONE, "Too many nodes to infer");
+	return (Infer){
+		.source = source,
+		.ast = ast,
+		.tokens = tokens,
+		.types = types,
+		.binding = binding,
+		.node_types = node_types,
+		.work = dyn_array_create(heap_allocator()),
+		.deferred = dyn_array_create(heap_allocator()),
+		.stack = dyn_array_create(heap_allocator()),
+		.errors = dyn_array_create(arena_allocator(arena)),
+		.arena = arena,
+		.scratch = scratch,
+	};
+}
+
+void infer_destroy(Infer* in){
+	dyn_array_destroy(&in->work);
+	dyn_array_destroy(&in->deferred);
+	dyn_array_destroy(&in->stack);
+}
+
+/* Type as text in the error arena */
+static
+String infer_type_name(Infer* in, TypeId id){
+	StrBuilder sb = str_builder_create(heap_allocator(), 256);
+	type_format(in->types, id, &sb);
+	String s = str_builder_build(&sb);
+	String name = str_format(in->arena, "%.*s", str_fmt(s));
+	str_builder_destroy(&sb);
+	return name;
+}
+
+//// Union-find
+static inline
+bool infer_in_unit(Infer const* in, NodeIndex node){
+	return node >= in->var_base && node < in->var_end;
+}
+
+/* Root of node's variable, compressing the path behind it */
+static
+u32 infer_find(Infer* in, NodeIndex node){
+	InferVar* vars = in->vars;
+	u32 v = node - in->var_base;
+	u32 root = v;
+	while(vars[root].parent != root){
+		root = vars[root].parent;
+	}
+	while(vars[v].parent != root){
+		u32 next = vars[v].parent;
+		vars[v].parent = root;
+		v = next;
+	}
+	return root;
+}
+
+static
+bool infer_flags_allow(Infer* in, TypeId t, u8 flags){
+	bool integral = t >= Type_I8 && t <= Type_U64;
+	bool is_float = t == Type_F32 || t == Type_F64;
+	if((flags & InferFlag_Integral) && !integral){ return false; }
+	if((flags & InferFlag_Float) && !is_float){ return false; }
+	if((flags & InferFlag_Numeric) && !integral && !is_float){ return false; }
+	if(flags & InferFlag_Nullable){
+		u8 kind = type_get(in->types, t)->kind;
+		return kind == Type_Pointer || kind == Type_Slice || kind == Type_Fn;
+	}
+	return true;
+}
+
+static
+void infer_flags_error(Infer* in, NodeIndex at, TypeId t, u8 flags){
+	char const* want = "a numeric type";
+	if(flags & InferFlag_Nullable){ want = "a pointer, slice or fn type"; }
+	else if(flags & InferFlag_Float){ want = "a float type"; }
+	else if(flags & InferFlag_Integral){ want = "an integer type"; }
+	String name = infer_type_name(in, t);
+	infer_emit_error(in, at, CompilerError_TypeMismatch, "'%.*s' is not %s", str_fmt(name), want);
+}
+
+static
+void infer_mismatch_error(Infer* in, NodeIndex at, TypeId expected, TypeId got){
+	String expected_name = infer_type_name(in, expected);
+	String got_name = infer_type_name(in, got);
+	infer_emit_error(in, at, CompilerError_TypeMismatch, "Type mismatch, expected '%.*s', got '%.*s'", str_fmt(expected_name), str_fmt(got_name));
+}
+
+/* Give root the type t, which is what the context requires of it. at is the
+ * node blamed on a conflict. */
+static
+void infer_bind(Infer* in, u32 root, TypeId t, NodeIndex at){
+	InferVar* var = &in->vars[root];
+	if(t == Type_None || (var->flags & InferFlag_Poison)){
+		return;
+	}
+	if(var->type == Type_None){
+		if(!infer_flags_allow(in, t, var->flags)){
+			infer_flags_error(in, at, t, var->flags);
+			var->flags |= InferFlag_Poison;
+			return;
+		}
+		var->type = t;
+	}
+	else if(var->type != t){
+		infer_mismatch_error(in, at, t, var->type);
+		var->flags |= InferFlag_Poison;
+	}
+}
+
+/* Merge two roots. On a conflict the type of expected is the one reported as
+ * required, whichever root ends up on top. */
+static
+void infer_union(Infer* in, u32 expected, u32 got, NodeIndex at){
+	if(expected == got){
+		return;
+	}
+	InferVar* vars = in->vars;
+	TypeId te = vars[expected].type;
+	TypeId tg = vars[got].type;
+	u8 fe = vars[expected].flags;
+	u8 fg = vars[got].flags;
+
+	u32 root = expected;
+	u32 child = got;
+	if(vars[root].rank < vars[child].rank){
+		root = got;
+		child = expected;
+	}
+	vars[child].parent = root;
+	if(vars[root].rank == vars[child].rank){
+		vars[root].rank += 1;
+	}
+	vars[root].flags = fe | fg;
+
+	if((fe | fg) & InferFlag_Poison){
+		return;
+	}
+	if(te != Type_None && tg != Type_None){
+		if(te != tg){
+			infer_mismatch_error(in, at, te, tg);
+			vars[root].flags |= InferFlag_Poison;
+		}
+		vars[root].type = te;
+		return;
+	}
+	if(te == Type_None && tg == Type_None){
+		return;
+	}
+
+	/* Check the untyped side's flags against the type of the other */
+	TypeId t = te != Type_None ? te : tg;
+	u8 flags = te != Type_None ? fg : fe;
+	vars[root].type = t;
+	if(!infer_flags_allow(in, t, flags)){
+		infer_flags_error(in, at, t, flags);
+		vars[root].flags |= InferFlag_Poison;
+	}
+}
+
+/* A node outside the unit stands for the type recorded for it */
+static
+void infer_equal(Infer* in, NodeIndex a, NodeIndex b){
+	if(!infer_in_unit(in, b)){
+		TypeId t = in->node_types[b];
+		u32 root = infer_find(in, a);
+		if(t == Type_None){
+			in->vars[root].flags |= InferFlag_Poison;
+		}
+		infer_bind(in, root, t, a);
+		return;
+	}
+	infer_union(in, infer_find(in, a), infer_find(in, b), a);
+}
+
+static inline
+TypeId infer_type_of(Infer* in, NodeIndex node){
+	return in->vars[infer_find(in, node)].type;
+}
+
+//// Constraints
+/* Parse errors leave NODE_NONE operands behind. They have no variable, as b
+ * of an Equal they poison a like any node without a type. */
+static inline
+void infer_push(Infer* in, InferConstraintKind kind, u32 a, u32 b){
+	if(a == NODE_NONE){
+		if(kind != InferConstraint_Equal || b == NODE_NONE){
+			return;
+		}
+		a = b;
+		b = NODE_NONE;
+	}
+	InferConstraint c = { .kind = (u8)kind, .a = a, .b = b };
+	dyn_array_push(&in->work, c);
+}
+
+/* Returns false when c has to wait for more information */
+static
+bool infer_apply(Infer* in, InferConstraint c){
+	Ast const* ast = in->ast;
+
+	switch((InferConstraintKind)c.kind){
+	case InferConstraint_Equal:
+		infer_equal(in, c.a, c.b);
+	return true;
+
+	case InferConstraint_Type:
+		infer_bind(in, infer_find(in, c.a), c.b, c.a);
+	return true;
+
+	case InferConstraint_Flags: {
+		u32 root = infer_find(in, c.a);
+		InferVar* var = &in->vars[root];
+		if(var->type != Type_None && !(var->flags & InferFlag_Poison) && !infer_flags_allow(in, var->type, (u8)c.b)){
+			infer_flags_error(in, c.a, var->type, (u8)c.b);
+			var->flags |= InferFlag_Poison;
+		}
+		var->flags |= (u8)c.b;
+	} return true;
+
+	case InferConstraint_Index: {
+		NodeIndex base = ast->data[c.a].lhs;
+		if(base == NODE_NONE){
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+		u32 root = infer_find(in, base);
+		TypeId t = in->vars[root].type;
+		if(in->vars[root].flags & InferFlag_Poison){
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+		if(t == Type_None){
+			return false;
+		}
+
+		Type const* type = type_get(in->types, t);
+		TypeId elem = Type_None;
+		if(type->kind == Type_Array || type->kind == Type_Slice){
+			elem = type->elem;
+		}
+		else if(t == Type_String){
+			elem = Type_U8;
+		}
+		else {
+			String name = infer_type_name(in, t);
+			infer_emit_error(in, c.a, CompilerError_TypeMismatch, "Can't index a value of type '%.*s'", str_fmt(name));
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+		infer_bind(in, infer_find(in, c.a), elem, c.a);
+	} return true;
+
+	case InferConstraint_Call: {
+		NodeIndex callee = ast->data[c.a].lhs;
+		if(callee == NODE_NONE){
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+		u32 root = infer_find(in, callee);
+		TypeId t = in->vars[root].type;
+		if(in->vars[root].flags & InferFlag_Poison){
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+		if(t == Type_None){
+			return false;
+		}
+
+		Type const* type = type_get(in->types, t);
+		if(type->kind != Type_Fn){
+			String name = infer_type_name(in, t);
+			infer_emit_error(in, c.a, CompilerError_TypeMismatch, "Can't call a value of type '%.*s'", str_fmt(name));
+			in->vars[infer_find(in, c.a)].flags |= InferFlag_Poison;
+			return true;
+		}
+
+		NodeList args = ast_list(ast, ast->data[c.a].rhs);
+		if(args.len != type->param_count){
+			infer_emit_error(in, c.a, CompilerError_TypeMismatch, "Expected %u arguments, got %u", type->param_count, args.len);
+		}
+		for(u32 i = 0; i < min(args.len, type->param_count); i += 1){
+			if(args.v[i] != NODE_NONE){
+				infer_bind(in, infer_find(in, args.v[i]), type->params[i], args.v[i]);
+			}
+		}
+		infer_bind(in, infer_find(in, c.a), type->elem, c.a);
+	} return true;
+	}
+	return true;
+}
+
+/* Open variables with a literal default take it. Returns true if any did. */
+static
+bool infer_apply_defaults(Infer* in){
+	bool changed = false;
+	for(u32 v = 0; v < in->var_end - in->var_base; v += 1){
+		InferVar* var = &in->vars[v];
+		if(var->parent != v || var->type != Type_None || (var->flags & InferFlag_Poison)){
+			continue;
+		}
+		TypeId def = Type_None;
+		if(var->flags & InferFlag_Float){ def = Type_F64; }
+		else if(var->flags & InferFlag_IntLit){ def = Type_I64; }
+		if(def != Type_None){
+			infer_bind(in, v, def, in->var_base + v);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+static
+void infer_solve(Infer* in){
+	bool defaulted = false;
+	for(;;){
+		bool progress = false;
+		for(isize i = 0; i < in->work.len; i += 1){
+			if(infer_apply(in, in->work.v[i])){
+				progress = true;
+			}
+			else {
+				dyn_array_push(&in->deferred, in->work.v[i]);
+			}
+		}
+
+		InferConstraintArray tmp = in->work;
+		in->work = in->deferred;
+		in->deferred = tmp;
+		dyn_array_clear(&in->deferred);
+
+		if(progress && in->work.len > 0){
+			continue;
+		}
+		/* Stuck or done, literals that are still open take their defaults
+		 * once, which may unblock what is left */
+		if(defaulted || !infer_apply_defaults(in)){
+			break;
+		}
+		defaulted = true;
+	}
+
+	for(isize i = 0; i < in->work.len; i += 1){
+		infer_emit_error(in, in->work.v[i].a, CompilerError_CannotInfer, "Can't infer the type of this expression");
+	}
+	dyn_array_clear(&in->work);
+}
+
+//// Constraint generation
+static inline
+bool infer_is_integral_op(u32 op){
+	return op == Tk_Modulo || op == Tk_And || op == Tk_Or || op == Tk_ShLeft || op == Tk_ShRight;
+}
+
+/* Walked with an explicit stack like the resolver. A node comes off the stack
+ * twice: first to queue its children, then, marked with INFER_EXPR_DONE, to
+ * push its own constraints. Children's constraints come first, so a chain like
+ * x[0][0][0] is solved inner to outer in a single pass. Tracks the lowest node
+ * seen so the unit's range is known before variables are allocated. */
+static
+void infer_expr(Infer* in, NodeIndex root, u32* lo){
+	Ast const* ast = in->ast;
+	if(root == NODE_NONE){
+		return;
+	}
+	isize base = in->stack.len;
+	dyn_array_push(&in->stack, root);
+
+	while(in->stack.len > base){
+		u32 entry = dyn_array_pop(&in->stack);
+		NodeIndex node = entry & ~INFER_EXPR_DONE;
+		if(node == NODE_NONE){
+			continue;
+		}
+		NodeData data = ast->data[node];
+
+		if(!(entry & INFER_EXPR_DONE)){
+			*lo = min(*lo, node);
+			dyn_array_push(&in->stack, node | INFER_EXPR_DONE);
+			switch((NodeTag)ast->tag[node]){
+			case Node_Unary:
+			case Node_Member:
+				dyn_array_push(&in->stack, data.lhs);
+			break;
+
+			case Node_Binary:
+			case Node_Assign:
+			case Node_Index:
+				dyn_array_push(&in->stack, data.rhs);
+				dyn_array_push(&in->stack, data.lhs);
+			break;
+
+			case Node_Call: {
+				NodeList args = ast_list(ast, data.rhs);
+				for(u32 i = args.len; i > 0; i -= 1){
+					dyn_array_push(&in->stack, args.v[i - 1]);
+				}
+				dyn_array_push(&in->stack, data.lhs);
+			} break;
+
+			default: break;
+			}
+			continue;
+		}
+
+		u32 op = in->tokens[ast->main_token[node]].type;
+		switch((NodeTag)ast->tag[node]){
+		case Node_Integer: infer_push(in, InferConstraint_Flags, node, InferFlag_Numeric | InferFlag_IntLit); break;
+		case Node_Real:    infer_push(in, InferConstraint_Flags, node, InferFlag_Numeric | InferFlag_Float); break;
+		case Node_String:  infer_push(in, InferConstraint_Type, node, Type_String); break;
+		case Node_Char:    infer_push(in, InferConstraint_Type, node, Type_Rune); break;
+		case Node_Bool:    infer_push(in, InferConstraint_Type, node, Type_Bool); break;
+		case Node_Nil:     infer_push(in, InferConstraint_Flags, node, InferFlag_Nullable); break;
+
+		case Node_Identifier:
+			if(in->binding[node] != NODE_NONE){
+				infer_push(in, InferConstraint_Equal, node, in->binding[node]);
+			}
+			else {
+				infer_push(in, InferConstraint_Flags, node, InferFlag_Poison);
+			}
+		break;
+
+		case Node_Unary:
+			if(op == Tk_Bang){
+				infer_push(in, InferConstraint_Type, node, Type_Bool);
+				infer_push(in, InferConstraint_Type, data.lhs, Type_Bool);
+			}
+			else {
+				infer_push(in, InferConstraint_Equal, node, data.lhs);
+				infer_push(in, InferConstraint_Flags, node, op == Tk_Tilde ? InferFlag_Integral : InferFlag_Numeric);
+			}
+		break;
+
+		case Node_Binary:
+			switch(op){
+			case Tk_LogicAnd:
+			case Tk_LogicOr:
+				infer_push(in, InferConstraint_Type, data.lhs, Type_Bool);
+				infer_push(in, InferConstraint_Type, data.rhs, Type_Bool);
+				infer_push(in, InferConstraint_Type, node, Type_Bool);
+			break;
+			case Tk_Eq:
+			case Tk_NotEq:
+				infer_push(in, InferConstraint_Equal, data.lhs, data.rhs);
+				infer_push(in, InferConstraint_Type, node, Type_Bool);
+			break;
+			case Tk_Gt:
+			case Tk_Lt:
+			case Tk_GtEq:
+			case Tk_LtEq:
+				infer_push(in, InferConstraint_Equal, data.lhs, data.rhs);
+				infer_push(in, InferConstraint_Flags, data.lhs, InferFlag_Numeric);
+				infer_push(in, InferConstraint_Type, node, Type_Bool);
+			break;
+			case Tk_ShLeft:
+			case Tk_ShRight:
+				infer_push(in, InferConstraint_Equal, node, data.lhs);
+				infer_push(in, InferConstraint_Flags, node, InferFlag_Integral);
+				infer_push(in, InferConstraint_Flags, data.rhs, InferFlag_Integral);
+			break;
+			default:
+				infer_push(in, InferConstraint_Equal, data.lhs, data.rhs);
+				infer_push(in, InferConstraint_Equal, node, data.lhs);
+				infer_push(in, InferConstraint_Flags, node, infer_is_integral_op(op) ? InferFlag_Integral : InferFlag_Numeric);
+			break;
+			}
+		break;
+
+		case Node_Assign:
+			infer_push(in, InferConstraint_Equal, data.lhs, data.rhs);
+			if(op == Tk_AssignOp){
+				u32 arith = in->tokens[ast->main_token[node]].assign_operator;
+				infer_push(in, InferConstraint_Flags, data.lhs, infer_is_integral_op(arith) ? InferFlag_Integral : InferFlag_Numeric);
+			}
+			infer_push(in, InferConstraint_Type, node, Type_Void);
+		break;
+
+		case Node_Member: {
+			String name = in->tokens[data.rhs].lexeme;
+			infer_emit_error(in, node, CompilerError_TypeMismatch, "Unknown member '%.*s'", str_fmt(name));
+			infer_push(in, InferConstraint_Flags, node, InferFlag_Poison);
+		} break;
+
+		case Node_Index:
+			infer_push(in, InferConstraint_Index, node, 0);
+			infer_push(in, InferConstraint_Flags, data.rhs, InferFlag_Integral);
+		break;
+
+		case Node_Call:
+			infer_push(in, InferConstraint_Call, node, 0);
+		break;
+
+		default: break;
+		}
+	}
+}
+
+/* Annotation of a let or param, reporting names that aren't types */
+static
+TypeId infer_annotation(Infer* in, NodeIndex type_node){
+	NodeIndex bad = NODE_NONE;
+	TypeId t = type_from_node(in->types, in->ast, in->tokens, type_node, &bad);
+	if(t == Type_None && bad != NODE_NONE){
+		String name = in->tokens[in->ast->main_token[bad]].lexeme;
+		infer_emit_error(in, bad, CompilerError_UnknownType, "Unknown type '%.*s'", str_fmt(name));
+	}
+	return t;
+}
+
+static
+void infer_let(Infer* in, NodeIndex node, u32* lo){
+	NodeData data = in->ast->data[node];
+	*lo = min(*lo, node);
+	infer_expr(in, data.rhs, lo);
+
+	if(data.lhs != NODE_NONE){
+		TypeId t = infer_annotation(in, data.lhs);
+		infer_push(in, InferConstraint_Type, node, t);
+		if(t == Type_None){
+			infer_push(in, InferConstraint_Flags, node, InferFlag_Poison);
+		}
+	}
+	if(data.rhs != NODE_NONE){
+		infer_push(in, InferConstraint_Equal, node, data.rhs);
+	}
+}
+
+static
+void infer_stmt(Infer* in, NodeIndex node, u32* lo){
+	Ast const* ast = in->ast;
+	if(node == NODE_NONE){
+		return;
+	}
+	NodeData data = ast->data[node];
+	*lo = min(*lo, node);
+
+	switch((NodeTag)ast->tag[node]){
+	case Node_Let:
+		infer_let(in, node, lo);
+	break;
+
+	case Node_Block: {
+		NodeList stmts = ast_list(ast, data.lhs);
+		for(u32 i = 0; i < stmts.len; i += 1){
+			infer_stmt(in, stmts.v[i], lo);
+		}
+	} break;
+
+	case Node_If: {
+		NodeList branches = ast_list(ast, data.rhs);
+		infer_expr(in, data.lhs, lo);
+		infer_push(in, InferConstraint_Type, data.lhs, Type_Bool);
+		infer_stmt(in, branches.v[0], lo);
+		if(branches.v[1] != NODE_NONE){
+			infer_stmt(in, branches.v[1], lo);
+		}
+	} break;
+
+	case Node_For:
+		if(data.lhs != NODE_NONE){
+			infer_expr(in, data.lhs, lo);
+			infer_push(in, InferConstraint_Type, data.lhs, Type_Bool);
+		}
+		infer_stmt(in, data.rhs, lo);
+	break;
+
+	case Node_Return:
+		if(data.lhs != NODE_NONE){
+			infer_expr(in, data.lhs, lo);
+			if(in->ret == Type_Void){
+				infer_emit_error(in, node, CompilerError_TypeMismatch, "Function doesn't return a value");
+			}
+			else {
+				infer_push(in, InferConstraint_Type, data.lhs, in->ret);
+			}
+		}
+		else if(in->ret != Type_Void && in->ret != Type_None){
+			infer_emit_error(in, node, CompilerError_TypeMismatch, "Missing return value");
+		}
+	break;
+
+	case Node_Break:
+	case Node_Continue:
+	case Node_None:
+	break;
+
+	default:
+		infer_expr(in, node, lo);
+	break;
+	}
+}
+
+/* Solve the constraints on the worklist for nodes [lo, hi] and record the
+ * results. Variables only live for the duration of the call. */
+static
+void infer_unit(Infer* in, u32 lo, u32 hi, NodeIndex let){
+	ArenaRegion region = arena_region_begin(in->scratch);
+	u32 count = hi - lo + 1;
+	in->vars = arena_make(in->scratch, InferVar, count);
+	ensure(in->vars != NULL, "Failed to allocate type variables");
+	for(u32 i = 0; i < count; i += 1){
+		in->vars[i] = (InferVar){ .parent = i };
+	}
+	in->var_base = lo;
+	in->var_end = hi + 1;
+
+	infer_solve(in);
+
+	for(NodeIndex node = lo; node <= hi; node += 1){
+		u32 root = infer_find(in, node);
+		in->node_types[node] = in->vars[root].type;
+
+		bool is_let = in->ast->tag[node] == Node_Let && (let == NODE_NONE || node == let);
+		if(is_let && in->vars[root].type == Type_None && !(in->vars[root].flags & InferFlag_Poison)){
+			String name = in->tokens[in->ast->main_token[node]].lexeme;
+			infer_emit_error(in, node, CompilerError_CannotInfer, "Can't infer the type of '%.*s'", str_fmt(name));
+		}
+	}
+
+	in->vars = NULL;
+	in->var_base = 0;
+	in->var_end = 0;
+	in->unit_lo = lo;
+	in->unit_hi = hi;
+	arena_region_end(region);
+}
+
+void infer_declarations(Infer* in, NodeIndex file){
+	Ast const* ast = in->ast;
+	NodeList items = ast_list(ast, ast->data[file].lhs);
+
+	for(u32 i = 0; i < items.len; i += 1){
+		NodeIndex fn = items.v[i];
+		if(ast->tag[fn] != Node_FnDecl){ continue; }
+
+		NodeData proto = ast->data[ast->data[fn].lhs];
+		NodeList params = ast_list(ast, proto.lhs);
+		TypeId small[16];
+		TypeId* ids = params.len <= 16 ? small : heap_alloc(params.len * sizeof(TypeId), alignof(TypeId));
+
+		bool ok = true;
+		for(u32 p = 0; p < params.len; p += 1){
+			ids[p] = infer_annotation(in, ast->data[params.v[p]].lhs);
+			in->node_types[params.v[p]] = ids[p];
+			ok = ok && ids[p] != Type_None;
+		}
+		TypeId ret = proto.rhs != NODE_NONE ? infer_annotation(in, proto.rhs) : Type_Void;
+		ok = ok && ret != Type_None;
+		in->node_types[fn] = ok ? type_fn(in->types, ids, params.len, ret) : Type_None;
+
+		if(ids != small){
+			heap_free(ids);
+		}
+	}
+
+	/* Globals in source order, each can use the ones before it */
+	for(u32 i = 0; i < items.len; i += 1){
+		NodeIndex let = items.v[i];
+		if(ast->tag[let] != Node_Let){ continue; }
+
+		u32 lo = let;
+		infer_let(in, let, &lo);
+		infer_unit(in, lo, let, let);
+	}
+}
+
+void infer_fn(Infer* in, NodeIndex fn){
+	Ast const* ast = in->ast;
+	NodeIndex body = ast->data[fn].rhs;
+	if(body == NODE_NONE || ast->tag[body] != Node_Block){
+		return;
+	}
+
+	TypeId sig = in->node_types[fn];
+	in->ret = sig != Type_None ? type_get(in->types, sig)->elem : Type_None;
+
+	u32 lo = body;
+	infer_stmt(in, body, &lo);
+	infer_unit(in, lo, body, NODE_NONE);
+}
+
+void infer_file(Infer* in, NodeIndex file){
+	infer_declarations(in, file);
+
+	NodeList items = ast_list(in->ast, in->ast->data[file].lhs);
+	for(u32 i = 0; i < items.len; i += 1){
+		if(in->ast->tag[items.v[i]] == Node_FnDecl){
+			infer_fn(in, items.v[i]);
+		}
+	}
+}
+
+#undef INFER_EXPR_DONE
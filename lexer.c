@@ -2,16 +2,47 @@
 
 str_attribute_format(3,4)
 void lexer_emit_error(Lexer* lex, CompilerErrorType errtype, char const * restrict fmt, ...) {
-	String s = {};
-	CompilerError* new_error = arena_make(lex->arena, CompilerError, 1);
-	new_error->type = errtype;
-	new_error->next = lex->error;
-	lex->error = new_error;
+	CompilerError new_error = {
+		.type = errtype,
+		.offset = lex->previous,
+	};
 
 	va_list argp;
 	va_start(argp, fmt);
-	new_error->message = str_vformat(lex->arena, fmt, argp);
+	new_error.message = str_vformat(lex->arena, fmt, argp);
 	va_end(argp);
+
+	dyn_array_push(&lex->errors, new_error);
+}
+
+Lexer lexer_create(String source, Arena* arena){
+	return (Lexer){
+		.source = source,
+		.errors = dyn_array_create(arena_allocator(arena)),
+		.arena = arena,
+		.valid_utf8 = utf8_validate(source.v, source.len) < 0,
+	};
+}
+
+LexerSnapshot lexer_snapshot(Lexer* lex){
+	return (LexerSnapshot){
+		.current = lex->current,
+		.previous = lex->previous,
+		.errors = lex->errors,
+		.region = arena_region_begin(lex->arena),
+	};
+}
+
+void lexer_restore(Lexer* lex, LexerSnapshot snap){
+	lex->current = snap.current;
+	lex->previous = snap.previous;
+	lex->errors = snap.errors;
+	arena_region_end(snap.region);
+}
+
+void lexer_commit(Lexer* lex, LexerSnapshot snap){
+	(void)lex;
+	arena_region_keep(snap.region);
 }
 
 static inline
@@ -24,9 +55,20 @@ bool is_decimal(rune c){
 	return (c >= '0' && c <= '9');
 }
 
+static inline
+bool is_identifier_start(rune c){
+	if(c < 0x80){
+		return is_alpha(c) || (c == '_');
+	}
+	return rune_is_xid_start(c);
+}
+
 static inline
 bool is_identifier(rune c){
-	return is_alpha(c) || is_decimal(c) || (c == '_');
+	if(c < 0x80){
+		return is_alpha(c) || is_decimal(c) || (c == '_');
+	}
+	return rune_is_xid_continue(c);
 }
 
 static inline
@@ -120,6 +162,9 @@ rune lexer_peek(Lexer* lex, isize delta){
 		return 0; /* OOB */
 	}
 
+	if(lex->valid_utf8){
+		return utf8_decode_unchecked(lex->source.v + pos).codepoint;
+	}
 	UTF8Decoded dec = utf8_decode(lex->source.v + pos, lex->source.len - pos);
 	return dec.codepoint;
 }
@@ -129,10 +174,12 @@ rune lexer_advance(Lexer* lex){
 		return 0; /* EOF */
 	}
 
-	UTF8Decoded dec = utf8_decode(lex->source.v + lex->current, lex->source.len - lex->current);
-	if(dec.codepoint == UTF8_ERROR){
-		lex->current += 1;
-		return UTF8_ERROR; /* Invalid char */
+	UTF8Decoded dec;
+	if(lex->valid_utf8){
+		dec = utf8_decode_unchecked(lex->source.v + lex->current);
+	} else {
+		/* Invalid sequences come back as UTF8_ERROR, one byte at a time */
+		dec = utf8_decode(lex->source.v + lex->current, lex->source.len - lex->current);
 	}
 
 	lex->current += dec.len;
@@ -194,15 +241,16 @@ Token lexer_match_number(Lexer* lex){
 		}
 
 		String digits = lexer_current_lexeme(lex);
-		i64 value = 0;
-		if(bad || !str_parse_i64(digits, base, &value)){
-			String bad_lexeme = str_sub(lex->source, lex->previous - 2, lex->current + 1);
+		u64 value = 0;
+		if(bad || !str_parse_u64(digits, base, &value)){
+			/* Prefix and the offending character, if there is one */
+			String bad_lexeme = str_sub(lex->source, lex->previous - 2, min(lex->current + 1, lex->source.len));
 			lexer_emit_error(lex, CompilerError_InvalidNumber, "Bad integer literal: '%.*s'", str_fmt(bad_lexeme));
 			res.type = Tk_Invalid;
 			return res;
 		}
 
-		res.value_integer = value;
+		res.value_integer = (i64)value;
 		res.type = Tk_Integer;
 		res.lexeme = digits;
 	}
@@ -246,12 +294,14 @@ Token lexer_match_number(Lexer* lex){
 			res.value_real = val;
 		}
 		else {
-			res.type = Tk_Integer;
-			i64 val = 0;
-			if(!str_parse_i64(digits, 10, &val)){
-				panic("bad decimal");
+			u64 val = 0;
+			if(!str_parse_u64(digits, 10, &val)){
+				lexer_emit_error(lex, CompilerError_InvalidNumber, "Integer literal doesn't fit in 64 bits: '%.*s'", str_fmt(digits));
+				res.type = Tk_Invalid;
+				return res;
 			}
-			res.value_integer = val;
+			res.type = Tk_Integer;
+			res.value_integer = (i64)val;
 		}
 	}
 
@@ -276,7 +326,7 @@ Token lexer_match_identifier_or_keyword(Lexer* lex){
 	Token res = {
 		.type = Tk_Id,
 	};
-	ensure(is_identifier(lexer_peek(lex, 0)), "Lexer is not on an identifier");
+	ensure(is_identifier_start(lexer_peek(lex, 0)), "Lexer is not on an identifier");
 
 	for(;;){
 		rune c = lexer_advance(lex);
@@ -309,13 +359,16 @@ Token lexer_next(Lexer* lex){
 		.type = Tk_Unknown,
 	};
 
+	isize start = lex->current;
 	rune c = lexer_advance(lex);
 	while(is_whitespace(c) && c != 0){
+		start = lex->current;
 		c = lexer_advance(lex);
 	}
 
 	if(c == 0){
 		res.type = Tk_EndOfFile;
+		res.lexeme = str_sub(lex->source, lex->source.len, lex->source.len);
 		return res;
 	}
 
@@ -342,7 +395,8 @@ Token lexer_next(Lexer* lex){
 		if(!is_identifier(lexer_peek(lex, 0))){
 			res.type = Tk_Underscore;
 		} else {
-			unimplemented("Identifier");
+			lex->current -= 1;
+			res = lexer_match_identifier_or_keyword(lex);
 		}
 	break;
 
@@ -409,40 +463,97 @@ Token lexer_next(Lexer* lex){
 			lex->current -= utf8_rune_size(c);
 			res = lexer_match_number(lex);
 		}
-		else if(is_identifier(c)){
+		else if(is_identifier_start(c)){
 			lex->current -= utf8_rune_size(c);
 			res = lexer_match_identifier_or_keyword(lex);
 		}
+		else if(c == UTF8_ERROR && lex->current - start == 1){
+			lex->previous = start;
+			lexer_emit_error(lex, CompilerError_InvalidEncoding, "Invalid UTF-8 byte 0x%02x", lex->source.v[lex->previous]);
+			res.type = Tk_Invalid;
+		}
 		else {
-			panic("bah");
+			lex->previous = start;
+			lexer_emit_error(lex, CompilerError_UnknownToken, "Unexpected character U+%04X", (u32)c);
+			res.type = Tk_Invalid;
 		}
 	break;
 	}
 
+	/* Every token keeps its source text, for diagnostics */
+	if(res.lexeme.v == NULL){
+		res.lexeme = str_sub(lex->source, start, lex->current);
+	}
+	return res;
+}
+
+LexerResult lexer_tokenize(Lexer* lex, Allocator allocator){
+	LexerResult res = {
+		.tokens = dyn_array_create(allocator),
+	};
+
+	/* Rough guess of one token per 4 bytes, to skip the first few doublings */
+	dyn_array_reserve(&res.tokens, lex->source.len / 4 + 1);
+
+	for(;;){
+		Token token = lexer_next(lex);
+		dyn_array_push(&res.tokens, token);
+		if(token.type == Tk_EndOfFile){ break; }
+	}
+
+	res.errors = lex->errors;
 	return res;
 }
 
 String token_format(Token t, Arena* arena){
-	ensure(t.type >= 0 && t.type < Tk__COUNT, "Invalid type value");
+	ensure(t.type < Tk__COUNT, "Invalid type value");
+
+	/* Big enough for the widest token, so the writer never flushes */
+	String payload = t.type == Tk_String ? t.value_string : t.lexeme;
+	isize cap = WRITER_NUMBER_MAX + 8 + max(payload.len, token_type_name[t.type].len);
+	byte* buf = arena_alloc(arena, cap, 1);
+
+	Writer w = writer_create(-1, buf, cap);
+	token_write(t, &w);
+	ensure(!w.failed, "Token did not fit its buffer");
+
+	arena_resize_in_place(arena, buf, w.len);
+	return (String){ .v = buf, .len = w.len };
+}
+
+void token_write(Token t, Writer* w){
+	ensure(t.type < Tk__COUNT, "Invalid type value");
 
 	if(t.type == Tk_Integer){
-		return str_format(arena, "Int(%td)", t.value_integer);
+		writer_append(w, str_lit("Int("));
+		writer_append_u64(w, (u64)t.value_integer);
+		writer_append_byte(w, ')');
+		return;
 	}
 	if(t.type == Tk_Real){
-		return str_format(arena, "Real(%g)", t.value_real);
+		writer_append(w, str_lit("Real("));
+		writer_append_f64(w, t.value_real);
+		writer_append_byte(w, ')');
+		return;
 	}
 	if(t.type == Tk_String){
-		return str_format(arena, "Str(\"%.*s\")", str_fmt(t.value_string));
+		writer_append(w, str_lit("Str(\""));
+		writer_append(w, t.value_string);
+		writer_append(w, str_lit("\")"));
+		return;
 	}
 	if(t.type == Tk_Char){
-		return str_format(arena, "Char(%d)", t.value_char);
+		writer_append(w, str_lit("Char("));
+		writer_append_i64(w, t.value_char);
+		writer_append_byte(w, ')');
+		return;
 	}
 	if(t.type == Tk_Id){
-		return str_format(arena, "Id(%.*s)", str_fmt(t.lexeme));
+		writer_append(w, str_lit("Id("));
+		writer_append(w, t.lexeme);
+		writer_append_byte(w, ')');
+		return;
 	}
 
-	String name = token_type_name[t.type];
-	return str_format(arena, "%.*s", str_fmt(name));
+	writer_append(w, token_type_name[t.type]);
 }
-
-
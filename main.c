@@ -16,33 +16,35 @@ int main(){
 		" 69.420e-5"
 	);
 
-	isize temp_size = 24 * mem_kilobyte;
 	isize arena_size = 128 * mem_kilobyte;
+	isize output_size = 256 * mem_kilobyte;
 
 	byte* arena_mem = heap_alloc(arena_size, alignof(void*));
-	byte* temp_mem = heap_alloc(temp_size, alignof(void*));
+	byte* output_mem = heap_alloc(output_size, alignof(void*));
 
 	Arena arena = arena_create_buffer(arena_mem, arena_size);
-	Arena temp_arena = arena_create_buffer(temp_mem, temp_size);
-
-	Lexer lex = {
-		.source = s,
-		.arena = &arena,
-	};
-
-	for(Token token = lexer_next(&lex);
-		token.type != Tk_EndOfFile;
-		token = lexer_next(&lex))
-	{
-		printf("%s\n", token_format(token, &temp_arena).v);
-		arena_reset(&temp_arena);
+	Writer out = writer_create(1, output_mem, output_size);
+
+	/* Tokens get an arena of their own so the array can always grow in place.
+	 * Every token but the last covers at least one byte of source, so the
+	 * array never needs more than twice that many slots while doubling. */
+	isize token_arena_size = (2 * (s.len + 1) + 8) * (isize)sizeof(Token);
+	Arena token_arena = arena_create_mapped(token_arena_size, MemPages_Default, NULL);
+
+	Lexer lex = lexer_create(s, &arena);
+	LexerResult lexed = lexer_tokenize(&lex, arena_allocator(&token_arena));
+
+	for(isize i = 0; lexed.tokens.v[i].type != Tk_EndOfFile; i += 1){
+		token_write(lexed.tokens.v[i], &out);
+		writer_append_byte(&out, '\n');
 	}
 
-	for(CompilerError* error = lex.error;
-		error != NULL;
-		error = error->next)
-	{
-		printf("\e[31mError\e[0m: %.*s\n", str_fmt(error->message));
+	for(isize i = 0; i < lexed.errors.len; i += 1){
+		writer_append(&out, str_lit("\e[31mError\e[0m: "));
+		writer_append(&out, lexed.errors.v[i].message);
+		writer_append_byte(&out, '\n');
 	}
-}
 
+	writer_flush(&out);
+	arena_destroy_mapped(&token_arena);
+}
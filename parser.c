@@ -0,0 +1,606 @@
+#include "cx.h"
+
+/* Binding powers, Go style: five binary levels and right associative
+ * assignment. A pair is {left, right}: an operator only takes the expression
+ * on its left when its left power is at least the current minimum, and parses
+ * its right side with the right power as the new minimum. */
+#define PARSER_BP_PREFIX  15
+#define PARSER_BP_POSTFIX 17
+
+static const u8 parser_infix_bp[Tk__COUNT][2] = {
+	[Tk_Assign]   = {2, 1},
+	[Tk_AssignOp] = {2, 1},
+
+	[Tk_LogicOr]  = {3, 4},
+	[Tk_LogicAnd] = {5, 6},
+
+	[Tk_Eq]   = {7, 8},
+	[Tk_NotEq] = {7, 8},
+	[Tk_Gt]   = {7, 8},
+	[Tk_Lt]   = {7, 8},
+	[Tk_GtEq] = {7, 8},
+	[Tk_LtEq] = {7, 8},
+
+	[Tk_Plus]  = {11, 12},
+	[Tk_Minus] = {11, 12},
+	[Tk_Or]    = {11, 12},
+
+	[Tk_Star]    = {13, 14},
+	[Tk_Slash]   = {13, 14},
+	[Tk_Modulo]  = {13, 14},
+	[Tk_And]     = {13, 14},
+	[Tk_ShLeft]  = {13, 14},
+	[Tk_ShRight] = {13, 14},
+};
+
+static const bool parser_prefix_op[Tk__COUNT] = {
+	[Tk_Minus] = true,
+	[Tk_Plus]  = true,
+	[Tk_Tilde] = true,
+	[Tk_Bang]  = true,
+};
+
+static const u8 parser_leaf_tag[Tk__COUNT] = {
+	[Tk_Integer] = Node_Integer,
+	[Tk_Real]    = Node_Real,
+	[Tk_String]  = Node_String,
+	[Tk_Char]    = Node_Char,
+	[Tk_True]    = Node_Bool,
+	[Tk_False]   = Node_Bool,
+	[Tk_Nil]     = Node_Nil,
+	[Tk_Id]      = Node_Identifier,
+};
+
+void parser_emit_error(Parser* p, CompilerErrorType errtype, char const * restrict fmt, ...){
+	Token const* tok = &p->tokens[p->current];
+	CompilerError new_error = {
+		.type = errtype,
+		.offset = tok->lexeme.v - p->source.v,
+	};
+
+	va_list argp;
+	va_start(argp, fmt);
+	new_error.message = str_vformat(p->arena, fmt, argp);
+	va_end(argp);
+
+	dyn_array_push(&p->errors, new_error);
+}
+
+Parser parser_create(String source, TokenArray tokens, Ast* ast, Arena* arena){
+	ensure(tokens.len == 0 || tokens.v[tokens.len - 1].type == Tk_EndOfFile, "Token array must end with EndOfFile");
+	ensure(tokens.len <= UINT32_MAX, "Too many tokens");
+	ensure(ast->allocator.impl != arena, "AST must not share the parser arena");
+	return (Parser){
+		.source = source,
+		.tokens = tokens.v,
+		.token_count = (u32)tokens.len,
+		.ast = ast,
+		.errors = dyn_array_create(arena_allocator(arena)),
+		.arena = arena,
+		.stack = dyn_array_create(heap_allocator()),
+		.scratch = dyn_array_create(heap_allocator()),
+		.body_patches = dyn_array_create(heap_allocator()),
+	};
+}
+
+void parser_destroy(Parser* p){
+	dyn_array_destroy(&p->stack);
+	dyn_array_destroy(&p->scratch);
+	dyn_array_destroy(&p->body_patches);
+}
+
+ParserSnapshot parser_snapshot(Parser* p){
+	p->snapshot_depth += 1;
+	return (ParserSnapshot){
+		.current = p->current,
+		.node_count = p->ast->len,
+		.extra_len = (u32)p->ast->extra.len,
+		.patch_len = (u32)p->body_patches.len,
+		.errors = p->errors,
+		.region = arena_region_begin(p->arena),
+	};
+}
+
+void parser_restore(Parser* p, ParserSnapshot snap){
+	ensure(p->snapshot_depth > 0, "No open snapshot");
+	ensure(p->ast->len >= snap.node_count, "AST shrank below snapshot");
+
+	/* Newest first, so a body patched twice ends up with its oldest value */
+	for(isize i = p->body_patches.len - 2; i >= snap.patch_len; i -= 2){
+		NodeIndex fn = p->body_patches.v[i];
+		if(fn < snap.node_count){
+			p->ast->data[fn].rhs = p->body_patches.v[i + 1];
+		}
+	}
+	p->body_patches.len = snap.patch_len;
+	p->snapshot_depth -= 1;
+
+	p->current = snap.current;
+	p->ast->len = snap.node_count;
+	p->ast->extra.len = snap.extra_len;
+	p->errors = snap.errors;
+	arena_region_end(snap.region);
+}
+
+void parser_commit(Parser* p, ParserSnapshot snap){
+	ensure(p->snapshot_depth > 0, "No open snapshot");
+	p->snapshot_depth -= 1;
+	/* Nothing left to undo them for */
+	if(p->snapshot_depth == 0){
+		p->body_patches.len = 0;
+	}
+	arena_region_keep(snap.region);
+}
+
+static inline
+u32 parser_peek(Parser const* p){
+	return p->tokens[p->current].type;
+}
+
+/* Pull the next batch from the lexer thread, blocks until it is there */
+static
+void parser_refill(Parser* p){
+	if(p->token_count > 0 && p->tokens[p->token_count - 1].type == Tk_EndOfFile){
+		return;
+	}
+	TokenBatch* batch = token_ring_begin_read(p->ring);
+	dyn_array_append(p->stream_tokens, batch->tokens, batch->len);
+	token_ring_end_read(p->ring);
+
+	ensure(p->stream_tokens->len <= UINT32_MAX, "Too many tokens");
+	p->tokens = p->stream_tokens->v;
+	p->token_count = (u32)p->stream_tokens->len;
+}
+
+/* Never moves past EndOfFile */
+static inline
+u32 parser_advance(Parser* p){
+	u32 index = p->current;
+	if(p->current + 1 >= p->token_count && p->ring != NULL){
+		parser_refill(p);
+	}
+	if(p->current + 1 < p->token_count){
+		p->current += 1;
+	}
+	return index;
+}
+
+static inline
+bool parser_expect(Parser* p, TokenType type, char const* what){
+	if(parser_peek(p) == type){
+		parser_advance(p);
+		return true;
+	}
+	String got = p->tokens[p->current].lexeme;
+	parser_emit_error(p, CompilerError_UnexpectedToken, "Expected %s, got '%.*s'", what, str_fmt(got));
+	return false;
+}
+
+static inline
+void parser_push_frame(Parser* p, ParserFrameKind kind, u8 min_bp, u32 op_token, NodeIndex lhs){
+	ParserFrame frame = {
+		.kind = (u8)kind,
+		.min_bp = min_bp,
+		.op_token = op_token,
+		.lhs = lhs,
+		.args_start = (u32)p->scratch.len,
+	};
+	dyn_array_push(&p->stack, frame);
+}
+
+/* Pratt parsing with the recursion turned into an explicit stack. Every place
+ * the recursive version would call itself for a sub-expression pushes a frame
+ * and goes back to parsing an operand; once no operator can extend the current
+ * expression, the top frame is popped and completed with it. */
+NodeIndex parser_parse_expr(Parser* p){
+	Ast* ast = p->ast;
+	isize base = p->stack.len;
+	u8 min_bp = 0;
+	NodeIndex lhs = NODE_NONE;
+
+	for(;;){
+		/* Operand: prefix operators and groups, then a leaf */
+		u32 type = parser_peek(p);
+		if(parser_prefix_op[type]){
+			parser_push_frame(p, ParserFrame_Prefix, min_bp, parser_advance(p), NODE_NONE);
+			min_bp = PARSER_BP_PREFIX;
+			continue;
+		}
+		if(type == Tk_ParenOpen){
+			parser_push_frame(p, ParserFrame_Group, min_bp, parser_advance(p), NODE_NONE);
+			min_bp = 0;
+			continue;
+		}
+		if(parser_leaf_tag[type] != Node_None){
+			u32 token = parser_advance(p);
+			lhs = ast_add_node(ast, parser_leaf_tag[type], token, 0, 0);
+		}
+		else {
+			String got = p->tokens[p->current].lexeme;
+			parser_emit_error(p, CompilerError_UnexpectedToken, "Expected expression, got '%.*s'", str_fmt(got));
+			lhs = NODE_NONE;
+		}
+
+		/* Extend lhs with postfix and infix operators, completing frames
+		 * whenever it can't be extended. Breaking out parses a new operand. */
+		bool need_operand = false;
+		while(!need_operand){
+			type = parser_peek(p);
+
+			if(PARSER_BP_POSTFIX >= min_bp && (type == Tk_Dot || type == Tk_SquareOpen || type == Tk_ParenOpen)){
+				u32 op = parser_advance(p);
+				if(type == Tk_Dot){
+					u32 name = p->current;
+					if(parser_expect(p, Tk_Id, "member name")){
+						lhs = ast_add_node(ast, Node_Member, op, lhs, name);
+					}
+				}
+				else if(type == Tk_SquareOpen){
+					parser_push_frame(p, ParserFrame_Index, min_bp, op, lhs);
+					min_bp = 0;
+					need_operand = true;
+				}
+				else if(parser_peek(p) == Tk_ParenClose){
+					parser_advance(p);
+					lhs = ast_add_node(ast, Node_Call, op, lhs, ast_add_list(ast, NULL, 0));
+				}
+				else {
+					parser_push_frame(p, ParserFrame_Call, min_bp, op, lhs);
+					min_bp = 0;
+					need_operand = true;
+				}
+				continue;
+			}
+
+			u8 left_bp = parser_infix_bp[type][0];
+			if(left_bp != 0 && left_bp >= min_bp){
+				parser_push_frame(p, ParserFrame_Infix, min_bp, parser_advance(p), lhs);
+				min_bp = parser_infix_bp[type][1];
+				need_operand = true;
+				continue;
+			}
+
+			if(p->stack.len == base){
+				return lhs;
+			}
+
+			ParserFrame frame = dyn_array_pop(&p->stack);
+			min_bp = frame.min_bp;
+			switch((ParserFrameKind)frame.kind){
+			case ParserFrame_Prefix:
+				lhs = ast_add_node(ast, Node_Unary, frame.op_token, lhs, 0);
+			break;
+			case ParserFrame_Infix: {
+				u32 op = p->tokens[frame.op_token].type;
+				NodeTag tag = (op == Tk_Assign || op == Tk_AssignOp) ? Node_Assign : Node_Binary;
+				lhs = ast_add_node(ast, tag, frame.op_token, frame.lhs, lhs);
+			} break;
+			case ParserFrame_Group:
+				parser_expect(p, Tk_ParenClose, "')'");
+			break;
+			case ParserFrame_Index:
+				parser_expect(p, Tk_SquareClose, "']'");
+				lhs = ast_add_node(ast, Node_Index, frame.op_token, frame.lhs, lhs);
+			break;
+			case ParserFrame_Call: {
+				dyn_array_push(&p->scratch, lhs);
+				if(parser_peek(p) == Tk_Comma){
+					/* Next argument, the frame stays */
+					parser_advance(p);
+					dyn_array_push(&p->stack, frame);
+					min_bp = 0;
+					need_operand = true;
+					break;
+				}
+				parser_expect(p, Tk_ParenClose, "')'");
+				u32 args = ast_add_list(ast, p->scratch.v + frame.args_start, (u32)(p->scratch.len - frame.args_start));
+				p->scratch.len = frame.args_start;
+				lhs = ast_add_node(ast, Node_Call, frame.op_token, frame.lhs, args);
+			} break;
+			}
+		}
+	}
+}
+
+static inline
+bool parser_at_type(Parser const* p){
+	u32 type = parser_peek(p);
+	return type == Tk_Id || type == Tk_Star || type == Tk_SquareOpen || type == Tk_Fn;
+}
+
+/* ( T, T, ... ) for fn types, or ( name: T, ... ) for declarations. Returns
+ * the extra list. */
+static
+u32 parser_parse_params(Parser* p, bool named){
+	isize start = p->scratch.len;
+	parser_expect(p, Tk_ParenOpen, "'('");
+
+	while(parser_peek(p) != Tk_ParenClose && parser_peek(p) != Tk_EndOfFile){
+		NodeIndex item = NODE_NONE;
+		if(named){
+			u32 name = p->current;
+			parser_expect(p, Tk_Id, "parameter name");
+			parser_expect(p, Tk_Colon, "':'");
+			item = ast_add_node(p->ast, Node_Param, name, parser_parse_type(p), 0);
+		}
+		else {
+			item = parser_parse_type(p);
+		}
+		dyn_array_push(&p->scratch, item);
+
+		if(parser_peek(p) != Tk_Comma){
+			break;
+		}
+		parser_advance(p);
+	}
+	parser_expect(p, Tk_ParenClose, "')'");
+
+	u32 list = ast_add_list(p->ast, p->scratch.v + start, (u32)(p->scratch.len - start));
+	p->scratch.len = start;
+	return list;
+}
+
+/* Prefix operators are collected on scratch as (token, length) pairs and
+ * turned into nodes once the type they apply to is parsed, so a long run of
+ * them doesn't recurse. Nodes still come out operands first. */
+NodeIndex parser_parse_type(Parser* p){
+	Ast* ast = p->ast;
+	isize start = p->scratch.len;
+
+	for(;;){
+		u32 kind = parser_peek(p);
+		if(kind != Tk_Star && kind != Tk_SquareOpen){
+			break;
+		}
+		u32 op = parser_advance(p);
+		NodeIndex len = NODE_NONE;
+		if(kind == Tk_SquareOpen){
+			if(parser_peek(p) != Tk_SquareClose){
+				len = parser_parse_expr(p);
+			}
+			parser_expect(p, Tk_SquareClose, "']'");
+		}
+		dyn_array_push(&p->scratch, op);
+		dyn_array_push(&p->scratch, len);
+	}
+
+	NodeIndex type = NODE_NONE;
+	switch(parser_peek(p)){
+	case Tk_Id:
+		type = ast_add_node(ast, Node_TypeName, parser_advance(p), 0, 0);
+	break;
+
+	case Tk_Fn: {
+		u32 op = parser_advance(p);
+		u32 params = parser_parse_params(p, false);
+		NodeIndex ret = parser_at_type(p) ? parser_parse_type(p) : NODE_NONE;
+		type = ast_add_node(ast, Node_TypeFn, op, params, ret);
+	} break;
+
+	default: {
+		String got = p->tokens[p->current].lexeme;
+		parser_emit_error(p, CompilerError_UnexpectedToken, "Expected type, got '%.*s'", str_fmt(got));
+	} break;
+	}
+
+	while(p->scratch.len > start){
+		NodeIndex len = dyn_array_pop(&p->scratch);
+		u32 op = dyn_array_pop(&p->scratch);
+		if(p->tokens[op].type == Tk_Star){
+			type = ast_add_node(ast, Node_TypePointer, op, type, 0);
+		}
+		else {
+			type = ast_add_node(ast, Node_TypeArray, op, len, type);
+		}
+	}
+	return type;
+}
+
+/* let name: T = value; */
+static
+NodeIndex parser_parse_let(Parser* p){
+	parser_advance(p);
+	u32 name = p->current;
+	parser_expect(p, Tk_Id, "variable name");
+
+	NodeIndex type = NODE_NONE;
+	NodeIndex value = NODE_NONE;
+	if(parser_peek(p) == Tk_Colon){
+		parser_advance(p);
+		type = parser_parse_type(p);
+	}
+	if(parser_peek(p) == Tk_Assign){
+		parser_advance(p);
+		value = parser_parse_expr(p);
+	}
+	parser_expect(p, Tk_Semicolon, "';'");
+	return ast_add_node(p->ast, Node_Let, name, type, value);
+}
+
+static
+NodeIndex parser_parse_if(Parser* p){
+	u32 op = parser_advance(p);
+	NodeIndex cond = parser_parse_expr(p);
+	u32 branches[2] = { parser_parse_block(p), NODE_NONE };
+
+	if(parser_peek(p) == Tk_Else){
+		parser_advance(p);
+		branches[1] = parser_peek(p) == Tk_If ? parser_parse_if(p) : parser_parse_block(p);
+	}
+	return ast_add_node(p->ast, Node_If, op, cond, ast_add_list(p->ast, branches, 2));
+}
+
+NodeIndex parser_parse_stmt(Parser* p){
+	Ast* ast = p->ast;
+	switch(parser_peek(p)){
+	case Tk_Let:
+		return parser_parse_let(p);
+
+	case Tk_CurlyOpen:
+		return parser_parse_block(p);
+
+	case Tk_If:
+		return parser_parse_if(p);
+
+	case Tk_For: {
+		u32 op = parser_advance(p);
+		NodeIndex cond = NODE_NONE;
+		if(parser_peek(p) != Tk_CurlyOpen){
+			cond = parser_parse_expr(p);
+		}
+		return ast_add_node(ast, Node_For, op, cond, parser_parse_block(p));
+	}
+
+	case Tk_Return: {
+		u32 op = parser_advance(p);
+		NodeIndex value = NODE_NONE;
+		if(parser_peek(p) != Tk_Semicolon){
+			value = parser_parse_expr(p);
+		}
+		parser_expect(p, Tk_Semicolon, "';'");
+		return ast_add_node(ast, Node_Return, op, value, 0);
+	}
+
+	case Tk_Break:
+	case Tk_Continue: {
+		NodeTag tag = parser_peek(p) == Tk_Break ? Node_Break : Node_Continue;
+		u32 op = parser_advance(p);
+		parser_expect(p, Tk_Semicolon, "';'");
+		return ast_add_node(ast, tag, op, 0, 0);
+	}
+	}
+
+	NodeIndex expr = parser_parse_expr(p);
+	parser_expect(p, Tk_Semicolon, "';'");
+	return expr;
+}
+
+NodeIndex parser_parse_block(Parser* p){
+	u32 open = p->current;
+	if(!parser_expect(p, Tk_CurlyOpen, "'{'")){
+		return NODE_NONE;
+	}
+
+	isize start = p->scratch.len;
+	while(parser_peek(p) != Tk_CurlyClose && parser_peek(p) != Tk_EndOfFile){
+		u32 before = p->current;
+		NodeIndex stmt = parser_parse_stmt(p);
+		if(stmt != NODE_NONE){
+			dyn_array_push(&p->scratch, stmt);
+		}
+		if(p->current == before){
+			parser_advance(p); /* Always make progress */
+		}
+	}
+	parser_expect(p, Tk_CurlyClose, "'}'");
+
+	u32 stmts = ast_add_list(p->ast, p->scratch.v + start, (u32)(p->scratch.len - start));
+	p->scratch.len = start;
+	return ast_add_node(p->ast, Node_Block, open, stmts, 0);
+}
+
+/* Find the matching '}' by counting braces, nothing inside is looked at */
+static
+NodeIndex parser_skip_body(Parser* p){
+	u32 open = p->current;
+	if(!parser_expect(p, Tk_CurlyOpen, "'{'")){
+		return NODE_NONE;
+	}
+
+	/* Scan what has been lexed so far directly, a streaming parser only
+	 * refills once it runs off the end */
+	u32 depth = 1;
+	u32 i = p->current;
+	for(;;){
+		Token const* tokens = p->tokens;
+		u32 end = p->token_count;
+		for(; i < end; i += 1){
+			u32 type = tokens[i].type;
+			depth += (type == Tk_CurlyOpen);
+			depth -= (type == Tk_CurlyClose);
+			if(depth == 0 || type == Tk_EndOfFile){
+				break;
+			}
+		}
+		if(i < end){
+			break;
+		}
+		parser_refill(p);
+	}
+
+	p->current = i;
+	if(parser_peek(p) == Tk_EndOfFile){
+		parser_emit_error(p, CompilerError_UnexpectedToken, "Unclosed '{' in function body");
+		return NODE_NONE;
+	}
+	u32 close = parser_advance(p);
+	return ast_add_node(p->ast, Node_LazyBody, open, open, close);
+}
+
+/* fn name(a: T, b: T) R { body } */
+static
+NodeIndex parser_parse_fn(Parser* p){
+	u32 op = parser_advance(p);
+	u32 name = p->current;
+	parser_expect(p, Tk_Id, "function name");
+
+	u32 params = parser_parse_params(p, true);
+	NodeIndex ret = parser_at_type(p) ? parser_parse_type(p) : NODE_NONE;
+	NodeIndex proto = ast_add_node(p->ast, Node_FnProto, op, params, ret);
+
+	NodeIndex body = p->lazy_bodies ? parser_skip_body(p) : parser_parse_block(p);
+	return ast_add_node(p->ast, Node_FnDecl, name, proto, body);
+}
+
+NodeIndex parser_parse_file(Parser* p){
+	isize start = p->scratch.len;
+	while(parser_peek(p) != Tk_EndOfFile){
+		u32 type = parser_peek(p);
+		NodeIndex item = NODE_NONE;
+		if(type == Tk_Fn){
+			item = parser_parse_fn(p);
+		}
+		else if(type == Tk_Let){
+			item = parser_parse_let(p);
+		}
+		else {
+			String got = p->tokens[p->current].lexeme;
+			parser_emit_error(p, CompilerError_UnexpectedToken, "Expected declaration, got '%.*s'", str_fmt(got));
+			/* Resynchronize on the next declaration */
+			while(parser_peek(p) != Tk_Fn && parser_peek(p) != Tk_Let && parser_peek(p) != Tk_EndOfFile){
+				parser_advance(p);
+			}
+			continue;
+		}
+		dyn_array_push(&p->scratch, item);
+	}
+
+	u32 items = ast_add_list(p->ast, p->scratch.v + start, (u32)(p->scratch.len - start));
+	p->scratch.len = start;
+	return ast_add_node(p->ast, Node_File, 0, items, 0);
+}
+
+NodeIndex parser_parse_body(Parser* p, NodeIndex fn){
+	Ast* ast = p->ast;
+	ensure(fn < ast->len && ast->tag[fn] == Node_FnDecl, "Not a function declaration");
+
+	NodeIndex body = ast->data[fn].rhs;
+	if(body == NODE_NONE || ast->tag[body] != Node_LazyBody){
+		return body;
+	}
+
+	u32 saved = p->current;
+	p->current = ast->data[body].lhs;
+	NodeIndex block = parser_parse_block(p);
+	p->current = saved;
+
+	if(p->snapshot_depth > 0){
+		dyn_array_push(&p->body_patches, fn);
+		dyn_array_push(&p->body_patches, body);
+	}
+	ast->data[fn].rhs = block;
+	return block;
+}
+
+#undef PARSER_BP_PREFIX
+#undef PARSER_BP_POSTFIX
@@ -0,0 +1,120 @@
+#include "cx.h"
+
+#define TOKEN_RING_SPIN 64 /* Busy polls before yielding the thread */
+
+//// Token ring
+void token_ring_init(TokenRing* ring, Allocator allocator, u32 count){
+	ensure(count > 0 && (count & (count - 1)) == 0, "Ring size must be a power of 2");
+	ring->batches = mem_alloc(allocator, count * sizeof(TokenBatch), alignof(TokenBatch));
+	ensure(ring->batches != NULL, "Failed to allocate token ring");
+	ring->count = count;
+	ring->allocator = allocator;
+	atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+}
+
+void token_ring_destroy(TokenRing* ring){
+	mem_free(ring->allocator, ring->batches, ring->count * sizeof(TokenBatch));
+	ring->batches = NULL;
+	ring->count = 0;
+}
+
+static inline
+void token_ring_backoff(u32* spins){
+	*spins += 1;
+	if(*spins >= TOKEN_RING_SPIN){
+		thread_yield();
+	}
+}
+
+/* Head and tail only ever increase, tail - head is the number of published
+ * batches (wrapping u32 arithmetic keeps that true) */
+
+TokenBatch* token_ring_begin_write(TokenRing* ring){
+	u32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	u32 spins = 0;
+	while(tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= ring->count){
+		token_ring_backoff(&spins);
+	}
+	TokenBatch* batch = &ring->batches[tail & (ring->count - 1)];
+	batch->len = 0;
+	return batch;
+}
+
+void token_ring_end_write(TokenRing* ring){
+	u32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+TokenBatch* token_ring_begin_read(TokenRing* ring){
+	u32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	u32 spins = 0;
+	while(atomic_load_explicit(&ring->tail, memory_order_acquire) == head){
+		token_ring_backoff(&spins);
+	}
+	return &ring->batches[head & (ring->count - 1)];
+}
+
+void token_ring_end_read(TokenRing* ring){
+	u32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+//// Lexer -> parser pipeline
+typedef struct {
+	Lexer* lex;
+	TokenRing* ring;
+} PipelineLexer;
+
+static
+void pipeline_lex(void* arg){
+	PipelineLexer* job = arg;
+	bool done = false;
+	while(!done){
+		TokenBatch* batch = token_ring_begin_write(job->ring);
+		while(batch->len < TOKEN_BATCH_SIZE){
+			Token token = lexer_next(job->lex);
+			batch->tokens[batch->len] = token;
+			batch->len += 1;
+			if(token.type == Tk_EndOfFile){
+				done = true;
+				break;
+			}
+		}
+		token_ring_end_write(job->ring);
+	}
+}
+
+NodeIndex parser_parse_file_streaming(Parser* p, Lexer* lex, TokenArray* tokens){
+	ensure(lex->arena != p->arena, "Lexer and parser need separate arenas");
+	ensure(tokens->allocator.impl != p->arena, "Tokens must not share the parser arena");
+
+	TokenRing ring;
+	token_ring_init(&ring, heap_allocator(), 8);
+
+	/* Same guess as lexer_tokenize */
+	dyn_array_clear(tokens);
+	dyn_array_reserve(tokens, lex->source.len / 4 + 1);
+
+	PipelineLexer job = { .lex = lex, .ring = &ring };
+	Thread lexer_thread;
+	ensure(thread_create(&lexer_thread, pipeline_lex, &job), "Failed to start lexer thread");
+
+	p->ring = &ring;
+	p->stream_tokens = tokens;
+	p->tokens = tokens->v;
+	p->token_count = 0;
+	p->current = 0;
+	parser_refill(p);
+
+	NodeIndex root = parser_parse_file(p);
+
+	/* The parser stops at EndOfFile, which is the last batch */
+	thread_join(&lexer_thread);
+	token_ring_destroy(&ring);
+	p->ring = NULL;
+	p->stream_tokens = NULL;
+	return root;
+}
+
+#undef TOKEN_RING_SPIN
@@ -0,0 +1,310 @@
+#include "cx.h"
+
+//// Symbol table
+SymbolTable symbol_table_create(Arena* arena, Allocator allocator){
+	return (SymbolTable){
+		.arena = arena,
+		.current = NULL,
+		.visible = dyn_array_create(allocator),
+	};
+}
+
+void symbol_table_destroy(SymbolTable* t){
+	while(t->current != NULL){
+		symbol_scope_pop(t);
+	}
+	dyn_array_destroy(&t->visible);
+}
+
+void symbol_scope_push(SymbolTable* t){
+	ArenaRegion region = arena_region_begin(t->arena);
+	Scope* scope = arena_make(t->arena, Scope, 1);
+	ensure(scope != NULL, "Failed to allocate scope");
+
+	*scope = (Scope){
+		.parent = t->current,
+		.depth = t->current != NULL ? t->current->depth + 1 : 0,
+		.region = region,
+	};
+	t->current = scope;
+}
+
+void symbol_scope_pop(SymbolTable* t){
+	Scope* scope = t->current;
+	ensure(scope != NULL, "No scope to pop");
+
+	for(Symbol* sym = scope->symbols; sym != NULL; sym = sym->next){
+		t->visible.v[sym->name] = sym->shadowed;
+	}
+	t->current = scope->parent;
+	arena_region_end(scope->region);
+}
+
+Symbol* symbol_declare(SymbolTable* t, Atom name, NodeIndex decl){
+	Scope* scope = t->current;
+	ensure(scope != NULL, "No scope to declare in");
+
+	if(name >= t->visible.len){
+		isize new_len = max((isize)name + 1, t->visible.len * 2);
+		ensure(dyn_array_reserve(&t->visible, new_len), "Failed to grow symbol table");
+		mem_set(t->visible.v + t->visible.len, 0, (new_len - t->visible.len) * sizeof(Symbol*));
+		t->visible.len = new_len;
+	}
+
+	Symbol* outer = t->visible.v[name];
+	if(outer != NULL && outer->depth == scope->depth){
+		return NULL;
+	}
+
+	Symbol* sym = arena_make(t->arena, Symbol, 1);
+	ensure(sym != NULL, "Failed to allocate symbol");
+	*sym = (Symbol){
+		.name = name,
+		.depth = scope->depth,
+		.decl = decl,
+		.shadowed = outer,
+		.next = scope->symbols,
+	};
+	scope->symbols = sym;
+	t->visible.v[name] = sym;
+	return sym;
+}
+
+//// Name resolution
+void resolver_emit_error(Resolver* r, u32 token, CompilerErrorType errtype, char const * restrict fmt, ...){
+	CompilerError new_error = {
+		.type = errtype,
+		.offset = r->tokens[token].lexeme.v - r->source.v,
+	};
+
+	va_list argp;
+	va_start(argp, fmt);
+	new_error.message = str_vformat(r->arena, fmt, argp);
+	va_end(argp);
+
+	dyn_array_push(&r->errors, new_error);
+}
+
+Resolver resolver_create(String source, Ast const* ast, Token const* tokens, Interner* interner, NodeIndex* binding, Arena* arena, Arena* scratch){
+	ensure(arena != scratch, "Errors would be freed with the scopes");
+	Allocator allocator = heap_allocator();
+
+	return (Resolver){
+		.source = source,
+		.ast = ast,
+		.tokens = tokens,
+		.interner = interner,
+		.symbols = symbol_table_create(scratch, allocator),
+		.binding = binding,
+		.binding_len = ast->len,
+		.allocator = allocator,
+		.errors = dyn_array_create(arena_allocator(arena)),
+		.arena = arena,
+		.stack = dyn_array_create(allocator),
+	};
+}
+
+void resolver_destroy(Resolver* r){
+	symbol_table_destroy(&r->symbols);
+	dyn_array_destroy(&r->stack);
+	r->binding = NULL;
+	r->binding_len = 0;
+}
+
+static inline
+Atom resolver_name(Resolver* r, NodeIndex node){
+	return interner_intern(r->interner, r->tokens[r->ast->main_token[node]].lexeme);
+}
+
+static
+void resolver_declare(Resolver* r, NodeIndex decl){
+	if(symbol_declare(&r->symbols, resolver_name(r, decl), decl) == NULL){
+		u32 token = r->ast->main_token[decl];
+		String name = r->tokens[token].lexeme;
+		resolver_emit_error(r, token, CompilerError_Redeclared, "'%.*s' is already declared in this scope", str_fmt(name));
+	}
+}
+
+/* Expressions don't open scopes, so they are walked with an explicit stack
+ * and never recurse however deep they nest */
+static
+void resolver_expr(Resolver* r, NodeIndex root){
+	Ast const* ast = r->ast;
+	isize base = r->stack.len;
+	dyn_array_push(&r->stack, root);
+
+	while(r->stack.len > base){
+		NodeIndex node = dyn_array_pop(&r->stack);
+		NodeData data = ast->data[node];
+
+		/* Children are pushed right to left so errors come out in source order */
+		switch((NodeTag)ast->tag[node]){
+		case Node_Identifier: {
+			Symbol* sym = symbol_lookup(&r->symbols, resolver_name(r, node));
+			/* Globals are typed in source order, a later one has no type yet */
+			bool later_global = sym != NULL && r->global != NODE_NONE && sym->depth == 0 &&
+				ast->tag[sym->decl] == Node_Let && sym->decl >= r->global;
+			if(later_global){
+				u32 token = ast->main_token[node];
+				String name = r->tokens[token].lexeme;
+				resolver_emit_error(r, token, CompilerError_UndeclaredName, "'%.*s' is used before its declaration", str_fmt(name));
+			}
+			else if(sym != NULL){
+				r->binding[node] = sym->decl;
+			}
+			else {
+				u32 token = ast->main_token[node];
+				String name = r->tokens[token].lexeme;
+				resolver_emit_error(r, token, CompilerError_UndeclaredName, "Undeclared name '%.*s'", str_fmt(name));
+			}
+		} break;
+
+		case Node_Unary:
+		case Node_Member:
+			dyn_array_push(&r->stack, data.lhs);
+		break;
+
+		case Node_Binary:
+		case Node_Assign:
+		case Node_Index:
+			dyn_array_push(&r->stack, data.rhs);
+			dyn_array_push(&r->stack, data.lhs);
+		break;
+
+		case Node_Call: {
+			NodeList args = ast_list(ast, data.rhs);
+			for(u32 i = args.len; i > 0; i -= 1){
+				dyn_array_push(&r->stack, args.v[i - 1]);
+			}
+			dyn_array_push(&r->stack, data.lhs);
+		} break;
+
+		default: break;
+		}
+	}
+}
+
+static void resolver_stmt(Resolver* r, NodeIndex node);
+
+static
+void resolver_stmts(Resolver* r, NodeIndex block){
+	NodeList stmts = ast_list(r->ast, r->ast->data[block].lhs);
+	for(u32 i = 0; i < stmts.len; i += 1){
+		resolver_stmt(r, stmts.v[i]);
+	}
+}
+
+static
+void resolver_stmt(Resolver* r, NodeIndex node){
+	Ast const* ast = r->ast;
+	NodeData data = ast->data[node];
+
+	switch((NodeTag)ast->tag[node]){
+	case Node_Let:
+		/* The value can't see the name it initializes */
+		resolver_expr(r, data.rhs);
+		resolver_declare(r, node);
+	break;
+
+	case Node_Block:
+		symbol_scope_push(&r->symbols);
+		resolver_stmts(r, node);
+		symbol_scope_pop(&r->symbols);
+	break;
+
+	case Node_If: {
+		NodeList branches = ast_list(ast, data.rhs);
+		resolver_expr(r, data.lhs);
+		resolver_stmt(r, branches.v[0]);
+		if(branches.v[1] != NODE_NONE){
+			resolver_stmt(r, branches.v[1]);
+		}
+	} break;
+
+	case Node_For:
+		resolver_expr(r, data.lhs);
+		resolver_stmt(r, data.rhs);
+	break;
+
+	case Node_Return:
+		resolver_expr(r, data.lhs);
+	break;
+
+	case Node_Break:
+	case Node_Continue:
+	case Node_None:
+	break;
+
+	default:
+		resolver_expr(r, node);
+	break;
+	}
+}
+
+/* Parameters and the body's top level share a scope, so a local can't
+ * redeclare a parameter */
+void resolver_resolve_fn(Resolver* r, NodeIndex fn){
+	Ast const* ast = r->ast;
+	NodeIndex proto = ast->data[fn].lhs;
+	NodeIndex body = ast->data[fn].rhs;
+	if(body == NODE_NONE || ast->tag[body] != Node_Block){
+		return;
+	}
+
+	symbol_scope_push(&r->symbols);
+	NodeList params = ast_list(ast, ast->data[proto].lhs);
+	for(u32 i = 0; i < params.len; i += 1){
+		if(params.v[i] != NODE_NONE){
+			resolver_declare(r, params.v[i]);
+		}
+	}
+	resolver_stmts(r, body);
+	symbol_scope_pop(&r->symbols);
+}
+
+void resolver_declare_globals(Resolver* r, NodeIndex file){
+	Ast const* ast = r->ast;
+	ensure(ast->tag[file] == Node_File, "Not a file node");
+	ensure(ast->len <= r->binding_len, "AST grew after the resolver was created");
+	ensure(r->symbols.current == NULL, "Globals are already declared");
+
+	symbol_scope_push(&r->symbols);
+	NodeList items = ast_list(ast, ast->data[file].lhs);
+	for(u32 i = 0; i < items.len; i += 1){
+		resolver_declare(r, items.v[i]);
+	}
+}
+
+static
+void resolver_global(Resolver* r, NodeIndex let){
+	r->global = let;
+	resolver_expr(r, r->ast->data[let].rhs);
+	r->global = NODE_NONE;
+}
+
+void resolver_resolve_globals(Resolver* r, NodeIndex file){
+	Ast const* ast = r->ast;
+	NodeList items = ast_list(ast, ast->data[file].lhs);
+	for(u32 i = 0; i < items.len; i += 1){
+		if(ast->tag[items.v[i]] == Node_Let){
+			resolver_global(r, items.v[i]);
+		}
+	}
+}
+
+void resolver_resolve_file(Resolver* r, NodeIndex file){
+	Ast const* ast = r->ast;
+	resolver_declare_globals(r, file);
+
+	NodeList items = ast_list(ast, ast->data[file].lhs);
+	for(u32 i = 0; i < items.len; i += 1){
+		NodeIndex item = items.v[i];
+		if(ast->tag[item] == Node_FnDecl){
+			resolver_resolve_fn(r, item);
+		}
+		else {
+			resolver_global(r, item);
+		}
+	}
+	symbol_scope_pop(&r->symbols);
+}
@@ -0,0 +1,34 @@
+#include "test.h"
+
+/* Ending a region drops the overflow chunks added inside it and rewinds the
+ * one that was newest when it began */
+static
+void test_arena_region_chunks(){
+	Arena a = arena_create_mapped(4096, MemPages_Default, NULL);
+	check(arena_alloc(&a, 4000, 8) != NULL);
+	check(arena_alloc(&a, 2000, 8) != NULL);
+	Arena* chunk = a.next;
+	check(chunk != NULL && chunk->offset == 2000);
+
+	byte* last = arena_alloc(&a, 16, 8);
+	ArenaRegion reg = arena_region_begin(&a);
+	check(arena_alloc(&a, 3000, 8) != NULL);
+	check(arena_alloc(&a, 64 * 1024, 8) != NULL);
+	check(a.next != chunk);
+	arena_region_end(reg);
+
+	check(a.next == chunk);
+	check(chunk->next == NULL);
+	check(chunk->offset == 2000);
+	check(a.region_count == 0);
+
+	/* The allocation before the region is the last one again */
+	check(arena_resize_in_place(&a, last, 32));
+	check(arena_alloc(&a, 64 * 1024, 8) != NULL);
+	arena_destroy_mapped(&a);
+}
+
+static
+void test_arena(){
+	test_arena_region_chunks();
+}
@@ -0,0 +1,78 @@
+#include "test.h"
+
+/* Random inserts and removes checked against a plain array */
+static
+void test_hash_map_u32(){
+	enum { key_range = 4096 };
+	static u32 reference[key_range];
+	static bool present[key_range];
+	mem_set(present, 0, sizeof(present));
+
+	HashMap m = hash_map_make(heap_allocator(), u32, u32);
+	u64 seed = 1;
+	isize len = 0;
+	for(isize i = 0; i < 200000; i += 1){
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		u32 key = (u32)(seed >> 33) % key_range;
+		u32 value = (u32)i;
+
+		if((seed >> 20) % 3 == 0){
+			check(hash_map_remove(&m, &key) == present[key]);
+			len -= present[key];
+			present[key] = false;
+		}
+		else {
+			check(hash_map_insert(&m, &key, &value) != NULL);
+			len += !present[key];
+			present[key] = true;
+			reference[key] = value;
+		}
+	}
+
+	check(m.len == len);
+	for(u32 key = 0; key < key_range; key += 1){
+		u32* v = hash_map_get(&m, &key);
+		check((v != NULL) == present[key]);
+		if(v != NULL){
+			check(*v == reference[key]);
+		}
+	}
+	hash_map_destroy(&m);
+}
+
+static
+void test_hash_map_string(){
+	Arena arena = arena_create_mapped(4 * mem_megabyte, MemPages_Default, NULL);
+	HashMap m = hash_map_make(heap_allocator(), String, i32);
+
+	for(i32 i = 0; i < 10000; i += 1){
+		String key = str_format(&arena, "name_%d", i);
+		hash_map_insert(&m, &key, &i);
+	}
+	check(m.len == 10000);
+
+	for(i32 i = 0; i < 10000; i += 1){
+		/* A separate copy, keys compare by contents */
+		String key = str_format(&arena, "name_%d", i);
+		i32* v = hash_map_get(&m, &key);
+		check(v != NULL && *v == i);
+	}
+	String missing = str_lit("name_10000");
+	check(hash_map_get(&m, &missing) == NULL);
+
+	/* Precomputed hashes stay valid across growth */
+	String key = str_lit("name_42");
+	u64 hash = hash_map_hash(&m, &key);
+	check(hash_map_reserve(&m, 100000));
+	i32* v = hash_map_get_hashed(&m, &key, hash);
+	check(v != NULL && *v == 42);
+
+	hash_map_destroy(&m);
+	arena_destroy_mapped(&arena);
+}
+
+static
+void test_hash_map(){
+	test_hash_map_u32();
+	test_hash_map_string();
+}
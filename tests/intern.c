@@ -0,0 +1,107 @@
+#include "test.h"
+
+enum { test_intern_count = 70000 };
+
+/* Names shared by the tests below, "name0" to "name69999" */
+static
+String* test_intern_names(Arena* arena){
+	String* names = arena_make(arena, String, test_intern_count);
+	for(isize i = 0; i < test_intern_count; i += 1){
+		names[i] = str_format(arena, "name%td", i);
+	}
+	return names;
+}
+
+/* Atoms are handed out as 1, 2, 3... in insertion order, across pages */
+static
+void test_intern_dense(){
+	Arena arena = arena_create_mapped(8 * mem_megabyte, MemPages_Default, NULL);
+	String* names = test_intern_names(&arena);
+	Interner* in = interner_create(mem_megabyte * 4);
+
+	check(interner_find(in, names[0]) == 0);
+	check(interner_string(in, 0).len == 0);
+
+	bool dense = true;
+	for(isize i = 0; i < test_intern_count; i += 1){
+		dense = dense && interner_intern(in, names[i]) == (Atom)(i + 1);
+	}
+	check(dense);
+	check(interner_count(in) == test_intern_count);
+
+	bool stable = true;
+	for(isize i = 0; i < test_intern_count; i += 1){
+		Atom atom = (Atom)(i + 1);
+		stable = stable && interner_intern(in, names[i]) == atom && interner_find(in, names[i]) == atom
+			&& str_equals(interner_string(in, atom), names[i]);
+	}
+	check(stable);
+	check(interner_count(in) == test_intern_count);
+	check(interner_find(in, str_lit("name70000")) == 0);
+	check(interner_intern(in, str_lit("")) == test_intern_count + 1);
+
+	interner_destroy(in);
+	arena_destroy_mapped(&arena);
+}
+
+typedef struct {
+	Interner* in;
+	String const* names;
+	u32 seed;
+	Atom* atoms;
+} TestInternWorker;
+
+/* Every thread interns all the names, starting at a different one */
+static
+void test_intern_worker(void* arg){
+	TestInternWorker* w = arg;
+	for(isize k = 0; k < test_intern_count; k += 1){
+		isize i = (k + (isize)w->seed * 17389) % test_intern_count;
+		w->atoms[i] = interner_intern(w->in, w->names[i]);
+	}
+}
+
+/* Racing on the same strings hands each one a single atom, and no atom is
+ * skipped or given out twice */
+static
+void test_intern_concurrent(){
+	enum { threads = 4 };
+	Arena arena = arena_create_mapped(8 * mem_megabyte, MemPages_Default, NULL);
+	String* names = test_intern_names(&arena);
+	Interner* in = interner_create(mem_megabyte * 4);
+
+	TestInternWorker workers[threads];
+	Thread handles[threads];
+	for(u32 i = 0; i < threads; i += 1){
+		workers[i] = (TestInternWorker){ .in = in, .names = names, .seed = i, .atoms = arena_make(&arena, Atom, test_intern_count) };
+		check(thread_create(&handles[i], test_intern_worker, &workers[i]));
+	}
+	for(u32 i = 0; i < threads; i += 1){
+		thread_join(&handles[i]);
+	}
+
+	for(u32 i = 1; i < threads; i += 1){
+		check(mem_compare(workers[i].atoms, workers[0].atoms, test_intern_count * sizeof(Atom)) == 0);
+	}
+	check(interner_count(in) == test_intern_count);
+
+	bool* seen = arena_make(&arena, bool, test_intern_count + 1);
+	mem_set(seen, 0, test_intern_count + 1);
+	bool unique = true;
+	for(isize i = 0; i < test_intern_count; i += 1){
+		Atom atom = workers[0].atoms[i];
+		unique = unique && atom >= 1 && atom <= test_intern_count && !seen[atom]
+			&& str_equals(interner_string(in, atom), names[i]);
+		if(atom <= test_intern_count){ seen[atom] = true; }
+	}
+	check(unique);
+
+	interner_destroy(in);
+	arena_destroy_mapped(&arena);
+}
+
+static
+void test_intern(){
+	test_intern_dense();
+	test_intern_concurrent();
+}
@@ -0,0 +1,111 @@
+#include "test.h"
+
+#if defined(OS_LINUX)
+#include <unistd.h>
+
+/* Reads exactly len bytes. The writes are done first, so they must fit in
+ * the pipe's buffer. */
+static
+bool test_io_read(int fd, byte* out, isize len){
+	while(len > 0){
+		isize n = read(fd, out, len);
+		if(n <= 0){ return false; }
+		out += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* Small appends are buffered, big ones go out with the buffered bytes in one
+ * writev; either way the bytes arrive in order */
+static
+void test_io_writer_pairing(){
+	int fds[2];
+	check(pipe(fds) == 0);
+
+	static byte expect[32 * 1024];
+	static byte got[32 * 1024];
+	static byte big[400];
+	for(isize i = 0; i < (isize)sizeof(big); i += 1){
+		big[i] = 'A' + (byte)(i % 26);
+	}
+	isize len = 0;
+
+	byte buf[128];
+	Writer w = writer_create(fds[1], buf, sizeof(buf));
+	for(isize i = 0; i < 50; i += 1){
+		/* Pieces under half the buffer are copied, longer ones go out directly */
+		isize size = (i * 37) % (isize)sizeof(big);
+		String piece = { .v = big, .len = size };
+		writer_append(&w, piece);
+		mem_copy_no_overlap(expect + len, piece.v, piece.len);
+		len += piece.len;
+
+		writer_append_byte(&w, '.');
+		expect[len++] = '.';
+
+		writer_append_i64(&w, -i);
+		len += snprintf((char*)expect + len, sizeof(expect) - len, "%td", -i);
+
+		writer_format(&w, "[%s]", i % 5 == 0 ? "fmt" : "");
+		len += snprintf((char*)expect + len, sizeof(expect) - len, "[%s]", i % 5 == 0 ? "fmt" : "");
+	}
+	check(writer_flush(&w) && !w.failed);
+
+	check(test_io_read(fds[0], got, len));
+	check(mem_compare(got, expect, len) == 0);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/* Once a write fails the writer drops everything after it */
+static
+void test_io_writer_failure(){
+	int fds[2];
+	check(pipe(fds) == 0);
+	close(fds[0]);
+	close(fds[1]);
+
+	byte buf[64];
+	Writer w = writer_create(fds[1], buf, sizeof(buf));
+	writer_append(&w, str_lit("buffered"));
+	check(!w.failed);
+	check(!writer_flush(&w) && w.failed);
+
+	static byte big[200];
+	writer_append(&w, (String){ .v = big, .len = sizeof(big) });
+	writer_format(&w, "%d", 1);
+	check(!writer_flush(&w) && w.failed);
+}
+
+/* Flushing more chunks than one writev batch takes */
+static
+void test_io_builder_flush(){
+	int fds[2];
+	check(pipe(fds) == 0);
+
+	static byte expect[4096];
+	static byte got[4096];
+	StrBuilder sb = str_builder_create(heap_allocator(), 16);
+	for(isize i = 0; i < (isize)sizeof(expect); i += 1){
+		expect[i] = 'a' + (byte)(i % 23);
+		str_builder_append_byte(&sb, expect[i]);
+	}
+	check(str_builder_flush(&sb, fds[1]) && sb.len == 0);
+	check(test_io_read(fds[0], got, sizeof(got)));
+	check(mem_compare(got, expect, sizeof(expect)) == 0);
+
+	str_builder_destroy(&sb);
+	close(fds[0]);
+	close(fds[1]);
+}
+#endif
+
+static
+void test_io(){
+#if defined(OS_LINUX)
+	test_io_writer_pairing();
+	test_io_writer_failure();
+	test_io_builder_flush();
+#endif
+}
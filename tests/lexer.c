@@ -0,0 +1,37 @@
+#include "test.h"
+
+/* Integer literals are u64, anything wider is an error rather than wrapped */
+static
+void test_lexer_integer_range(){
+	struct { String source; bool valid; u64 value; } cases[] = {
+		{ str_lit("18446744073709551615"), true, UINT64_MAX },
+		{ str_lit("0xffff_ffff_ffff_ffff"), true, UINT64_MAX },
+		{ str_lit("0b1_0000"), true, 16 },
+		{ str_lit("9223372036854775808"), true, 9223372036854775808ull },
+		{ str_lit("18446744073709551616"), false, 0 },
+		{ str_lit("99999999999999999999"), false, 0 },
+		{ str_lit("0x1_0000_0000_0000_0000"), false, 0 },
+	};
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		static byte mem[64 * 1024];
+		Arena arena = arena_create_buffer(mem, sizeof(mem));
+		Lexer lex = lexer_create(cases[i].source, &arena);
+		LexerResult lexed = lexer_tokenize(&lex, heap_allocator());
+
+		Token t = lexed.tokens.v[0];
+		if(cases[i].valid){
+			check(lexed.errors.len == 0);
+			check(t.type == Tk_Integer && (u64)t.value_integer == cases[i].value);
+		}
+		else {
+			check(lexed.errors.len == 1 && lexed.errors.v[0].type == CompilerError_InvalidNumber);
+			check(t.type == Tk_Invalid);
+		}
+		dyn_array_destroy(&lexed.tokens);
+	}
+}
+
+static
+void test_lexer(){
+	test_lexer_integer_range();
+}
@@ -0,0 +1,90 @@
+#include "test.h"
+
+/* A body parsed after a snapshot is lazy again once the snapshot is restored */
+static
+void test_parser_restore_body(){
+	static byte lex_mem[64 * 1024];
+	static byte parser_mem[64 * 1024];
+	Arena lex_arena = arena_create_buffer(lex_mem, sizeof(lex_mem));
+	Arena parser_arena = arena_create_buffer(parser_mem, sizeof(parser_mem));
+
+	String source = str_lit("fn f() { let x = 1; } fn g() { }");
+	Lexer lex = lexer_create(source, &lex_arena);
+	LexerResult lexed = lexer_tokenize(&lex, heap_allocator());
+
+	Ast ast = ast_create(heap_allocator(), 16);
+	Parser p = parser_create(source, lexed.tokens, &ast, &parser_arena);
+	p.lazy_bodies = true;
+	NodeIndex root = parser_parse_file(&p);
+	NodeIndex fn = ast_list(&ast, ast.data[root].lhs).v[0];
+	NodeIndex lazy = ast.data[fn].rhs;
+	check(ast.tag[lazy] == Node_LazyBody);
+
+	ParserSnapshot snap = parser_snapshot(&p);
+	NodeIndex block = parser_parse_body(&p, fn);
+	check(ast.tag[block] == Node_Block);
+	parser_restore(&p, snap);
+	check(ast.data[fn].rhs == lazy);
+	check(p.snapshot_depth == 0 && p.body_patches.len == 0);
+
+	snap = parser_snapshot(&p);
+	block = parser_parse_body(&p, fn);
+	parser_commit(&p, snap);
+	check(ast.data[fn].rhs == block && ast.tag[block] == Node_Block);
+	check(p.body_patches.len == 0);
+
+	parser_destroy(&p);
+	ast_destroy(&ast);
+	dyn_array_destroy(&lexed.tokens);
+}
+
+/* Prefix type operators are parsed in a loop, a long run of them must not
+ * use up the C stack */
+static
+void test_parser_deep_type(){
+	enum { depth = 200000 };
+	StrBuilder sb = str_builder_create(heap_allocator(), 4096);
+	str_builder_append(&sb, str_lit("fn f(x: "));
+	for(isize i = 0; i < depth; i += 1){
+		str_builder_append(&sb, i % 3 == 2 ? str_lit("[4]") : str_lit("*"));
+	}
+	str_builder_append(&sb, str_lit("i32) {}"));
+	String source = str_builder_build(&sb);
+
+	Arena lex_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+	Arena parser_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+	Lexer lex = lexer_create(source, &lex_arena);
+	LexerResult lexed = lexer_tokenize(&lex, heap_allocator());
+
+	Ast ast = ast_create(heap_allocator(), 64);
+	Parser p = parser_create(source, lexed.tokens, &ast, &parser_arena);
+	NodeIndex root = parser_parse_file(&p);
+	check(p.errors.len == 0);
+
+	NodeIndex fn = ast_list(&ast, ast.data[root].lhs).v[0];
+	NodeIndex param = ast_list(&ast, ast.data[ast.data[fn].lhs].lhs).v[0];
+	NodeIndex type = ast.data[param].lhs;
+	isize levels = 0;
+	bool in_order = true;
+	while(ast.tag[type] == Node_TypePointer || ast.tag[type] == Node_TypeArray){
+		NodeIndex elem = ast.tag[type] == Node_TypePointer ? ast.data[type].lhs : ast.data[type].rhs;
+		in_order = in_order && elem < type;
+		check(ast.tag[type] == (levels % 3 == 2 ? Node_TypeArray : Node_TypePointer));
+		type = elem;
+		levels += 1;
+	}
+	check(in_order && levels == depth && ast.tag[type] == Node_TypeName);
+
+	parser_destroy(&p);
+	ast_destroy(&ast);
+	dyn_array_destroy(&lexed.tokens);
+	arena_destroy_mapped(&parser_arena);
+	arena_destroy_mapped(&lex_arena);
+	str_builder_destroy(&sb);
+}
+
+static
+void test_parser(){
+	test_parser_restore_body();
+	test_parser_deep_type();
+}
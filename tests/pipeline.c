@@ -0,0 +1,66 @@
+#include "test.h"
+
+/* Source with enough tokens to go around the ring several times */
+static
+String test_pipeline_source(StrBuilder* sb){
+	str_builder_append(sb, str_lit("let scale: i32 = 3;\n"));
+	for(isize i = 0; i < 2000; i += 1){
+		str_builder_format(sb, "fn f%td(a: i32, b: [4]i32) i32 { let x = a * scale + b[%td] << 2; if x > %td { return f%td(x - 1, b); } return -x; }\n", i, i % 4, i, i / 2);
+	}
+	/* A parse error in the stream has to come out the same too */
+	str_builder_append(sb, str_lit("fn broken( { }\n"));
+	return str_builder_build(sb);
+}
+
+/* Streaming tokens through the ring builds the same AST as lexing first */
+static
+void test_pipeline_matches_batch(){
+	StrBuilder sb = str_builder_create(heap_allocator(), 64 * 1024);
+	String source = test_pipeline_source(&sb);
+
+	Arena lex_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+	Arena parser_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+
+	Lexer lex = lexer_create(source, &lex_arena);
+	LexerResult lexed = lexer_tokenize(&lex, heap_allocator());
+	Ast batch = ast_create(heap_allocator(), 64);
+	Parser p = parser_create(source, lexed.tokens, &batch, &parser_arena);
+	NodeIndex batch_root = parser_parse_file(&p);
+	isize batch_errors = p.errors.len;
+	parser_destroy(&p);
+
+	Lexer stream_lex = lexer_create(source, &lex_arena);
+	TokenArray tokens = dyn_array_create(heap_allocator());
+	Ast streamed = ast_create(heap_allocator(), 64);
+	TokenArray none = {0};
+	p = parser_create(source, none, &streamed, &parser_arena);
+	NodeIndex stream_root = parser_parse_file_streaming(&p, &stream_lex, &tokens);
+	isize stream_errors = p.errors.len;
+	parser_destroy(&p);
+
+	check(batch_errors > 0 && batch_errors == stream_errors);
+	check(batch_root == stream_root);
+	check(tokens.len == lexed.tokens.len);
+	check(batch.len == streamed.len && batch.extra.len == streamed.extra.len);
+	if(batch.len == streamed.len){
+		check(mem_compare(batch.tag, streamed.tag, batch.len) == 0);
+		check(mem_compare(batch.main_token, streamed.main_token, batch.len * sizeof(u32)) == 0);
+		check(mem_compare(batch.data, streamed.data, batch.len * sizeof(NodeData)) == 0);
+	}
+	if(batch.extra.len == streamed.extra.len){
+		check(mem_compare(batch.extra.v, streamed.extra.v, batch.extra.len * sizeof(u32)) == 0);
+	}
+
+	ast_destroy(&streamed);
+	ast_destroy(&batch);
+	dyn_array_destroy(&tokens);
+	dyn_array_destroy(&lexed.tokens);
+	arena_destroy_mapped(&parser_arena);
+	arena_destroy_mapped(&lex_arena);
+	str_builder_destroy(&sb);
+}
+
+static
+void test_pipeline(){
+	test_pipeline_matches_batch();
+}
@@ -0,0 +1,115 @@
+#include "test.h"
+
+/* Offset of the name a use at `use` (the first match in the source) is bound
+ * to, -1 if it is unresolved and -2 if there is no identifier there */
+static
+isize test_resolver_decl_of(TestSema const* t, String use){
+	String source = t->sema.source;
+	isize at = str_find(source, use);
+	for(u32 node = 1; node < t->ast.len; node += 1){
+		Token tok = t->lexed.tokens.v[t->ast.main_token[node]];
+		if(t->ast.tag[node] != Node_Identifier || tok.lexeme.v - source.v != at){
+			continue;
+		}
+		NodeIndex decl = t->sema.binding[node];
+		if(decl == NODE_NONE){
+			return -1;
+		}
+		return t->lexed.tokens.v[t->ast.main_token[decl]].lexeme.v - source.v;
+	}
+	return -2;
+}
+
+/* Offset of the name in a declaration like "let a = 2" */
+static
+isize test_resolver_name_at(TestSema const* t, String decl){
+	isize at = str_find(t->sema.source, decl);
+	isize skip = str_starts_with(decl, str_lit("let ")) ? 4 : 0;
+	return at < 0 ? -3 : at + skip;
+}
+
+static
+void test_resolver_nested_shadowing(){
+	TestSema t;
+	test_sema_run(&t, str_lit(
+		"fn f() i32 {\n"
+		"	let a = 1;\n"
+		"	{\n"
+		"		let a = 2;\n"
+		"		{\n"
+		"			let a = 3;\n"
+		"			let u = a + 30;\n"
+		"		}\n"
+		"		let u = a + 20;\n"
+		"	}\n"
+		"	return a + 10;\n"
+		"}\n"));
+	check(t.sema.errors.len == 0);
+	check(test_resolver_decl_of(&t, str_lit("a + 30")) == test_resolver_name_at(&t, str_lit("let a = 3")));
+	check(test_resolver_decl_of(&t, str_lit("a + 20")) == test_resolver_name_at(&t, str_lit("let a = 2")));
+	check(test_resolver_decl_of(&t, str_lit("a + 10")) == test_resolver_name_at(&t, str_lit("let a = 1")));
+	test_sema_destroy(&t);
+}
+
+/* A block's locals are gone once it ends */
+static
+void test_resolver_block_scope(){
+	struct { String source; String use; } cases[] = {
+		{ str_lit("fn f() i32 { { let b = 1; } return b; }"), str_lit("b; }") },
+		{ str_lit("fn f() { if true { let c = 1; } else { let d = c; } }"), str_lit("c; }") },
+		{ str_lit("fn f() { for true { let e = 1; } let g = e; }"), str_lit("e; }") },
+	};
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		TestSema t;
+		test_sema_run(&t, cases[i].source);
+		check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_UndeclaredName));
+		check(test_resolver_decl_of(&t, cases[i].use) == -1);
+		test_sema_destroy(&t);
+	}
+}
+
+/* Parameters share a scope with the body's top level, not with nested blocks */
+static
+void test_resolver_param_redeclared(){
+	TestSema t;
+	test_sema_run(&t, str_lit("fn f(x: i32) { let x = 1; }"));
+	check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_Redeclared));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("fn f() { let y = 1; let y = 2; }"));
+	check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_Redeclared));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("fn f(x: i32) i32 { { let x = 2; return x + 1; } }"));
+	check(t.sema.errors.len == 0);
+	check(test_resolver_decl_of(&t, str_lit("x + 1")) == test_resolver_name_at(&t, str_lit("let x = 2")));
+	test_sema_destroy(&t);
+}
+
+/* A let's value is resolved before its name is declared */
+static
+void test_resolver_let_own_name(){
+	TestSema t;
+	test_sema_run(&t, str_lit("fn f() { let y = y; }"));
+	check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_UndeclaredName));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("fn f(y: i32) { { let y = y + 1; } }"));
+	check(t.sema.errors.len == 0);
+	check(test_resolver_decl_of(&t, str_lit("y + 1")) == test_resolver_name_at(&t, str_lit("y: i32")));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("let g = 1; fn f() i64 { let g = g + 1; return g * 2; }"));
+	check(t.sema.errors.len == 0);
+	check(test_resolver_decl_of(&t, str_lit("g + 1")) == test_resolver_name_at(&t, str_lit("let g = 1")));
+	check(test_resolver_decl_of(&t, str_lit("g * 2")) == test_resolver_name_at(&t, str_lit("let g = g")));
+	test_sema_destroy(&t);
+}
+
+static
+void test_resolver(){
+	test_resolver_nested_shadowing();
+	test_resolver_block_scope();
+	test_resolver_param_redeclared();
+	test_resolver_let_own_name();
+}
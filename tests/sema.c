@@ -0,0 +1,233 @@
+#include "test.h"
+
+/* Lexes, parses and checks source, parse errors included */
+typedef struct {
+	Arena lex_arena;
+	Arena parser_arena;
+	Arena sema_arena;
+	LexerResult lexed;
+	Ast ast;
+	Interner* interner;
+	TypeTable* types;
+	Sema sema;
+	NodeIndex root;
+} TestSema;
+
+static
+void test_sema_run_workers(TestSema* t, String source, u32 workers){
+	t->lex_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+	t->parser_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+	t->sema_arena = arena_create_mapped(mem_megabyte, MemPages_Default, NULL);
+
+	Lexer lex = lexer_create(source, &t->lex_arena);
+	t->lexed = lexer_tokenize(&lex, heap_allocator());
+	t->ast = ast_create(heap_allocator(), 64);
+	Parser p = parser_create(source, t->lexed.tokens, &t->ast, &t->parser_arena);
+	t->root = parser_parse_file(&p);
+	parser_destroy(&p);
+
+	t->interner = interner_create(mem_megabyte);
+	t->types = type_table_create(mem_megabyte);
+	t->sema = sema_create(source, &t->ast, t->lexed.tokens.v, t->interner, t->types, &t->sema_arena, workers);
+	sema_check_file(&t->sema, t->root);
+}
+
+static
+void test_sema_run(TestSema* t, String source){
+	test_sema_run_workers(t, source, 1);
+}
+
+static
+void test_sema_destroy(TestSema* t){
+	sema_destroy(&t->sema);
+	type_table_destroy(t->types);
+	interner_destroy(t->interner);
+	ast_destroy(&t->ast);
+	dyn_array_destroy(&t->lexed.tokens);
+	arena_destroy_mapped(&t->sema_arena);
+	arena_destroy_mapped(&t->parser_arena);
+	arena_destroy_mapped(&t->lex_arena);
+}
+
+static
+bool test_sema_has_error(TestSema const* t, CompilerErrorType type){
+	for(isize i = 0; i < t->sema.errors.len; i += 1){
+		if(t->sema.errors.v[i].type == type){ return true; }
+	}
+	return false;
+}
+
+/* Parse errors leave NODE_NONE operands behind, inference has to skip them
+ * without piling more errors on top */
+static
+void test_sema_broken_parse(){
+	struct { String source; isize errors; } cases[] = {
+		{ str_lit("fn f() { if { } }"), 0 },
+		{ str_lit("fn f() { for { } }"), 0 },
+		{ str_lit("fn f() { let x = 1 + ; }"), 0 },
+		{ str_lit("fn f() { let x = !; }"), 0 },
+		{ str_lit("fn f() { let x = [1][; }"), 0 },
+		{ str_lit("fn f(a: i32) { let x = f(1, ); }"), 1 },
+		{ str_lit("let g = ; fn f() { let y = g + 1; }"), 1 },
+	};
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		TestSema t;
+		test_sema_run(&t, cases[i].source);
+		check(t.sema.errors.len == cases[i].errors);
+		test_sema_destroy(&t);
+	}
+}
+
+/* A global's value can only use the globals above it, functions can use any */
+static
+void test_sema_global_order(){
+	TestSema t;
+	test_sema_run(&t, str_lit("let a = b; let b = 1;"));
+	check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_UndeclaredName));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("let a = a + 1;"));
+	check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_UndeclaredName));
+	test_sema_destroy(&t);
+
+	test_sema_run(&t, str_lit("let a = 1; let b = a; fn f() { let c = d + b; } let d = 2;"));
+	check(t.sema.errors.len == 0);
+	NodeIndex let_b = ast_list(&t.ast, t.ast.data[t.root].lhs).v[1];
+	check(t.sema.node_types[let_b] == Type_I64);
+	test_sema_destroy(&t);
+}
+
+/* Each index in a long chain is typed from the one inside it */
+static
+void test_sema_index_chain(){
+	enum { depth = 20000 };
+	StrBuilder sb = str_builder_create(heap_allocator(), 4096);
+	str_builder_append(&sb, str_lit("fn f(x: "));
+	for(isize i = 0; i < depth; i += 1){ str_builder_append(&sb, str_lit("[]")); }
+	str_builder_append(&sb, str_lit("i32) i32 { return x"));
+	for(isize i = 0; i < depth; i += 1){ str_builder_append(&sb, str_lit("[0]")); }
+	str_builder_append(&sb, str_lit("; }"));
+	String source = str_builder_build(&sb);
+
+	TestSema t;
+	test_sema_run(&t, source);
+	check(t.sema.errors.len == 0);
+	test_sema_destroy(&t);
+	str_builder_destroy(&sb);
+}
+
+/* Value of the global let at index item */
+static
+ConstValue test_sema_global_value(TestSema const* t, u32 item){
+	NodeIndex let = ast_list(&t->ast, t->ast.data[t->root].lhs).v[item];
+	return t->sema.consts[t->ast.data[let].rhs];
+}
+
+static
+void test_sema_literal_range(){
+	TestSema t;
+	test_sema_run(&t, str_lit("let a: i8 = -128; let b: i8 = 127; let c: u8 = 255; let d: i16 = -32768; let e: u32 = 4294967295;"));
+	check(t.sema.errors.len == 0);
+	check(test_sema_global_value(&t, 0).known && test_sema_global_value(&t, 0).value == -128);
+	check(test_sema_global_value(&t, 3).value == -32768);
+	check(test_sema_global_value(&t, 4).value == 4294967295);
+	test_sema_destroy(&t);
+
+	String bad[] = {
+		str_lit("let a: i8 = 300;"),
+		str_lit("let a: i8 = 128;"),
+		str_lit("let a: i8 = -129;"),
+		str_lit("let a: u8 = 256;"),
+		str_lit("let a: i32 = 1 + 2147483648;"),
+	};
+	for(isize i = 0; i < c_array_length(bad); i += 1){
+		test_sema_run(&t, bad[i]);
+		check(t.sema.errors.len == 1 && test_sema_has_error(&t, CompilerError_InvalidConstant));
+		check(!test_sema_global_value(&t, 0).known);
+		test_sema_destroy(&t);
+	}
+}
+
+/* Errors from globals and bodies come out by position, not by phase */
+static
+void test_sema_error_order(){
+	TestSema t;
+	test_sema_run(&t, str_lit("fn f() { let x: i8 = 300; } let g: u8 = 256; fn h() { let y = z; }"));
+	check(t.sema.errors.len == 3);
+	for(isize i = 1; i < t.sema.errors.len; i += 1){
+		check(t.sema.errors.v[i - 1].offset < t.sema.errors.v[i].offset);
+	}
+	test_sema_destroy(&t);
+}
+
+/* The required type is the one reported as expected, and literals are
+ * printed unsigned */
+static
+void test_sema_mismatch_messages(){
+	struct { String source; String message; } cases[] = {
+		{ str_lit("fn f(b: bool) i32 { return b; }"), str_lit("Type mismatch, expected 'i32', got 'bool'") },
+		{ str_lit("fn g(x: bool) { } fn f(a: i32) { g(a); }"), str_lit("Type mismatch, expected 'bool', got 'i32'") },
+		{ str_lit("fn f(a: i32) { if a { } }"), str_lit("Type mismatch, expected 'bool', got 'i32'") },
+		{ str_lit("fn f(b: i64) { let c: i32 = b; }"), str_lit("Type mismatch, expected 'i32', got 'i64'") },
+		{ str_lit("fn f(b: i64) { let a = b; let c: i32 = a; }"), str_lit("Type mismatch, expected 'i32', got 'i64'") },
+		{ str_lit("let t: i64 = 9223372036854775808;"), str_lit("Integer literal 9223372036854775808 doesn't fit in 'i64'") },
+	};
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		TestSema t;
+		test_sema_run(&t, cases[i].source);
+		check(t.sema.errors.len == 1 && str_equals(t.sema.errors.v[0].message, cases[i].message));
+		test_sema_destroy(&t);
+	}
+}
+
+/* Bodies checked on several workers give the same result as on one */
+static
+void test_sema_workers(){
+	StrBuilder sb = str_builder_create(heap_allocator(), 4096);
+	str_builder_append(&sb, str_lit("let base: i32 = 7;\n"));
+	for(isize i = 0; i < 400; i += 1){
+		str_builder_format(&sb, "fn f%td(a: i32) i32 { let x = a * %td + base; let k: u8 = %td; ", i, i, i % 300);
+		switch(i % 4){
+		case 0: str_builder_append(&sb, str_lit("let bad: bool = x; ")); break;
+		case 1: str_builder_append(&sb, str_lit("let y = missing; ")); break;
+		case 2: str_builder_format(&sb, "return f%td(x); ", i / 2); break;
+		default: break;
+		}
+		str_builder_append(&sb, str_lit("return x; }\n"));
+	}
+	String source = str_builder_build(&sb);
+
+	TestSema one, many;
+	test_sema_run_workers(&one, source, 1);
+	test_sema_run_workers(&many, source, 4);
+
+	check(one.sema.errors.len > 0 && one.sema.errors.len == many.sema.errors.len);
+	for(isize i = 0; i < min(one.sema.errors.len, many.sema.errors.len); i += 1){
+		CompilerError a = one.sema.errors.v[i];
+		CompilerError b = many.sema.errors.v[i];
+		check(a.type == b.type && a.offset == b.offset && str_equals(a.message, b.message));
+	}
+	check(one.ast.len == many.ast.len);
+	for(u32 node = 0; node < min(one.ast.len, many.ast.len); node += 1){
+		/* This program only uses types interned before the bodies run, so ids match too */
+		check(one.sema.node_types[node] == many.sema.node_types[node]);
+		ConstValue ca = one.sema.consts[node];
+		ConstValue cb = many.sema.consts[node];
+		check(ca.known == cb.known && ca.value == cb.value);
+	}
+
+	test_sema_destroy(&many);
+	test_sema_destroy(&one);
+	str_builder_destroy(&sb);
+}
+
+static
+void test_sema(){
+	test_sema_broken_parse();
+	test_sema_global_order();
+	test_sema_index_chain();
+	test_sema_literal_range();
+	test_sema_error_order();
+	test_sema_mismatch_messages();
+	test_sema_workers();
+}
@@ -0,0 +1,78 @@
+#include "test.h"
+
+static
+bool test_owns(byte const* buf, isize size, void const* p){
+	return (byte const*)p >= buf && (byte const*)p < buf + size;
+}
+
+/* Thread chunk caches are keyed by address, a new arena in the same place
+ * must not reuse the old one's chunk */
+static
+void test_shared_arena_recreate(){
+	static byte first[4096];
+	static byte second[4096];
+	SharedArena a = shared_arena_create(first, sizeof(first), 256);
+
+	void* p = shared_arena_alloc(&a, 16, 8);
+	check(test_owns(first, sizeof(first), p));
+
+	a = shared_arena_create(second, sizeof(second), 256);
+	void* q = shared_arena_alloc(&a, 16, 8);
+	check(test_owns(second, sizeof(second), q));
+	check(atomic_load(&a.offset) > 0);
+}
+
+static
+void test_shared_arena_reset(){
+	static byte buf[4096];
+	SharedArena a = shared_arena_create(buf, sizeof(buf), 256);
+
+	byte* p = shared_arena_alloc(&a, 16, 8);
+	p[0] = 1;
+	shared_arena_reset(&a);
+	byte* q = shared_arena_alloc(&a, 16, 8);
+	check(q == p);
+	check(q[0] == 0);
+}
+
+/* Alignments above the chunk alignment can't be served from a chunk, the
+ * result must still be aligned and not overlap anything handed out after it */
+static
+void test_shared_arena_big_align(){
+	static alignas(4096) byte buf[16 * 1024];
+	SharedArena a = shared_arena_create(buf, sizeof(buf), 256);
+
+	byte* ranges[40];
+	isize sizes[40];
+	isize count = 0;
+	for(isize align = 128; align <= 2048; align *= 2){
+		ranges[count] = shared_arena_alloc(&a, 8, 8);
+		sizes[count++] = 8;
+
+		byte* p = shared_arena_alloc(&a, 16, align);
+		check(p != NULL && ((uintptr)p & (align - 1)) == 0);
+		ranges[count] = p;
+		sizes[count++] = 16;
+
+		for(isize i = 0; i < 4; i += 1){
+			ranges[count] = shared_arena_alloc(&a, 48, 8);
+			sizes[count++] = 48;
+		}
+	}
+
+	bool disjoint = true;
+	for(isize i = 0; i < count; i += 1){
+		check(test_owns(buf, sizeof(buf), ranges[i]) && test_owns(buf, sizeof(buf), ranges[i] + sizes[i] - 1));
+		for(isize j = i + 1; j < count; j += 1){
+			disjoint = disjoint && (ranges[i] + sizes[i] <= ranges[j] || ranges[j] + sizes[j] <= ranges[i]);
+		}
+	}
+	check(disjoint);
+}
+
+static
+void test_shared_arena(){
+	test_shared_arena_recreate();
+	test_shared_arena_reset();
+	test_shared_arena_big_align();
+}
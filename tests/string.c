@@ -0,0 +1,126 @@
+#include "test.h"
+
+/* Long runs of one byte fill every SIMD lane, which is where the per-lane
+ * counters could wrap */
+static
+void test_string_count_byte(){
+	static byte data[16 * 1024 + 7];
+	mem_set(data, 'a', sizeof(data));
+	for(isize len = 0; len <= (isize)sizeof(data); len += 509){
+		String s = {.v = data, .len = len};
+		check(str_count_byte(s, 'a') == len);
+		check(str_count_byte(s, 'b') == 0);
+	}
+	String all = {.v = data, .len = sizeof(data)};
+	check(str_count_byte(all, 'a') == (isize)sizeof(data));
+}
+
+/* str_find checked against a byte at a time search */
+static
+isize test_string_find_naive(String s, String needle){
+	for(isize i = 0; i + needle.len <= s.len; i += 1){
+		if(mem_compare(s.v + i, needle.v, needle.len) == 0){ return i; }
+	}
+	return -1;
+}
+
+static
+void test_string_find(){
+	static byte data[4096];
+	u64 seed = 7;
+	for(isize i = 0; i < (isize)sizeof(data); i += 1){
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		data[i] = "abc"[(seed >> 33) % 3];
+	}
+	String s = {.v = data, .len = sizeof(data)};
+
+	for(isize n = 0; n < 2000; n += 1){
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		isize start = (isize)((seed >> 33) % sizeof(data));
+		isize len = 1 + (isize)((seed >> 20) % 12);
+		if(start + len > s.len){ len = s.len - start; }
+		String needle = {.v = data + start, .len = len};
+		check(str_find(s, needle) == test_string_find_naive(s, needle));
+	}
+
+	check(str_find(s, str_lit("abcabcabcabcabcabcabcd")) == -1);
+	check(str_find(str_lit("needle"), str_lit("needle")) == 0);
+	check(str_find(str_lit("need"), str_lit("needle")) == -1);
+	check(str_find(s, str_lit("")) == 0);
+}
+
+static
+void test_string_parse_int(){
+	i64 v = 0;
+	u64 u = 0;
+	check(str_parse_i64(str_lit("-9223372036854775808"), 10, &v) && v == INT64_MIN);
+	check(str_parse_i64(str_lit("9223372036854775807"), 10, &v) && v == INT64_MAX);
+	check(!str_parse_i64(str_lit("9223372036854775808"), 10, &v));
+	check(str_parse_u64(str_lit("18446744073709551615"), 10, &u) && u == UINT64_MAX);
+	check(!str_parse_u64(str_lit("18446744073709551616"), 10, &u));
+	check(str_parse_u64(str_lit("1_000"), 10, &u) && u == 1000);
+	check(!str_parse_u64(str_lit("12a"), 10, &u));
+	check(!str_parse_u64(str_lit("_"), 10, &u));
+	check(str_parse_u64(str_lit("777"), 8, &u) && u == 511);
+}
+
+static
+isize test_string_builder_chunk_count(StrBuilder const* sb){
+	isize count = 0;
+	for(StrChunk const* c = sb->first; c != NULL && c != sb->last->next; c = c->next){
+		count += 1;
+	}
+	return count;
+}
+
+/* Appends and formats that straddle chunk ends land in order, and the second
+ * round runs entirely on the chunks kept by reset */
+static
+void test_string_builder_chunks(){
+	static byte expect[32 * 1024];
+	isize len = 0;
+	isize chunks = 0;
+	StrBuilder sb = str_builder_create(heap_allocator(), 16);
+
+	for(int round = 0; round < 2; round += 1){
+		len = 0;
+		for(isize i = 0; i < 40; i += 1){
+			String piece = str_sub(str_lit("abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ"), 0, i + 1);
+			str_builder_append(&sb, piece);
+			mem_copy_no_overlap(expect + len, piece.v, piece.len);
+			len += piece.len;
+
+			str_builder_append_byte(&sb, '|');
+			expect[len++] = '|';
+
+			/* Longer than a chunk and than stb_sprintf's 512 byte pieces */
+			int width = (int)(i * 17 % 700);
+			str_builder_format(&sb, "<%*td>", width, i);
+			len += snprintf((char*)expect + len, sizeof(expect) - len, "<%*td>", width, i);
+		}
+		check(sb.len == len);
+
+		if(round == 0){
+			chunks = test_string_builder_chunk_count(&sb);
+			check(chunks >= len / 16);
+			str_builder_reset(&sb);
+			check(sb.len == 0 && str_builder_build(&sb).len == 0);
+		}
+		else {
+			check(test_string_builder_chunk_count(&sb) == chunks && sb.last->next == NULL);
+		}
+	}
+
+	String built = str_builder_build(&sb);
+	check(built.len == len && mem_compare(built.v, expect, len) == 0);
+	check(sb.first == sb.last);
+	str_builder_destroy(&sb);
+}
+
+static
+void test_string(){
+	test_string_count_byte();
+	test_string_find();
+	test_string_parse_int();
+	test_string_builder_chunks();
+}
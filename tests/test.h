@@ -0,0 +1,13 @@
+#pragma once
+#include <stdio.h>
+
+/* Each test_* function runs its checks and keeps going after a failure, so
+ * one run reports everything that is broken */
+static int test_failures = 0;
+
+#define check(Pred) do { \
+	if(!(Pred)){ \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #Pred); \
+		test_failures += 1; \
+	} \
+} while(0)
@@ -0,0 +1,40 @@
+#include "../base/base.c"
+#include "../cx.c"
+
+#include "test.h"
+#include "shared_arena.c"
+#include "hash_map.c"
+#include "intern.c"
+#include "string.c"
+#include "io.c"
+#include "utf8.c"
+#include "arena.c"
+#include "lexer.c"
+#include "parser.c"
+#include "pipeline.c"
+#include "sema.c"
+#include "resolver.c"
+#include "type.c"
+
+int main(){
+	test_shared_arena();
+	test_hash_map();
+	test_intern();
+	test_string();
+	test_io();
+	test_utf8();
+	test_arena();
+	test_lexer();
+	test_parser();
+	test_pipeline();
+	test_sema();
+	test_resolver();
+	test_type();
+
+	if(test_failures > 0){
+		fprintf(stderr, "%d checks failed\n", test_failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,170 @@
+#include "test.h"
+
+static
+bool test_type_formats_as(TypeTable* t, TypeId id, String expected){
+	StrBuilder sb = str_builder_create(heap_allocator(), 256);
+	type_format(t, id, &sb);
+	bool equal = str_equals(str_builder_build(&sb), expected);
+	str_builder_destroy(&sb);
+	return equal;
+}
+
+/* Equal types share an id, anything that differs gets its own */
+static
+void test_type_identity(){
+	TypeTable* t = type_table_create(mem_megabyte);
+
+	TypeId ptr = type_pointer(t, Type_I32);
+	check(ptr >= TYPE_PRIMITIVE_COUNT && type_pointer(t, Type_I32) == ptr);
+	check(type_pointer(t, Type_I64) != ptr);
+	check(type_slice(t, Type_I32) != ptr);
+	check(type_array(t, Type_I32, 4) == type_array(t, Type_I32, 4));
+	check(type_array(t, Type_I32, 4) != type_array(t, Type_I32, 5));
+	check(type_pointer(t, ptr) == type_pointer(t, type_pointer(t, Type_I32)));
+
+	/* Parameter lists are copied, the caller's buffer can be reused */
+	TypeId params[] = { Type_I32, Type_Bool };
+	TypeId fn = type_fn(t, params, 2, Type_Void);
+	params[1] = Type_F64;
+	check(type_fn(t, params, 2, Type_Void) != fn);
+	params[1] = Type_Bool;
+	check(type_fn(t, params, 2, Type_Void) == fn);
+	check(type_fn(t, params, 2, Type_I32) != fn);
+	check(type_fn(t, params, 1, Type_Void) != fn);
+	check(type_fn(t, NULL, 0, Type_Void) == type_fn(t, NULL, 0, Type_Void));
+
+	check(test_type_formats_as(t, fn, str_lit("fn(i32, bool)")));
+	check(test_type_formats_as(t, type_fn(t, params, 2, ptr), str_lit("fn(i32, bool) *i32")));
+	check(test_type_formats_as(t, type_slice(t, type_array(t, fn, 3)), str_lit("[][3]fn(i32, bool)")));
+
+	type_table_destroy(t);
+}
+
+/* Signatures longer than the fixed parameter buffers */
+static
+void test_type_many_params(){
+	enum { count = 40 };
+	TypeTable* t = type_table_create(mem_megabyte);
+
+	TypeId params[count];
+	for(isize i = 0; i < count; i += 1){
+		params[i] = i % 2 ? Type_I32 : Type_Bool;
+	}
+	TypeId fn = type_fn(t, params, count, Type_I32);
+	check(type_fn(t, params, count, Type_I32) == fn);
+	params[count - 1] = Type_U8;
+	check(type_fn(t, params, count, Type_I32) != fn);
+
+	Type const* type = type_get(t, fn);
+	check(type->param_count == count && type->params[count - 1] == Type_I32 && type->params[16] == Type_Bool);
+
+	/* The same signature written as type syntax */
+	StrBuilder sb = str_builder_create(heap_allocator(), 1024);
+	str_builder_append(&sb, str_lit("fn f(p: fn("));
+	for(isize i = 0; i < count; i += 1){
+		str_builder_append(&sb, i == 0 ? str_lit("") : str_lit(", "));
+		str_builder_append(&sb, i % 2 ? str_lit("i32") : str_lit("bool"));
+	}
+	str_builder_append(&sb, str_lit(") i32) { let x: u8 = p; }"));
+	String source = str_builder_build(&sb);
+
+	TestSema s;
+	test_sema_run(&s, source);
+	check(s.sema.errors.len == 1);
+	if(s.sema.errors.len == 1){
+		String message = s.sema.errors.v[0].message;
+		String got = str_sub(source, str_find(source, str_lit("fn(")), str_find(source, str_lit(") {")));
+		check(str_find(message, got) >= 0);
+	}
+	test_sema_destroy(&s);
+	str_builder_destroy(&sb);
+	type_table_destroy(t);
+}
+
+/* The slot table starts at TYPE_TABLE_MIN and types are stored in pages, ids
+ * stay put as both grow */
+static
+void test_type_growth(){
+	enum { count = 10000 };
+	TypeTable* t = type_table_create(mem_megabyte);
+
+	TypeId first = type_array(t, Type_U8, 0);
+	for(u64 i = 1; i < count; i += 1){
+		check(type_array(t, Type_U8, i) == first + i);
+	}
+	for(u64 i = 0; i < count; i += 1){
+		TypeId id = type_array(t, Type_U8, i);
+		check(id == first + i);
+		check(type_get(t, id)->kind == Type_Array && type_get(t, id)->len == i);
+	}
+	type_table_destroy(t);
+}
+
+/* Deep nesting is formatted without recursion */
+static
+void test_type_nesting(){
+	enum { depth = 200000 };
+	TypeTable* t = type_table_create(mem_megabyte);
+
+	TypeId id = Type_I32;
+	for(isize i = 0; i < depth; i += 1){
+		id = type_pointer(t, id);
+	}
+	StrBuilder sb = str_builder_create(heap_allocator(), 4096);
+	type_format(t, id, &sb);
+	String s = str_builder_build(&sb);
+	check(s.len == depth + 3 && s.v[0] == '*' && s.v[depth - 1] == '*' && str_equals(str_sub(s, depth, s.len), str_lit("i32")));
+	str_builder_destroy(&sb);
+	type_table_destroy(t);
+}
+
+typedef struct {
+	TypeTable* table;
+	u32 seed;
+	TypeId ids[2000];
+} TestTypeWorker;
+
+/* Every thread interns the same types, starting at a different one */
+static
+void test_type_intern_worker(void* arg){
+	TestTypeWorker* w = arg;
+	isize n = c_array_length(w->ids);
+	for(isize k = 0; k < n; k += 1){
+		isize i = (k + w->seed * 7919) % n;
+		TypeId elem = type_array(w->table, Type_I32, (u64)i / 2);
+		TypeId params[] = { elem, Type_Bool };
+		w->ids[i] = i % 2 ? type_pointer(w->table, elem) : type_fn(w->table, params, 2, elem);
+	}
+}
+
+static
+void test_type_concurrent_intern(){
+	enum { threads = 4 };
+	TypeTable* t = type_table_create(mem_megabyte);
+
+	static TestTypeWorker workers[threads];
+	Thread handles[threads];
+	for(u32 i = 0; i < threads; i += 1){
+		workers[i] = (TestTypeWorker){ .table = t, .seed = i };
+		check(thread_create(&handles[i], test_type_intern_worker, &workers[i]));
+	}
+	for(u32 i = 0; i < threads; i += 1){
+		thread_join(&handles[i]);
+	}
+
+	for(u32 i = 1; i < threads; i += 1){
+		check(mem_compare(workers[i].ids, workers[0].ids, sizeof(workers[0].ids)) == 0);
+	}
+	/* 1000 arrays plus a pointer and a fn for each, nothing interned twice */
+	check(atomic_load(&t->next_id) == TYPE_PRIMITIVE_COUNT + 3000);
+	type_table_destroy(t);
+}
+
+static
+void test_type(){
+	test_type_identity();
+	test_type_many_params();
+	test_type_growth();
+	test_type_nesting();
+	test_type_concurrent_intern();
+}
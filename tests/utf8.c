@@ -0,0 +1,233 @@
+#include "test.h"
+
+/* Runs of 4 byte sequences count twice per lead in UTF-16, which is where the
+ * per-lane counters could wrap */
+static
+void test_utf8_count_units(){
+	static byte data[8192 + 12];
+	UTF8Encoded smile = utf8_encode(0x1f600);
+	for(isize i = 0; i + 4 <= (isize)sizeof(data); i += 4){
+		mem_copy_no_overlap(data + i, smile.bytes, 4);
+	}
+	for(isize len = 0; len <= (isize)sizeof(data); len += 4 * 127){
+		check(utf8_rune_count(data, len) == len / 4);
+		check(utf8_utf16_length(data, len) == len / 2);
+	}
+	isize sizes[] = { 2048, 4096, 8192 };
+	for(isize i = 0; i < c_array_length(sizes); i += 1){
+		check(utf8_utf16_length(data, sizes[i]) == sizes[i] / 2);
+	}
+
+	static byte ascii[16 * 1024 + 5];
+	mem_set(ascii, 'a', sizeof(ascii));
+	check(utf8_rune_count(ascii, sizeof(ascii)) == (isize)sizeof(ascii));
+	check(utf8_utf16_length(ascii, sizeof(ascii)) == (isize)sizeof(ascii));
+}
+
+/* Each bad sequence is placed at every offset around the 16 byte blocks of
+ * the vector path, after ASCII and after multibyte text, and must be found at
+ * its first byte. The scalar path has to agree. */
+static
+void test_utf8_validate(){
+	String bad[] = {
+		str_lit("\x80"),             /* Continuation without a lead */
+		str_lit("\xbf\x80"),
+		str_lit("\xc0\x80"),         /* Overlong */
+		str_lit("\xc1\xbf"),
+		str_lit("\xe0\x80\x80"),
+		str_lit("\xe0\x9f\xbf"),
+		str_lit("\xf0\x80\x80\x80"),
+		str_lit("\xf0\x8f\xbf\xbf"),
+		str_lit("\xed\xa0\x80"),     /* Surrogates */
+		str_lit("\xed\xbf\xbf"),
+		str_lit("\xf4\x90\x80\x80"), /* Above U+10FFFF */
+		str_lit("\xf5\x80\x80\x80"),
+		str_lit("\xff"),
+		str_lit("\xc3"),             /* Truncated */
+		str_lit("\xe2\x82"),
+		str_lit("\xf0\x9f\x98"),
+		str_lit("\xe2" "a"),
+		str_lit("\xf0\x9f\x98\xe2\x82\xac"),
+	};
+	String fills[] = { str_lit("a"), str_lit("\xc3\xa9"), str_lit("\xe2\x82\xac"), str_lit("\xf0\x9f\x98\x80") };
+	static byte buf[128];
+
+	for(isize f = 0; f < c_array_length(fills); f += 1){
+		for(isize b = 0; b < c_array_length(bad); b += 1){
+			for(isize at = 0; at < 72; at += 1){
+				/* Fill up to at, ending on a whole rune */
+				isize pos = 0;
+				while(pos + fills[f].len <= at){
+					mem_copy_no_overlap(buf + pos, fills[f].v, fills[f].len);
+					pos += fills[f].len;
+				}
+				while(pos < at){ buf[pos++] = 'a'; }
+				mem_copy_no_overlap(buf + pos, bad[b].v, bad[b].len);
+
+				for(isize tail = 0; tail <= 20; tail += 5){
+					isize len = at + bad[b].len + tail;
+					mem_set(buf + at + bad[b].len, 'a', tail);
+					check(utf8_validate(buf, len) == at);
+					check(utf8_validate_from(buf, len, 0) == at);
+				}
+			}
+		}
+	}
+
+	/* Valid text of every length up to a few blocks, cut on rune boundaries */
+	isize pos = 0;
+	for(isize i = 0; pos + 4 <= (isize)sizeof(buf); i += 1){
+		String fill = fills[(i * 7) % c_array_length(fills)];
+		mem_copy_no_overlap(buf + pos, fill.v, fill.len);
+		pos += fill.len;
+		check(utf8_validate(buf, pos) == -1);
+		check(utf8_validate_from(buf, pos, 0) == -1);
+	}
+	check(utf8_validate(buf, 0) == -1);
+}
+
+/* Each case is run on its own and behind enough ASCII to go through the
+ * vector paths first */
+static
+void test_utf8_transcode(){
+	struct { String utf8; u16 utf16[8]; isize utf16_len; rune utf32[8]; isize utf32_len; } cases[] = {
+		{ str_lit(""), {0}, 0, {0}, 0 },
+		{ str_lit("abc"), { 'a', 'b', 'c' }, 3, { 'a', 'b', 'c' }, 3 },
+		{ str_lit("\xc3\xa9"), { 0xe9 }, 1, { 0xe9 }, 1 },
+		{ str_lit("\xe2\x82\xac"), { 0x20ac }, 1, { 0x20ac }, 1 },
+		{ str_lit("\xef\xbf\xbf"), { 0xffff }, 1, { 0xffff }, 1 },
+		{ str_lit("\xf0\x90\x80\x80"), { 0xd800, 0xdc00 }, 2, { 0x10000 }, 1 },
+		{ str_lit("\xf0\x9f\x98\x80"), { 0xd83d, 0xde00 }, 2, { 0x1f600 }, 1 },
+		{ str_lit("\xf4\x8f\xbf\xbf"), { 0xdbff, 0xdfff }, 2, { 0x10ffff }, 1 },
+		{ str_lit("a\xf0\x9f\x98\x80\xc3\xa9" "b"), { 'a', 0xd83d, 0xde00, 0xe9, 'b' }, 5, { 'a', 0x1f600, 0xe9, 'b' }, 4 },
+	};
+	/* Bad bytes come out as U+FFFD one at a time */
+	struct { String utf8; rune utf32[8]; isize len; } bad[] = {
+		{ str_lit("\xff"), { UTF8_ERROR }, 1 },
+		{ str_lit("\xe2\x82"), { UTF8_ERROR, UTF8_ERROR }, 2 },
+		{ str_lit("\xed\xa0\x80"), { UTF8_ERROR, UTF8_ERROR, UTF8_ERROR }, 3 },
+		{ str_lit("\xc0\xafz"), { UTF8_ERROR, UTF8_ERROR, 'z' }, 3 },
+		{ str_lit("\xf0\x9f\x98" "a"), { UTF8_ERROR, UTF8_ERROR, UTF8_ERROR, 'a' }, 4 },
+	};
+	static byte utf8[64];
+	static u16 utf16[64];
+	static rune utf32[64];
+	static byte back[3 * 64];
+
+	for(isize pad = 0; pad <= 20; pad += 20){
+		mem_set(utf8, 'x', pad);
+		for(isize i = 0; i < c_array_length(cases); i += 1){
+			String s = cases[i].utf8;
+			mem_copy_no_overlap(utf8 + pad, s.v, s.len);
+			isize n = pad + s.len;
+
+			check(utf8_to_utf16(utf8, n, utf16) == pad + cases[i].utf16_len);
+			check(mem_compare(utf16 + pad, cases[i].utf16, cases[i].utf16_len * sizeof(u16)) == 0);
+			check(utf8_utf16_length(utf8, n) == pad + cases[i].utf16_len);
+
+			check(utf8_to_utf32(utf8, n, utf32) == pad + cases[i].utf32_len);
+			check(mem_compare(utf32 + pad, cases[i].utf32, cases[i].utf32_len * sizeof(rune)) == 0);
+			check(utf8_rune_count(utf8, n) == pad + cases[i].utf32_len);
+
+			isize units = utf8_to_utf16(utf8, n, utf16);
+			check(utf16_to_utf8(utf16, units, back) == n);
+			check(mem_compare(back, utf8, n) == 0);
+		}
+		for(isize i = 0; i < c_array_length(bad); i += 1){
+			mem_copy_no_overlap(utf8 + pad, bad[i].utf8.v, bad[i].utf8.len);
+			isize n = pad + bad[i].utf8.len;
+			check(utf8_to_utf32(utf8, n, utf32) == pad + bad[i].len);
+			check(mem_compare(utf32 + pad, bad[i].utf32, bad[i].len * sizeof(rune)) == 0);
+			check(utf8_to_utf16(utf8, n, utf16) == pad + bad[i].len);
+			check(utf16[pad] == UTF8_ERROR);
+		}
+	}
+}
+
+/* Unpaired surrogates in UTF-16 become U+FFFD */
+static
+void test_utf16_to_utf8(){
+	struct { u16 utf16[4]; isize len; String utf8; } cases[] = {
+		{ { 0xd800 }, 1, str_lit("\xef\xbf\xbd") },
+		{ { 0xdc00, 'a' }, 2, str_lit("\xef\xbf\xbd" "a") },
+		{ { 0xd83d, 'a' }, 2, str_lit("\xef\xbf\xbd" "a") },
+		{ { 0xd83d, 0xd83d, 0xde00 }, 3, str_lit("\xef\xbf\xbd\xf0\x9f\x98\x80") },
+		{ { 0x7f, 0x80, 0x7ff, 0x800 }, 4, str_lit("\x7f\xc2\x80\xdf\xbf\xe0\xa0\x80") },
+	};
+	static byte out[64];
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		isize n = utf16_to_utf8(cases[i].utf16, cases[i].len, out);
+		check(str_equals((String){ .v = out, .len = n }, cases[i].utf8));
+	}
+}
+
+/* A UTF-16 offset inside a surrogate pair maps past the whole rune */
+static
+void test_utf8_offset_from_utf16(){
+	String s = str_lit("a\xf0\x9f\x98\x80\xc3\xa9\xe2\x82\xac" "b");
+	isize offsets[] = { 0, 1, 5, 5, 7, 10, 11, 11 };
+	for(isize i = 0; i < c_array_length(offsets); i += 1){
+		check(utf8_offset_from_utf16(s.v, s.len, i) == offsets[i]);
+	}
+
+	/* Long ASCII runs are skipped in blocks, but never past the offset */
+	static byte buf[100];
+	mem_set(buf, 'a', sizeof(buf));
+	UTF8Encoded smile = utf8_encode(0x1f600);
+	mem_copy_no_overlap(buf + 40, smile.bytes, 4);
+	for(isize u = 0; u <= 40; u += 1){
+		check(utf8_offset_from_utf16(buf, sizeof(buf), u) == u);
+	}
+	check(utf8_offset_from_utf16(buf, sizeof(buf), 41) == 44);
+	check(utf8_offset_from_utf16(buf, sizeof(buf), 42) == 44);
+	check(utf8_offset_from_utf16(buf, sizeof(buf), 60) == 62);
+	check(utf8_offset_from_utf16(buf, sizeof(buf), 1000) == (isize)sizeof(buf));
+}
+
+static
+void test_rune_is_xid(){
+	struct { rune c; bool start; bool cont; } cases[] = {
+		{ 'a', true, true },
+		{ 'Z', true, true },
+		{ '_', false, true },
+		{ '0', false, true },
+		{ '$', false, false },
+		{ ' ', false, false },
+		{ 0x7f, false, false },
+		{ 0xaa, true, true },     /* Feminine ordinal, Lo */
+		{ 0xb7, false, true },    /* Middle dot */
+		{ 0xd7, false, false },   /* Multiplication sign */
+		{ 0xe9, true, true },
+		{ 0x301, false, true },   /* Combining acute, Mn */
+		{ 0x378, false, false },  /* Unassigned */
+		{ 0x3b1, true, true },
+		{ 0x660, false, true },   /* Arabic-Indic zero, Nd */
+		{ 0x203f, false, true },  /* Undertie, Pc */
+		{ 0x2028, false, false },
+		{ 0x2160, true, true },   /* Roman numeral one, Nl */
+		{ 0x4e2d, true, true },
+		{ 0xfffd, false, false },
+		{ 0x10400, true, true },  /* Deseret */
+		{ 0x1d400, true, true },  /* Mathematical bold A */
+		{ 0x1f600, false, false },
+		{ 0x20000, true, true },  /* CJK extension B */
+		{ 0xe0100, false, true }, /* Variation selector 17 */
+		{ 0xe01f0, false, false },
+		{ 0x10ffff, false, false },
+		{ 0x110000, false, false },
+	};
+	for(isize i = 0; i < c_array_length(cases); i += 1){
+		check(rune_is_xid_start(cases[i].c) == cases[i].start);
+		check(rune_is_xid_continue(cases[i].c) == cases[i].cont);
+	}
+}
+
+static
+void test_utf8(){
+	test_utf8_count_units();
+	test_utf8_validate();
+	test_utf8_transcode();
+	test_utf16_to_utf8();
+	test_utf8_offset_from_utf16();
+	test_rune_is_xid();
+}
@@ -0,0 +1,404 @@
+#include "cx.h"
+#include "base/hash_map.h"
+
+#define TYPE_TABLE_PAGE_SIZE (1 << TYPE_TABLE_PAGE_SHIFT)
+#define TYPE_TABLE_MIN       64
+#define TYPE_NODE_DONE       (1u << 31)
+#define TYPE_FORMAT_TEXT     (1u << 31)
+
+struct TypeTableSlots {
+	TypeTableSlots* retired;
+	isize cap;
+	_Atomic(u64) v[];
+};
+
+static const String type_primitive_names[TYPE_PRIMITIVE_COUNT] = {
+	[Type_Void]   = str_lit("void"),
+	[Type_Bool]   = str_lit("bool"),
+	[Type_I8]     = str_lit("i8"),
+	[Type_I16]    = str_lit("i16"),
+	[Type_I32]    = str_lit("i32"),
+	[Type_I64]    = str_lit("i64"),
+	[Type_U8]     = str_lit("u8"),
+	[Type_U16]    = str_lit("u16"),
+	[Type_U32]    = str_lit("u32"),
+	[Type_U64]    = str_lit("u64"),
+	[Type_F32]    = str_lit("f32"),
+	[Type_F64]    = str_lit("f64"),
+	[Type_Rune]   = str_lit("rune"),
+	[Type_String] = str_lit("string"),
+};
+
+static
+TypeTableSlots* type_slots_create(isize cap){
+	TypeTableSlots* s = heap_alloc(sizeof(TypeTableSlots) + sizeof(u64) * cap, alignof(TypeTableSlots));
+	s->retired = NULL;
+	s->cap = cap;
+	for(isize i = 0; i < cap; i += 1){
+		atomic_init(&s->v[i], 0);
+	}
+	return s;
+}
+
+static inline
+void type_table_lock(atomic_int* lock){
+	while(atomic_exchange_explicit(lock, 1, memory_order_acquire)){
+		while(atomic_load_explicit(lock, memory_order_relaxed)){}
+	}
+}
+
+static inline
+void type_table_unlock(atomic_int* lock){
+	atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+static
+u64 type_hash(Type const* type){
+	u64 h = hash_u64(((u64)type->kind << 32) | type->elem);
+	if(type->kind == Type_Array){
+		h = hash_u64(h ^ type->len);
+	}
+	else if(type->kind == Type_Fn){
+		h = hash_u64(h ^ hash_bytes(type->params, type->param_count * sizeof(TypeId)) ^ type->param_count);
+	}
+	return h;
+}
+
+static
+bool type_equal(Type const* a, Type const* b){
+	if(a->kind != b->kind || a->elem != b->elem){
+		return false;
+	}
+	if(a->kind == Type_Array){
+		return a->len == b->len;
+	}
+	if(a->kind == Type_Fn){
+		/* Without parameters the lists may be NULL */
+		return a->param_count == b->param_count
+			&& (a->param_count == 0 || mem_compare(a->params, b->params, a->param_count * sizeof(TypeId)) == 0);
+	}
+	return true;
+}
+
+/* Returns the id of type or 0 */
+static
+TypeId type_probe(TypeTable* t, TypeTableSlots* s, Type const* type, u64 hash){
+	isize mask = s->cap - 1;
+	u32 tag = (u32)(hash >> 32);
+	for(isize i = (isize)(hash >> 6) & mask;; i = (i + 1) & mask){
+		u64 slot = atomic_load_explicit(&s->v[i], memory_order_acquire);
+		if(slot == 0){
+			return 0;
+		}
+		if((u32)(slot >> 32) == tag && type_equal(type_get(t, (TypeId)slot), type)){
+			return (TypeId)slot;
+		}
+	}
+}
+
+static
+void type_slots_put(TypeTableSlots* s, u64 hash, u64 slot){
+	isize mask = s->cap - 1;
+	isize i = (isize)(hash >> 6) & mask;
+	while(atomic_load_explicit(&s->v[i], memory_order_relaxed) != 0){
+		i = (i + 1) & mask;
+	}
+	atomic_store_explicit(&s->v[i], slot, memory_order_release);
+}
+
+TypeTable* type_table_create(isize param_capacity){
+	TypeTable* t = heap_alloc(sizeof(TypeTable), alignof(TypeTable));
+	mem_set(t, 0, sizeof(TypeTable));
+
+	MemPagePolicy applied = MemPages_Default;
+	t->params = arena_create_mapped(param_capacity, MemPages_Default, &applied);
+	atomic_init(&t->slots, type_slots_create(TYPE_TABLE_MIN));
+	atomic_init(&t->next_id, 1);
+
+	for(u8 kind = 1; kind < TYPE_PRIMITIVE_COUNT; kind += 1){
+		TypeId id = type_intern(t, (Type){ .kind = kind });
+		ensure(id == kind, "Primitive ids must match their kind");
+	}
+	return t;
+}
+
+void type_table_destroy(TypeTable* t){
+	TypeTableSlots* s = atomic_load(&t->slots);
+	while(s != NULL){
+		TypeTableSlots* retired = s->retired;
+		heap_free(s);
+		s = retired;
+	}
+	for(isize i = 0; i < TYPE_TABLE_MAX_PAGES; i += 1){
+		heap_free(atomic_load(&t->pages[i]));
+	}
+	arena_destroy_mapped(&t->params);
+	heap_free(t);
+}
+
+TypeId type_intern(TypeTable* t, Type type){
+	ensure(type.kind != Type_None && type.kind < Type__COUNT, "Invalid type kind");
+	u64 hash = type_hash(&type);
+
+	/* Fast path, no lock */
+	TypeId id = type_probe(t, atomic_load_explicit(&t->slots, memory_order_acquire), &type, hash);
+	if(id != 0){
+		return id;
+	}
+
+	type_table_lock(&t->lock);
+	TypeTableSlots* s = atomic_load_explicit(&t->slots, memory_order_relaxed);
+
+	id = type_probe(t, s, &type, hash);
+	if(id != 0){
+		type_table_unlock(&t->lock);
+		return id;
+	}
+
+	if(type.kind == Type_Fn && type.param_count > 0){
+		TypeId* params = arena_make(&t->params, TypeId, type.param_count);
+		ensure(params != NULL, "Type table out of parameter memory");
+		mem_copy_no_overlap(params, type.params, type.param_count * sizeof(TypeId));
+		type.params = params;
+	}
+
+	id = atomic_load_explicit(&t->next_id, memory_order_relaxed);
+	ensure((id >> TYPE_TABLE_PAGE_SHIFT) < TYPE_TABLE_MAX_PAGES, "Type table full");
+
+	_Atomic(Type*)* page_slot = &t->pages[id >> TYPE_TABLE_PAGE_SHIFT];
+	Type* page = atomic_load_explicit(page_slot, memory_order_relaxed);
+	if(page == NULL){
+		page = heap_alloc(sizeof(Type) * TYPE_TABLE_PAGE_SIZE, alignof(Type));
+		mem_set(page, 0, sizeof(Type) * TYPE_TABLE_PAGE_SIZE); /* Type_None reads as zeroes */
+		atomic_store_explicit(page_slot, page, memory_order_release);
+	}
+	page[id & (TYPE_TABLE_PAGE_SIZE - 1)] = type;
+	atomic_store_explicit(&t->next_id, id + 1, memory_order_relaxed);
+
+	/* Keep the load factor under 1/2, old tables stay alive for readers */
+	if((t->len + 1) * 2 > s->cap){
+		TypeTableSlots* grown = type_slots_create(s->cap * 2);
+		for(isize i = 0; i < s->cap; i += 1){
+			u64 slot = atomic_load_explicit(&s->v[i], memory_order_relaxed);
+			if(slot == 0){ continue; }
+			type_slots_put(grown, type_hash(type_get(t, (TypeId)slot)), slot);
+		}
+		grown->retired = s;
+		atomic_store_explicit(&t->slots, grown, memory_order_release);
+		s = grown;
+	}
+
+	type_slots_put(s, hash, ((hash >> 32) << 32) | id);
+	t->len += 1;
+
+	type_table_unlock(&t->lock);
+	return id;
+}
+
+TypeId type_pointer(TypeTable* t, TypeId elem){
+	return type_intern(t, (Type){ .kind = Type_Pointer, .elem = elem });
+}
+
+TypeId type_array(TypeTable* t, TypeId elem, u64 len){
+	return type_intern(t, (Type){ .kind = Type_Array, .elem = elem, .len = len });
+}
+
+TypeId type_slice(TypeTable* t, TypeId elem){
+	return type_intern(t, (Type){ .kind = Type_Slice, .elem = elem });
+}
+
+TypeId type_fn(TypeTable* t, TypeId const* params, u32 param_count, TypeId ret){
+	return type_intern(t, (Type){ .kind = Type_Fn, .elem = ret, .param_count = param_count, .params = params });
+}
+
+TypeId type_from_name(String name){
+	for(TypeId id = 1; id < TYPE_PRIMITIVE_COUNT; id += 1){
+		if(str_equals(type_primitive_names[id], name)){
+			return id;
+		}
+	}
+	return Type_None;
+}
+
+/* Walked with an explicit stack, so deeply nested types can't overflow the C
+ * stack. Like infer_expr, a node comes off `pending` twice: first to queue its
+ * operands, then, marked with TYPE_NODE_DONE, to build its type from the ids
+ * the operands left on `done`. Stops at the first part that doesn't resolve. */
+static
+TypeId type_from_node_walk(TypeTable* t, Ast const* ast, Token const* tokens, NodeIndex root, NodeIndex* bad_node, U32Array* pending, U32Array* done){
+	dyn_array_push(pending, root);
+
+	while(pending->len > 0){
+		u32 entry = dyn_array_pop(pending);
+		NodeIndex node = entry & ~TYPE_NODE_DONE;
+		if(node == NODE_NONE){
+			return Type_None;
+		}
+		NodeData data = ast->data[node];
+
+		if(!(entry & TYPE_NODE_DONE)){
+			switch((NodeTag)ast->tag[node]){
+			case Node_TypeName: {
+				TypeId id = type_from_name(tokens[ast->main_token[node]].lexeme);
+				if(id == Type_None){
+					*bad_node = node;
+					return Type_None;
+				}
+				dyn_array_push(done, id);
+			} break;
+
+			case Node_TypePointer:
+				dyn_array_push(pending, node | TYPE_NODE_DONE);
+				dyn_array_push(pending, data.lhs);
+			break;
+
+			case Node_TypeArray:
+				dyn_array_push(pending, node | TYPE_NODE_DONE);
+				dyn_array_push(pending, data.rhs);
+			break;
+
+			case Node_TypeFn: {
+				/* Parameters come off first and in order, then the return type */
+				NodeList params = ast_list(ast, data.lhs);
+				dyn_array_push(pending, node | TYPE_NODE_DONE);
+				if(data.rhs != NODE_NONE){
+					dyn_array_push(pending, data.rhs);
+				}
+				for(u32 i = params.len; i > 0; i -= 1){
+					dyn_array_push(pending, params.v[i - 1]);
+				}
+			} break;
+
+			default:
+				*bad_node = node;
+				return Type_None;
+			}
+			continue;
+		}
+
+		TypeId id = Type_None;
+		switch((NodeTag)ast->tag[node]){
+		case Node_TypePointer:
+			id = type_pointer(t, dyn_array_pop(done));
+		break;
+
+		case Node_TypeArray: {
+			TypeId elem = dyn_array_pop(done);
+			if(data.lhs == NODE_NONE){
+				id = type_slice(t, elem);
+				break;
+			}
+			if(ast->tag[data.lhs] != Node_Integer || tokens[ast->main_token[data.lhs]].value_integer < 0){
+				*bad_node = data.lhs;
+				return Type_None;
+			}
+			id = type_array(t, elem, (u64)tokens[ast->main_token[data.lhs]].value_integer);
+		} break;
+
+		case Node_TypeFn: {
+			NodeList params = ast_list(ast, data.lhs);
+			TypeId ret = data.rhs != NODE_NONE ? dyn_array_pop(done) : Type_Void;
+			done->len -= params.len;
+			id = type_fn(t, &done->v[done->len], params.len, ret);
+		} break;
+
+		default: break;
+		}
+		dyn_array_push(done, id);
+	}
+	return dyn_array_pop(done);
+}
+
+TypeId type_from_node(TypeTable* t, Ast const* ast, Token const* tokens, NodeIndex node, NodeIndex* bad_node){
+	if(node == NODE_NONE){
+		return Type_None;
+	}
+	U32Array pending = dyn_array_create(heap_allocator());
+	U32Array done = dyn_array_create(heap_allocator());
+
+	TypeId id = type_from_node_walk(t, ast, tokens, node, bad_node, &pending, &done);
+
+	dyn_array_destroy(&pending);
+	dyn_array_destroy(&done);
+	return id;
+}
+
+/* Prefixes are written as they are reached, what comes after a type (the rest
+ * of a fn signature) waits on a stack: either a TypeId or TYPE_FORMAT_TEXT
+ * with an index into type_format_text. */
+static const String type_format_text[] = {
+	str_lit(", "),
+	str_lit(")"),
+	str_lit(") "),
+};
+
+void type_format(TypeTable* t, TypeId id, StrBuilder* sb){
+	U32Array pending = dyn_array_create(heap_allocator());
+
+	for(;;){
+		if(id == Type_None){
+			str_builder_append(sb, str_lit("<none>"));
+		}
+		else if(id < TYPE_PRIMITIVE_COUNT){
+			str_builder_append(sb, type_primitive_names[id]);
+		}
+		else {
+			Type const* type = type_get(t, id);
+			switch((TypeKind)type->kind){
+			case Type_Pointer:
+				str_builder_append_byte(sb, '*');
+			break;
+			case Type_Array:
+				str_builder_format(sb, "[%llu]", (unsigned long long)type->len);
+			break;
+			case Type_Slice:
+				str_builder_append(sb, str_lit("[]"));
+			break;
+			case Type_Fn:
+				str_builder_append(sb, str_lit("fn("));
+				if(type->elem != Type_Void){
+					dyn_array_push(&pending, type->elem);
+					dyn_array_push(&pending, TYPE_FORMAT_TEXT | 2);
+				}
+				else {
+					dyn_array_push(&pending, TYPE_FORMAT_TEXT | 1);
+				}
+				for(u32 i = type->param_count; i > 0; i -= 1){
+					dyn_array_push(&pending, type->params[i - 1]);
+					if(i > 1){
+						dyn_array_push(&pending, TYPE_FORMAT_TEXT | 0);
+					}
+				}
+			break;
+			default: break;
+			}
+			if(type->kind != Type_Fn){
+				id = type->elem;
+				continue;
+			}
+		}
+
+		/* Write out text until the next type to format */
+		bool more = false;
+		while(pending.len > 0 && !more){
+			u32 entry = dyn_array_pop(&pending);
+			if(entry & TYPE_FORMAT_TEXT){
+				str_builder_append(sb, type_format_text[entry & ~TYPE_FORMAT_TEXT]);
+			}
+			else {
+				id = entry;
+				more = true;
+			}
+		}
+		if(!more){
+			break;
+		}
+	}
+
+	dyn_array_destroy(&pending);
+}
+
+#undef TYPE_TABLE_PAGE_SIZE
+#undef TYPE_TABLE_MIN
+#undef TYPE_NODE_DONE
+#undef TYPE_FORMAT_TEXT